@@ -0,0 +1,318 @@
+#define _POSIX_C_SOURCE 199309L // For clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "doseAdmin.h"
+#include "perfCounters.h"
+#include "workload.h"
+#include "replay.h"
+
+#define DEFAULT_ROUNDS   (2000)
+#define DOSES_PER_ROUND  (10) // Matches the fixed dose capacity of a patient
+#define MAX_REPLAY_FAILURE_RATE (0.01) // Replaying a generated trace, nearly every call succeeds
+
+// Accumulated measurement of one benchmark over all its rounds
+typedef struct {
+	const char* name;
+	double      seconds;
+	uint64_t    counts[PERF_NR_OF_COUNTERS];
+	size_t      ops;
+} BenchResult;
+
+static PerfCounters counters;
+static bool useCounters = false;
+static struct timespec startTime;
+
+static char patientNames[HASHTABLE_SIZE][MAX_PATIENTNAME_SIZE];
+static size_t nrOfPatients = 0;
+static char absentNames[HASHTABLE_SIZE][MAX_PATIENTNAME_SIZE];
+
+
+static void measureBegin(void)
+{
+	if (useCounters) {
+		PerfCountersStart(&counters);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+}
+
+static void measureEnd(BenchResult* result, size_t ops)
+{
+	struct timespec endTime;
+	clock_gettime(CLOCK_MONOTONIC, &endTime);
+	if (useCounters) {
+		PerfCountersStop(&counters);
+		for (int i = 0; i < PERF_NR_OF_COUNTERS; i++) {
+			result->counts[i] += counters.value[i];
+		}
+	}
+	result->seconds += (double)(endTime.tv_sec - startTime.tv_sec) +
+	                   (double)(endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+	result->ops += ops;
+}
+
+static void printHeader(void)
+{
+	printf("%-28s %10s", "benchmark", "ns/op");
+	for (int i = 0; i < PERF_NR_OF_COUNTERS; i++) {
+		printf(" %10s", PerfCounterName((PerfCounterId)i));
+	}
+	printf("\n");
+}
+
+static void printResult(const BenchResult* result)
+{
+	double ops = (result->ops > 0) ? (double)result->ops : 1.0;
+
+	printf("%-28s %10.1f", result->name, result->seconds * 1e9 / ops);
+	for (int i = 0; i < PERF_NR_OF_COUNTERS; i++) {
+		if (useCounters && PerfCounterAvailable(&counters, (PerfCounterId)i)) {
+			printf(" %10.2f", (double)result->counts[i] / ops);
+		}
+		else {
+			printf(" %10s", "n/a");
+		}
+	}
+	printf("\n");
+}
+
+/**
+ * @brief Makes a name whose first 5 characters (the part the hash looks at) vary.
+ */
+static void makeName(char name[MAX_PATIENTNAME_SIZE], const char* suffix, unsigned seed)
+{
+	static const char letters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+	for (int i = 0; i < 5; i++) {
+		seed = seed * 1103515245u + 12345u;
+		name[i] = letters[(seed >> 16) % (sizeof(letters) - 1)];
+	}
+	snprintf(name + 5, MAX_PATIENTNAME_SIZE - 5, "%s", suffix);
+}
+
+/**
+ * @brief Fills the table with one patient per table entry on average and remembers
+ *        their names, plus a same sized set of names that are absent.
+ */
+static void fillTable(void)
+{
+	char name[MAX_PATIENTNAME_SIZE];
+
+	CreateHashTable();
+	nrOfPatients = 0;
+	for (unsigned i = 0; i < 100000 && nrOfPatients < HASHTABLE_SIZE; i++) {
+		makeName(name, "-patient", i);
+		if (AddPatient(name) == 0) {
+			strcpy(patientNames[nrOfPatients], name);
+			makeName(absentNames[nrOfPatients], "-absent", i);
+			nrOfPatients++;
+		}
+	}
+}
+
+static void fillDoses(void)
+{
+	for (size_t p = 0; p < nrOfPatients; p++) {
+		for (int d = 0; d < DOSES_PER_ROUND; d++) {
+			Date date = {(uint8_t)(1 + d), (uint8_t)(1 + d), 2020};
+			AddPatientDose(patientNames[p], &date, (uint16_t)(10 + d));
+		}
+	}
+}
+
+static void benchAddRemovePatient(BenchResult* result, int rounds)
+{
+	for (int r = 0; r < rounds; r++) {
+		RemoveAllDataFromHashTable();
+		measureBegin();
+		for (size_t p = 0; p < nrOfPatients; p++) {
+			AddPatient(patientNames[p]);
+		}
+		for (size_t p = 0; p < nrOfPatients; p++) {
+			RemovePatient(patientNames[p]);
+		}
+		measureEnd(result, 2 * nrOfPatients);
+	}
+}
+
+static void benchIsPatientPresent(BenchResult* hit, BenchResult* miss, int rounds)
+{
+	volatile int8_t sink = 0;
+
+	for (int r = 0; r < rounds; r++) {
+		measureBegin();
+		for (size_t p = 0; p < nrOfPatients; p++) {
+			sink += IsPatientPresent(patientNames[p]);
+		}
+		measureEnd(hit, nrOfPatients);
+
+		measureBegin();
+		for (size_t p = 0; p < nrOfPatients; p++) {
+			sink += IsPatientPresent(absentNames[p]);
+		}
+		measureEnd(miss, nrOfPatients);
+	}
+	(void)sink;
+}
+
+static void benchAddPatientDose(BenchResult* result, int rounds)
+{
+	for (int r = 0; r < rounds; r++) {
+		RemoveAllDataFromHashTable();
+		for (size_t p = 0; p < nrOfPatients; p++) {
+			AddPatient(patientNames[p]);
+		}
+		measureBegin();
+		fillDoses();
+		measureEnd(result, nrOfPatients * DOSES_PER_ROUND);
+	}
+}
+
+static void benchPatientDoseInPeriod(BenchResult* result, int rounds)
+{
+	Date start = {1, 3, 2020};
+	Date end = {31, 8, 2020};
+	volatile uint32_t sink = 0;
+
+	for (int r = 0; r < rounds; r++) {
+		measureBegin();
+		for (size_t p = 0; p < nrOfPatients; p++) {
+			uint32_t total = 0;
+			PatientDoseInPeriod(patientNames[p], &start, &end, &total);
+			sink += total;
+		}
+		measureEnd(result, nrOfPatients);
+	}
+	(void)sink;
+}
+
+static void benchGetNumberOfMeasurements(BenchResult* result, int rounds)
+{
+	volatile size_t sink = 0;
+
+	for (int r = 0; r < rounds; r++) {
+		measureBegin();
+		for (size_t p = 0; p < nrOfPatients; p++) {
+			size_t count = 0;
+			GetNumberOfMeasurements(patientNames[p], &count);
+			sink += count;
+		}
+		measureEnd(result, nrOfPatients);
+	}
+	(void)sink;
+}
+
+static void usage(const char* program)
+{
+	printf("usage: %s [--counters] [--rounds N]\n", program);
+	printf("       %s gen <trace> [patients] [operations]\n", program);
+	printf("       %s replay <trace>\n", program);
+	printf("  --counters  also collect hardware counters (per operation)\n");
+}
+
+static int generate(int argc, char* argv[])
+{
+	WorkloadConfig config;
+	DefaultWorkloadConfig(&config);
+	if (argc > 3) {
+		config.nrOfPatients = (size_t)atol(argv[3]);
+	}
+	if (argc > 4) {
+		config.nrOfOperations = (size_t)atol(argv[4]);
+	}
+	if (GenerateWorkload(&config, argv[2]) != 0) {
+		printf("Generating %s failed\n", argv[2]);
+		return 1;
+	}
+	printf("Wrote %zu patients and %zu operations to %s\n", config.nrOfPatients,
+	       config.nrOfOperations, argv[2]);
+	return 0;
+}
+
+static int replay(const char* filePath)
+{
+	TraceOp* ops = NULL;
+	size_t nrOfOps = 0;
+	ReplayReport report;
+
+	if (ReadWorkload(filePath, &ops, &nrOfOps) != 0) {
+		printf("Reading trace %s failed\n", filePath);
+		return 1;
+	}
+	int8_t result = ReplayTrace(ops, nrOfOps, &report);
+	free(ops);
+	if (result != 0) {
+		printf("Replay failed, out of memory\n");
+		return 1;
+	}
+	PrintReplayReport(&report);
+	if (!ReplayFailureRateWithin(&report, MAX_REPLAY_FAILURE_RATE)) {
+		printf("\nMore than %.0f%% of the calls of an operation failed, the trace does not "
+		       "measure the normal path\n", MAX_REPLAY_FAILURE_RATE * 100.0);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	int rounds = DEFAULT_ROUNDS;
+
+	if (argc >= 3 && strcmp(argv[1], "gen") == 0) {
+		return generate(argc, argv);
+	}
+	if (argc == 3 && strcmp(argv[1], "replay") == 0) {
+		return replay(argv[2]);
+	}
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--counters") == 0) {
+			useCounters = true;
+		}
+		else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+			rounds = atoi(argv[++i]);
+		}
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (useCounters && !PerfCountersOpen(&counters)) {
+		printf("Hardware counters not available (no PMU or perf_event_paranoid), "
+		       "continuing with wall-clock time only\n");
+		useCounters = false;
+	}
+
+	fillTable();
+	printf("%zu patients, %d rounds\n\n", nrOfPatients, rounds);
+
+	BenchResult addRemove = {"AddPatient+RemovePatient"};
+	BenchResult presentHit = {"IsPatientPresent (hit)"};
+	BenchResult presentMiss = {"IsPatientPresent (miss)"};
+	BenchResult addDose = {"AddPatientDose"};
+	BenchResult period = {"PatientDoseInPeriod"};
+	BenchResult measurements = {"GetNumberOfMeasurements"};
+
+	benchAddRemovePatient(&addRemove, rounds);
+	fillTable();
+	benchIsPatientPresent(&presentHit, &presentMiss, rounds);
+	benchAddPatientDose(&addDose, rounds);
+	benchPatientDoseInPeriod(&period, rounds);
+	benchGetNumberOfMeasurements(&measurements, rounds);
+
+	printHeader();
+	printResult(&addRemove);
+	printResult(&presentHit);
+	printResult(&presentMiss);
+	printResult(&addDose);
+	printResult(&period);
+	printResult(&measurements);
+
+	RemoveAllDataFromHashTable();
+	if (useCounters) {
+		PerfCountersClose(&counters);
+	}
+	return 0;
+}
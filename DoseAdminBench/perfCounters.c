@@ -0,0 +1,155 @@
+#if defined(__linux__)
+#define _GNU_SOURCE // For syscall
+#endif
+#include "perfCounters.h"
+#include <string.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* CounterNames[PERF_NR_OF_COUNTERS] = {
+	"cycles",
+	"instr",
+	"L1D-miss",
+	"LLC-miss",
+	"br-miss",
+	"dTLB-miss"
+};
+
+#if defined(__linux__)
+
+// Value layout of a read() on a single counter opened with the format flags below
+typedef struct {
+	uint64_t value;
+	uint64_t timeEnabled;
+	uint64_t timeRunning;
+} PerfReadFormat;
+
+static int openCounter(uint32_t type, uint64_t config)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1; // Also works with perf_event_paranoid = 2
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	// pid 0, cpu -1: this thread on any cpu. Counters are opened one by one (no group)
+	// so a single missing event does not take the others down.
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t cacheConfig(uint64_t cache, uint64_t op, uint64_t result)
+{
+	return cache | (op << 8) | (result << 16);
+}
+
+bool PerfCountersOpen(PerfCounters* counters)
+{
+	bool anyAvailable = false;
+
+	counters->fd[PERF_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	counters->fd[PERF_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	counters->fd[PERF_L1D_MISSES] = openCounter(PERF_TYPE_HW_CACHE,
+		cacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+	counters->fd[PERF_LLC_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	counters->fd[PERF_BRANCH_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+	counters->fd[PERF_DTLB_MISSES] = openCounter(PERF_TYPE_HW_CACHE,
+		cacheConfig(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+
+	for (int i = 0; i < PERF_NR_OF_COUNTERS; i++) {
+		counters->value[i] = 0;
+		if (counters->fd[i] >= 0) {
+			anyAvailable = true;
+		}
+	}
+	return anyAvailable;
+}
+
+void PerfCountersStart(PerfCounters* counters)
+{
+	for (int i = 0; i < PERF_NR_OF_COUNTERS; i++) {
+		if (counters->fd[i] >= 0) {
+			ioctl(counters->fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(counters->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+}
+
+void PerfCountersStop(PerfCounters* counters)
+{
+	for (int i = 0; i < PERF_NR_OF_COUNTERS; i++) {
+		if (counters->fd[i] >= 0) {
+			ioctl(counters->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+	for (int i = 0; i < PERF_NR_OF_COUNTERS; i++) {
+		PerfReadFormat data;
+		counters->value[i] = 0;
+		if (counters->fd[i] < 0 || read(counters->fd[i], &data, sizeof(data)) != sizeof(data)) {
+			continue;
+		}
+		// Scale up when the PMU had to multiplex more events than it has registers
+		if (data.timeRunning > 0 && data.timeRunning < data.timeEnabled) {
+			counters->value[i] = (uint64_t)((double)data.value * data.timeEnabled / data.timeRunning);
+		}
+		else {
+			counters->value[i] = data.value;
+		}
+	}
+}
+
+void PerfCountersClose(PerfCounters* counters)
+{
+	for (int i = 0; i < PERF_NR_OF_COUNTERS; i++) {
+		if (counters->fd[i] >= 0) {
+			close(counters->fd[i]);
+			counters->fd[i] = -1;
+		}
+	}
+}
+
+#else // No perf_event_open on this platform: every counter is unavailable
+
+bool PerfCountersOpen(PerfCounters* counters)
+{
+	for (int i = 0; i < PERF_NR_OF_COUNTERS; i++) {
+		counters->fd[i] = -1;
+		counters->value[i] = 0;
+	}
+	return false;
+}
+
+void PerfCountersStart(PerfCounters* counters)
+{
+	(void)counters;
+}
+
+void PerfCountersStop(PerfCounters* counters)
+{
+	(void)counters;
+}
+
+void PerfCountersClose(PerfCounters* counters)
+{
+	(void)counters;
+}
+
+#endif
+
+bool PerfCounterAvailable(const PerfCounters* counters, PerfCounterId id)
+{
+	return counters->fd[id] >= 0;
+}
+
+const char* PerfCounterName(PerfCounterId id)
+{
+	return CounterNames[id];
+}
@@ -0,0 +1,55 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+#include <stdint.h>
+#include <stdbool.h>
+
+
+typedef enum {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_L1D_MISSES,
+	PERF_LLC_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_DTLB_MISSES,
+	PERF_NR_OF_COUNTERS
+} PerfCounterId;
+
+typedef struct {
+	int      fd[PERF_NR_OF_COUNTERS];   // -1 when the counter is not available
+	uint64_t value[PERF_NR_OF_COUNTERS]; // scaled values of the last Start/Stop pair
+} PerfCounters;
+
+
+/***************************************************************************************
+ * Tries to open all hardware counters for the calling thread (Linux perf_event_open).
+ * Counters that cannot be opened (no PMU in a VM, perf_event_paranoid, other OS) are
+ * simply marked unavailable, so the benchmarks keep running on wall-clock time only.
+ *
+ * Returns true when at least one counter is available
+ */
+bool PerfCountersOpen(PerfCounters* counters);
+
+
+/***************************************************************************************
+ * Resets and enables / disables all available counters. After PerfCountersStop the
+ * value array holds the counts (scaled for multiplexing) of the measured region.
+ */
+void PerfCountersStart(PerfCounters* counters);
+void PerfCountersStop(PerfCounters* counters);
+
+
+/***************************************************************************************
+ * Returns true when the given counter delivered a value
+ */
+bool PerfCounterAvailable(const PerfCounters* counters, PerfCounterId id);
+
+
+/***************************************************************************************
+ * Returns a short printable name of a counter, e.g. "cycles"
+ */
+const char* PerfCounterName(PerfCounterId id);
+
+
+void PerfCountersClose(PerfCounters* counters);
+
+#endif
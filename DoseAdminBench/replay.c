@@ -0,0 +1,130 @@
+#define _POSIX_C_SOURCE 199309L // For clock_gettime
+#include "replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const char* OpNames[OP_NR_OF_TYPES] = {
+	"AddPatient",
+	"AddPatientDose",
+	"PatientDoseInPeriod",
+	"IsPatientPresent",
+	"RemovePatient"
+};
+
+
+static double elapsedNs(const struct timespec* start, const struct timespec* end)
+{
+	return (double)(end->tv_sec - start->tv_sec) * 1e9 + (double)(end->tv_nsec - start->tv_nsec);
+}
+
+static int compareFloats(const void* a, const void* b)
+{
+	float x = *(const float*)a;
+	float y = *(const float*)b;
+	return (x > y) - (x < y);
+}
+
+static int8_t execute(const TraceOp* op)
+{
+	// The trace is read-only, the API takes non-const names
+	char* name = (char*)op->patientName;
+	Date date = op->date;
+	Date endDate = op->endDate;
+	uint32_t total;
+
+	switch (op->type) {
+	case OP_ADD_PATIENT:
+		return AddPatient(name);
+	case OP_ADD_DOSE:
+		return AddPatientExamDose(name, &date, op->dose, (EXAMINATION_TYPES)op->examType);
+	case OP_DOSE_IN_PERIOD:
+		return PatientDoseInPeriod(name, &date, &endDate, &total);
+	case OP_IS_PRESENT:
+		return IsPatientPresent(name);
+	case OP_REMOVE_PATIENT:
+		return RemovePatient(name);
+	default:
+		return -1;
+	}
+}
+
+int8_t ReplayTrace(const TraceOp* ops, size_t nrOfOps, ReplayReport* report)
+{
+	// One latency sample per operation, grouped per type afterwards
+	float* latencies = malloc((nrOfOps > 0 ? nrOfOps : 1) * sizeof(float));
+	float* grouped = malloc((nrOfOps > 0 ? nrOfOps : 1) * sizeof(float));
+	if (latencies == NULL || grouped == NULL) {
+		free(latencies);
+		free(grouped);
+		return -1;
+	}
+
+	struct timespec runStart, runEnd, opStart, opEnd;
+	*report = (ReplayReport){0};
+	report->nrOfOps = nrOfOps;
+
+	CreateHashTable();
+	clock_gettime(CLOCK_MONOTONIC, &runStart);
+	for (size_t i = 0; i < nrOfOps; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &opStart);
+		int8_t result = execute(&ops[i]);
+		clock_gettime(CLOCK_MONOTONIC, &opEnd);
+
+		latencies[i] = (float)elapsedNs(&opStart, &opEnd);
+		report->perType[ops[i].type].count++;
+		if (result != 0) {
+			report->perType[ops[i].type].failures++;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &runEnd);
+	report->seconds = elapsedNs(&runStart, &runEnd) / 1e9;
+	RemoveAllDataFromHashTable();
+
+	for (int type = 0; type < OP_NR_OF_TYPES; type++) {
+		ReplayOpStats* stats = &report->perType[type];
+		size_t n = 0;
+		for (size_t i = 0; i < nrOfOps; i++) {
+			if (ops[i].type == (TraceOpType)type) {
+				grouped[n++] = latencies[i];
+			}
+		}
+		if (n == 0) {
+			continue;
+		}
+		qsort(grouped, n, sizeof(float), compareFloats);
+		stats->p50Ns = grouped[n / 2];
+		stats->p99Ns = grouped[(n * 99) / 100];
+		stats->maxNs = grouped[n - 1];
+	}
+
+	free(latencies);
+	free(grouped);
+	return 0;
+}
+
+void PrintReplayReport(const ReplayReport* report)
+{
+	double seconds = (report->seconds > 0.0) ? report->seconds : 1e-9;
+
+	printf("%zu operations in %.3f s: %.0f ops/s (including timer overhead)\n\n",
+	       report->nrOfOps, report->seconds, report->nrOfOps / seconds);
+	printf("%-22s %10s %10s %10s %10s %10s\n", "operation", "count", "failed",
+	       "p50 ns", "p99 ns", "max ns");
+	for (int type = 0; type < OP_NR_OF_TYPES; type++) {
+		const ReplayOpStats* stats = &report->perType[type];
+		printf("%-22s %10zu %10zu %10.0f %10.0f %10.0f\n", OpNames[type], stats->count,
+		       stats->failures, stats->p50Ns, stats->p99Ns, stats->maxNs);
+	}
+}
+
+bool ReplayFailureRateWithin(const ReplayReport* report, double maxFailureRate)
+{
+	for (int type = 0; type < OP_NR_OF_TYPES; type++) {
+		const ReplayOpStats* stats = &report->perType[type];
+		if (stats->failures > maxFailureRate * (double)stats->count) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,46 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "workload.h"
+
+
+typedef struct {
+	size_t count;
+	size_t failures;    // calls that returned a non-zero status
+	double p50Ns;
+	double p99Ns;
+	double maxNs;
+} ReplayOpStats;
+
+typedef struct {
+	size_t        nrOfOps;
+	double        seconds;
+	ReplayOpStats perType[OP_NR_OF_TYPES];
+} ReplayReport;
+
+
+/***************************************************************************************
+ * Runs the operations of a trace against a freshly created dose admin and measures the
+ * latency of every call. The table is emptied again afterwards.
+ *
+ * Returns 0 on success
+ * Returns -1 when allocation of memory for the latency samples failed
+ */
+int8_t ReplayTrace(const TraceOp* ops, size_t nrOfOps, ReplayReport* report);
+
+
+/***************************************************************************************
+ * Prints throughput and the latency percentiles per operation type
+ */
+void PrintReplayReport(const ReplayReport* report);
+
+
+/***************************************************************************************
+ * Returns true when, for every operation type, at most maxFailureRate (e.g. 0.01) of 
+ * the calls failed. A trace with more failures mostly measures the error paths.
+ */
+bool ReplayFailureRateWithin(const ReplayReport* report, double maxFailureRate);
+
+#endif
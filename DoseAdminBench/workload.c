@@ -0,0 +1,428 @@
+#include "workload.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Protocol_PatientAdmin_CentralAcq.h"
+
+#define MAX_LINE_LENGTH (MAX_PATIENTNAME_SIZE + 64)
+
+static const char* Surnames[] = {
+	"vanderBerg", "vanderMeer", "vanderLinden", "vanderHeijden", "vanderVelde",
+	"vandenBroek", "vandenBosch", "vanDijk", "vanLeeuwen", "vanVliet",
+	"deVries", "deJong", "deBoer", "deGroot", "deBruijn", "deWit",
+	"Jansen", "Janssen", "Jacobs", "Bakker", "Visser", "Smit", "Meijer", "Mulder"
+};
+static const char* GivenNames[] = {
+	"Anna", "Emma", "Sophie", "Julia", "Daan", "Sem", "Lucas", "Levi",
+	"Maria", "Johannes", "Cornelis", "Hendrik", "Willem", "Jan", "Pieter", "Noor"
+};
+#define NR_OF_SURNAMES    (sizeof(Surnames) / sizeof(Surnames[0]))
+#define NR_OF_GIVEN_NAMES (sizeof(GivenNames) / sizeof(GivenNames[0]))
+
+// Dose range per examination type, fluoroscopy runs are far heavier than a single shot
+static const uint16_t MinDose[] = {5, 40, 80, 200};
+static const uint16_t MaxDose[] = {60, 300, 500, 3000};
+// Relative frequency per examination type, in percent
+static const uint8_t ExamMix[] = {55, 25, 10, 10};
+
+typedef struct {
+	uint64_t state;
+} Random;
+
+// Patients in order of arrival, by their index in the names of the trace
+typedef struct {
+	size_t* items;
+	size_t  count;
+} PatientSet;
+
+
+static uint64_t nextRandom(Random* random)
+{
+	// xorshift64*, deterministic for a given seed so traces can be regenerated
+	random->state ^= random->state >> 12;
+	random->state ^= random->state << 25;
+	random->state ^= random->state >> 27;
+	return random->state * 2685821657736338717ULL;
+}
+
+static double uniformRandom(Random* random)
+{
+	return (double)(nextRandom(random) >> 11) / (double)(1ULL << 53);
+}
+
+static uint32_t randomBelow(Random* random, uint32_t limit)
+{
+	return (uint32_t)(nextRandom(random) % limit);
+}
+
+static bool isLeapYear(uint32_t year)
+{
+	return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static uint8_t daysInMonth(uint8_t month, uint32_t year)
+{
+	static const uint8_t days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	return (month == 2 && isLeapYear(year)) ? 29 : days[month - 1];
+}
+
+static void nextDay(Date* date)
+{
+	if (date->day < daysInMonth(date->month, date->year)) {
+		date->day++;
+	}
+	else if (date->month < 12) {
+		date->day = 1;
+		date->month++;
+	}
+	else {
+		date->day = 1;
+		date->month = 1;
+		date->year++;
+	}
+}
+
+static void previousMonth(Date* date, int months)
+{
+	for (int i = 0; i < months; i++) {
+		if (date->month > 1) {
+			date->month--;
+		}
+		else {
+			date->month = 12;
+			date->year--;
+		}
+	}
+	if (date->day > daysInMonth(date->month, date->year)) {
+		date->day = daysInMonth(date->month, date->year);
+	}
+}
+
+/**
+ * @brief Builds the cumulative distribution of Zipf(s) over n ranks.
+ */
+static double* buildZipfTable(size_t n, double exponent)
+{
+	double* cdf = malloc(n * sizeof(double));
+	if (cdf == NULL) {
+		return NULL;
+	}
+	double sum = 0.0;
+	for (size_t i = 0; i < n; i++) {
+		sum += 1.0 / pow((double)(i + 1), exponent);
+		cdf[i] = sum;
+	}
+	for (size_t i = 0; i < n; i++) {
+		cdf[i] /= sum;
+	}
+	return cdf;
+}
+
+static size_t sampleZipf(Random* random, const double* cdf, size_t n)
+{
+	double u = uniformRandom(random);
+	size_t low = 0;
+	size_t high = n - 1;
+
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (cdf[mid] < u) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+static void addToSet(PatientSet* set, size_t patient)
+{
+	set->items[set->count++] = patient;
+}
+
+static void removeFromSet(PatientSet* set, size_t patient)
+{
+	// Search from the recent end, where the popular patients are
+	for (size_t i = set->count; i-- > 0;) {
+		if (set->items[i] == patient) {
+			memmove(&set->items[i], &set->items[i + 1], (set->count - i - 1) * sizeof(size_t));
+			set->count--;
+			return;
+		}
+	}
+}
+
+/**
+ * @brief Returns the patient of a popularity rank, rank 0 is the most recent arrival.
+ */
+static size_t patientOfRank(const PatientSet* set, size_t rank)
+{
+	return set->items[set->count - 1 - (rank % set->count)];
+}
+
+static void makePatientName(char name[MAX_PATIENTNAME_SIZE], Random* random, size_t id)
+{
+	snprintf(name, MAX_PATIENTNAME_SIZE, "%s_%s_%06zu",
+	         Surnames[randomBelow(random, NR_OF_SURNAMES)],
+	         GivenNames[randomBelow(random, NR_OF_GIVEN_NAMES)], id);
+}
+
+static uint8_t sampleExamType(Random* random)
+{
+	uint32_t pick = randomBelow(random, 100);
+	uint8_t type = 0;
+
+	while (type < EXAM_TYPE_FLUORO && pick >= ExamMix[type]) {
+		pick -= ExamMix[type];
+		type++;
+	}
+	return type;
+}
+
+static uint16_t sampleDose(Random* random, uint8_t examType)
+{
+	// Squaring a uniform sample gives the long tail towards high doses seen in practice
+	double u = uniformRandom(random);
+	return (uint16_t)(MinDose[examType] + u * u * (MaxDose[examType] - MinDose[examType]));
+}
+
+static void writeDate(FILE* file, const Date* date)
+{
+	fprintf(file, "%02u-%02u-%04u", date->day, date->month, date->year);
+}
+
+void DefaultWorkloadConfig(WorkloadConfig* config)
+{
+	config->nrOfPatients = 5000;
+	config->nrOfOperations = 200000;
+	config->zipfExponent = 1.0;
+	config->dosePercent = 50;
+	config->queryPercent = 30;
+	config->newPatientPercent = 2;
+	config->removePercent = 1;
+	config->examsPerDay = 40;
+	config->startDate = (Date){1, 1, 2020};
+	config->seed = 0x5eed;
+}
+
+int8_t GenerateWorkload(const WorkloadConfig* config, const char* filePath)
+{
+	if (config->nrOfPatients == 0) {
+		return -1;
+	}
+
+	// Every operation adds at most one patient
+	size_t capacity = config->nrOfPatients + config->nrOfOperations;
+	char (*names)[MAX_PATIENTNAME_SIZE] = malloc(capacity * MAX_PATIENTNAME_SIZE);
+	uint8_t* doseCounts = calloc(capacity, sizeof(uint8_t));
+	PatientSet present = {malloc(capacity * sizeof(size_t)), 0};
+	PatientSet active = {malloc(capacity * sizeof(size_t)), 0};
+	double* zipf = buildZipfTable(config->nrOfPatients, config->zipfExponent);
+	FILE* file = fopen(filePath, "w");
+	if (names == NULL || doseCounts == NULL || present.items == NULL || active.items == NULL ||
+	    zipf == NULL || file == NULL) {
+		free(names);
+		free(doseCounts);
+		free(present.items);
+		free(active.items);
+		free(zipf);
+		if (file != NULL) {
+			fclose(file);
+		}
+		return -1;
+	}
+
+	Random random = {config->seed ? config->seed : 1};
+	size_t nrOfNames = 0;
+	Date today = config->startDate;
+	uint32_t examsToday = 0;
+
+	for (; nrOfNames < config->nrOfPatients; nrOfNames++) {
+		makePatientName(names[nrOfNames], &random, nrOfNames);
+		fprintf(file, "A %s\n", names[nrOfNames]);
+		addToSet(&present, nrOfNames);
+		addToSet(&active, nrOfNames);
+	}
+
+	for (size_t op = 0; op < config->nrOfOperations; op++) {
+		uint32_t pick = randomBelow(&random, 100);
+		// Rank 0 is the most recently registered patient: recent arrivals are the active set
+		size_t rank = sampleZipf(&random, zipf, config->nrOfPatients);
+
+		if (pick < config->dosePercent) {
+			if (active.count == 0) {
+				// Every patient has a full dose history, the next exam is of a new arrival
+				makePatientName(names[nrOfNames], &random, nrOfNames);
+				fprintf(file, "A %s\n", names[nrOfNames]);
+				addToSet(&present, nrOfNames);
+				addToSet(&active, nrOfNames);
+				nrOfNames++;
+			}
+			// Only patients with room for a dose are examined, so the inserts succeed
+			size_t patient = patientOfRank(&active, rank);
+			uint8_t examType = sampleExamType(&random);
+			fprintf(file, "D %s ", names[patient]);
+			writeDate(file, &today);
+			fprintf(file, " %u %u\n", sampleDose(&random, examType), examType);
+			if (++doseCounts[patient] == MAX_DOSES_PER_PATIENT) {
+				removeFromSet(&active, patient);
+			}
+			if (++examsToday >= config->examsPerDay) {
+				examsToday = 0;
+				nextDay(&today);
+			}
+		}
+		else if (present.count == 0) {
+			// Everybody was removed, only a new arrival makes the next operations valid
+			makePatientName(names[nrOfNames], &random, nrOfNames);
+			fprintf(file, "A %s\n", names[nrOfNames]);
+			addToSet(&present, nrOfNames);
+			addToSet(&active, nrOfNames);
+			nrOfNames++;
+		}
+		else if ((pick -= config->dosePercent) < config->queryPercent) {
+			// Mostly the windows the UI asks for: last 12 months or the current year
+			Date start = today;
+			if (randomBelow(&random, 2) == 0) {
+				previousMonth(&start, 12);
+			}
+			else {
+				start.day = 1;
+				start.month = 1;
+			}
+			fprintf(file, "Q %s ", names[patientOfRank(&present, rank)]);
+			writeDate(file, &start);
+			fprintf(file, " ");
+			writeDate(file, &today);
+			fprintf(file, "\n");
+		}
+		else if ((pick -= config->queryPercent) < config->newPatientPercent) {
+			makePatientName(names[nrOfNames], &random, nrOfNames);
+			fprintf(file, "A %s\n", names[nrOfNames]);
+			addToSet(&present, nrOfNames);
+			addToSet(&active, nrOfNames);
+			nrOfNames++;
+		}
+		else if ((pick -= config->newPatientPercent) < config->removePercent) {
+			size_t patient = patientOfRank(&present, rank);
+			fprintf(file, "R %s\n", names[patient]);
+			removeFromSet(&present, patient);
+			removeFromSet(&active, patient);
+		}
+		else {
+			fprintf(file, "P %s\n", names[patientOfRank(&present, rank)]);
+		}
+	}
+
+	free(names);
+	free(doseCounts);
+	free(present.items);
+	free(active.items);
+	free(zipf);
+	return (fclose(file) == 0) ? 0 : -1;
+}
+
+static bool parseDate(const char* text, Date* date)
+{
+	unsigned day, month, year;
+	if (sscanf(text, "%u-%u-%u", &day, &month, &year) != 3) {
+		return false;
+	}
+	date->day = (uint8_t)day;
+	date->month = (uint8_t)month;
+	date->year = (uint16_t)year;
+	return true;
+}
+
+static bool parseLine(const char* line, TraceOp* op)
+{
+	char tag;
+	char first[16];
+	char second[16];
+	unsigned dose;
+	unsigned examType;
+
+	memset(op, 0, sizeof(*op));
+	if (sscanf(line, "%c %79s", &tag, op->patientName) != 2) {
+		return false;
+	}
+	const char* arguments = strchr(line + 2, ' ');
+
+	switch (tag) {
+	case 'A':
+		op->type = OP_ADD_PATIENT;
+		return true;
+	case 'P':
+		op->type = OP_IS_PRESENT;
+		return true;
+	case 'R':
+		op->type = OP_REMOVE_PATIENT;
+		return true;
+	case 'D':
+		op->type = OP_ADD_DOSE;
+		if (arguments == NULL ||
+		    sscanf(arguments, "%15s %u %u", first, &dose, &examType) != 3) {
+			return false;
+		}
+		op->dose = (uint16_t)dose;
+		op->examType = (uint8_t)examType;
+		return parseDate(first, &op->date);
+	case 'Q':
+		op->type = OP_DOSE_IN_PERIOD;
+		if (arguments == NULL || sscanf(arguments, "%15s %15s", first, second) != 2) {
+			return false;
+		}
+		return parseDate(first, &op->date) && parseDate(second, &op->endDate);
+	default:
+		return false;
+	}
+}
+
+int8_t ReadWorkload(const char* filePath, TraceOp** ops, size_t* nrOfOps)
+{
+	FILE* file = fopen(filePath, "r");
+	if (file == NULL) {
+		return -1;
+	}
+
+	char line[MAX_LINE_LENGTH];
+	size_t capacity = 1024;
+	size_t count = 0;
+	TraceOp* trace = malloc(capacity * sizeof(TraceOp));
+
+	while (trace != NULL && fgets(line, sizeof(line), file) != NULL) {
+		if (count == capacity) {
+			capacity *= 2;
+			TraceOp* grown = realloc(trace, capacity * sizeof(TraceOp));
+			if (grown == NULL) {
+				free(trace);
+				trace = NULL;
+				break;
+			}
+			trace = grown;
+		}
+		if (!parseLine(line, &trace[count])) {
+			free(trace);
+			trace = NULL;
+			break;
+		}
+		count++;
+	}
+	fclose(file);
+
+	if (trace == NULL) {
+		return -1;
+	}
+	*ops = trace;
+	*nrOfOps = count;
+	return 0;
+}
+
+char TraceOpTag(TraceOpType type)
+{
+	static const char tags[OP_NR_OF_TYPES] = {'A', 'D', 'Q', 'P', 'R'};
+	return tags[type];
+}
@@ -0,0 +1,81 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+#include <stdint.h>
+#include <stddef.h>
+#include "doseAdmin.h"
+
+
+typedef enum {
+	OP_ADD_PATIENT,       // "A name"
+	OP_ADD_DOSE,          // "D name dd-mm-yyyy dose examType"
+	OP_DOSE_IN_PERIOD,    // "Q name dd-mm-yyyy dd-mm-yyyy"
+	OP_IS_PRESENT,        // "P name"
+	OP_REMOVE_PATIENT,    // "R name"
+	OP_NR_OF_TYPES
+} TraceOpType;
+
+typedef struct {
+	TraceOpType type;
+	char        patientName[MAX_PATIENTNAME_SIZE];
+	Date        date;       // dose date, or start of the period
+	Date        endDate;    // end of the period (OP_DOSE_IN_PERIOD only)
+	uint16_t    dose;
+	uint8_t     examType;   // EXAMINATION_TYPES value of the dose
+} TraceOp;
+
+typedef struct {
+	size_t   nrOfPatients;    // registered up front, before the mixed operations
+	size_t   nrOfOperations;  // mixed operations after the registration phase
+	double   zipfExponent;    // skew of patient popularity, 0 = uniform
+	uint8_t  dosePercent;     // share of the mixed operations, the remainder are
+	uint8_t  queryPercent;    // presence checks
+	uint8_t  newPatientPercent;
+	uint8_t  removePercent;
+	uint16_t examsPerDay;     // advances the simulated clock
+	Date     startDate;
+	uint64_t seed;
+} WorkloadConfig;
+
+
+/***************************************************************************************
+ * Fills config with a clinic-like default mix: a few thousand patients, Zipf(1.0)
+ * popularity, 50% dose inserts, 30% period queries, 2% new patients, 1% removals.
+ */
+void DefaultWorkloadConfig(WorkloadConfig* config);
+
+
+/***************************************************************************************
+ * Generates a trace and writes it as text, one operation per line.
+ *
+ * Names are drawn from surnames that share long prefixes (vanderBerg, vanderMeer, ...),
+ * the patient of each operation is drawn from a Zipf distribution over the patients 
+ * by arrival, and dose dates only move forward, with a dose distribution per 
+ * examination type.
+ *
+ * Like in a clinic, a patient gets at most MAX_DOSES_PER_PATIENT exams: the popularity 
+ * of dose inserts moves over the patients that still have room, and when none is left
+ * a new patient arrives first. Removed patients are not used anymore. So every 
+ * operation of the trace is expected to succeed.
+ *
+ * Returns 0 on success
+ * Returns -1 when the file cannot be written or memory allocation failed
+ */
+int8_t GenerateWorkload(const WorkloadConfig* config, const char* filePath);
+
+
+/***************************************************************************************
+ * Reads a trace written by GenerateWorkload. The operations are allocated by this
+ * function and must be freed by the caller.
+ *
+ * Returns 0 on success
+ * Returns -1 when the file cannot be read, a line is malformed or allocation failed
+ */
+int8_t ReadWorkload(const char* filePath, TraceOp** ops, size_t* nrOfOps);
+
+
+/***************************************************************************************
+ * Returns the one character tag of an operation type as used in the trace, e.g. 'D'
+ */
+char TraceOpTag(TraceOpType type);
+
+#endif
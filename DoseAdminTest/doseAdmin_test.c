@@ -1,7 +1,14 @@
+#define _POSIX_C_SOURCE 200112L // For shm_open and mprotect, to damage a segment or guard a page
 #include <string.h>
 #include "doseAdmin.h"
+#include "nameHash.h"
 #include "unity.h"
 #include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 // I rather dislike keeping line numbers updated, so I made my own macro to ditch the line number
 #define MY_RUN_TEST(func) RUN_TEST(func, 0)
@@ -120,6 +127,39 @@ void test_AddDose_Error_DoseArrayFull(void)
     TEST_ASSERT_EQUAL_INT(-2, AddPatientDose(name1, &date, 50));
 }
 
+void test_AddDose_Error_DateOutOfRange(void)
+{
+    Date invalid[] = {{1, 1, 1850}, {31, 12, 1899}, {1, 1, 2501}, {1, 1, 2600}, {1, 0, 2025},
+                      {1, 13, 2025}, {0, 1, 2025}, {32, 1, 2025}, {29, 2, 2025}};
+    Date valid = {1, 1, 1950};
+    Date first = {1, 1, 1900};
+    Date last = {31, 12, 2500};
+    uint64_t perType[NR_OF_EXAM_TYPES];
+    uint64_t registryDose = 0;
+    size_t measurements = 0;
+    MemoryUsage before, after;
+
+    AddPatient(name1);
+    GetMemoryUsage(&before);
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        TEST_ASSERT_EQUAL_INT(-5, AddPatientDose(name1, &invalid[i], 50));
+        TEST_ASSERT_EQUAL_INT(-1, PurgeDosesBefore(&invalid[i]));
+    }
+
+    // Nothing was added to the patient or any index
+    GetMemoryUsage(&after);
+    TEST_ASSERT_EQUAL_INT(before.totalBytes, after.totalBytes);
+    GetNumberOfMeasurements(name1, &measurements);
+    TEST_ASSERT_EQUAL_INT(0, measurements);
+    GetRegistryDosePerExamType(perType);
+    TEST_ASSERT_EQUAL_INT(0, perType[EXAM_TYPE_NONE]);
+
+    // And no horizon was set, old doses can still be added
+    TEST_ASSERT_EQUAL_INT(0, AddPatientDose(name1, &valid, 50));
+    RegistryDoseInCalendarPeriod(&first, &last, &registryDose);
+    TEST_ASSERT_EQUAL_INT(50, registryDose);
+}
+
 void test_PatientDoseInPeriod_Calculation(void)
 {
     AddPatient(name1);
@@ -175,6 +215,1309 @@ void test_GetHashPerformance(void)
     TEST_ASSERT_FLOAT_WITHIN(0.0001, 0.0078125, avg);
 }
 
+void test_AddPatient_HashCollision_BothPresent(void)
+{
+    // Same characters in a different order: same sum, so the same table entry
+    char collidingName[] = "Alcie";
+
+    TEST_ASSERT_EQUAL_INT(0, AddPatient(name1));
+    TEST_ASSERT_EQUAL_INT(0, AddPatient(collidingName));
+    TEST_ASSERT_EQUAL_INT(0, IsPatientPresent(name1));
+    TEST_ASSERT_EQUAL_INT(0, IsPatientPresent(collidingName));
+
+    TEST_ASSERT_EQUAL_INT(0, RemovePatient(name1));
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientPresent(name1));
+    TEST_ASSERT_EQUAL_INT(0, IsPatientPresent(collidingName));
+}
+
+void test_MemoryUsage_GrowsAndShrinks(void)
+{
+    MemoryUsage empty, filled, afterRemove;
+    Date date = {1, 1, 2025};
+
+    GetMemoryUsage(&empty);
+    TEST_ASSERT_EQUAL_INT(0, empty.recordBytes);
+    TEST_ASSERT_EQUAL_INT(0, empty.doseBytes);
+    TEST_ASSERT_TRUE(empty.indexBytes > 0);
+
+    AddPatient(name1);
+    AddPatientDose(name1, &date, 100);
+    GetMemoryUsage(&filled);
+    TEST_ASSERT_TRUE(filled.recordBytes >= sizeof(name1));
+    TEST_ASSERT_TRUE(filled.doseBytes > 0);
+    TEST_ASSERT_EQUAL_INT(filled.recordBytes + filled.doseBytes + filled.indexBytes +
+                          filled.slackBytes, filled.totalBytes);
+
+    RemovePatient(name1);
+    GetMemoryUsage(&afterRemove);
+    TEST_ASSERT_EQUAL_INT(empty.totalBytes, afterRemove.totalBytes);
+}
+
+void test_MemoryBudget_CompactsPatients(void)
+{
+    MemoryUsage expanded, compact;
+    Date date = {1, 1, 2025};
+    Date start = {1, 1, 2025};
+    Date end = {31, 12, 2025};
+    uint32_t totalDose = 0;
+    size_t measurements = 0;
+
+    AddPatient(name1);
+    AddPatient(name2);
+    AddPatientDose(name1, &date, 100);
+    GetMemoryUsage(&expanded);
+
+    // A budget below the current usage converts the patients
+    SetMemoryBudget(expanded.totalBytes - 1);
+    GetMemoryUsage(&compact);
+    TEST_ASSERT_TRUE(compact.totalBytes < expanded.totalBytes);
+
+    // Compact patients behave exactly the same
+    TEST_ASSERT_EQUAL_INT(0, AddPatientDose(name1, &date, 50));
+    TEST_ASSERT_EQUAL_INT(0, PatientDoseInPeriod(name1, &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_UINT32(150, totalDose);
+    TEST_ASSERT_EQUAL_INT(0, GetNumberOfMeasurements(name2, &measurements));
+    TEST_ASSERT_EQUAL_INT(0, measurements);
+    for (int i = 2; i < 10; i++) {
+        TEST_ASSERT_EQUAL_INT(0, AddPatientDose(name1, &date, 1));
+    }
+    TEST_ASSERT_EQUAL_INT(-2, AddPatientDose(name1, &date, 1));
+
+    SetMemoryBudget(0);
+}
+
+void test_MemoryBudget_DecodesOverBudgetPatientsCompact(void)
+{
+    MemoryUsage usage;
+    Date date = {1, 1, 2025};
+
+    AddPatient(name1);
+    AddPatientDose(name1, &date, 100);
+    AddPatientDose(name1, &date, 200);
+    TEST_ASSERT_EQUAL_INT(1, EncodeInactivePatients(&date, 0));
+
+    // Still within the budget, but an expanded record would not fit anymore
+    GetMemoryUsage(&usage);
+    SetMemoryBudget(usage.totalBytes + 1);
+    TEST_ASSERT_EQUAL_INT(0, AddPatientDose(name1, &date, 300));
+    GetMemoryUsage(&usage);
+    TEST_ASSERT_EQUAL_INT(3 * sizeof(DoseData), usage.doseBytes);
+
+    SetMemoryBudget(0);
+}
+
+void test_EncodeInactivePatients_QueriesUseEncodedHistory(void)
+{
+    Date d1 = {3, 2, 2019};
+    Date d2 = {28, 12, 2019};
+    Date d3 = {29, 2, 2020};
+    Date recent = {1, 5, 2025};
+    Date today = {1, 6, 2025};
+    Date start = {1, 1, 2019};
+    Date end = {31, 12, 2019};
+    uint32_t totalDose = 0;
+    size_t measurements = 0;
+    MemoryUsage before, after;
+
+    AddPatient(name1);
+    AddPatient(name2);
+    AddPatientDose(name1, &d1, 100);
+    AddPatientDose(name1, &d2, 300);
+    AddPatientDose(name1, &d3, 1000);
+    AddPatientDose(name2, &recent, 50);
+    GetMemoryUsage(&before);
+
+    // Only name1 has been idle for more than a year
+    TEST_ASSERT_EQUAL_INT(1, EncodeInactivePatients(&today, 365));
+    GetMemoryUsage(&after);
+    TEST_ASSERT_TRUE(after.doseBytes < before.doseBytes);
+
+    TEST_ASSERT_EQUAL_INT(0, PatientDoseInPeriod(name1, &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_UINT32(400, totalDose);
+    TEST_ASSERT_EQUAL_INT(0, GetNumberOfMeasurements(name1, &measurements));
+    TEST_ASSERT_EQUAL_INT(3, measurements);
+
+    // A new dose expands the history again, nothing may get lost
+    TEST_ASSERT_EQUAL_INT(0, AddPatientDose(name1, &today, 7));
+    start.year = 2000;
+    end.year = 2030;
+    TEST_ASSERT_EQUAL_INT(0, PatientDoseInPeriod(name1, &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_UINT32(1407, totalDose);
+    TEST_ASSERT_EQUAL_INT(0, RemovePatient(name1));
+}
+
+void test_EvictInactivePatients_RehydratesOnAccess(void)
+{
+    char segmentPath[MAX_FILEPATH_LEGTH] = "coldTier_test.seg";
+    Date old = {10, 3, 2018};
+    Date recent = {1, 5, 2025};
+    Date today = {1, 6, 2025};
+    Date start = {1, 1, 2018};
+    Date end = {31, 12, 2018};
+    uint32_t totalDose = 0;
+    size_t measurements = 0;
+    ColdTierStats stats;
+    MemoryUsage before, after;
+
+    TEST_ASSERT_EQUAL_INT(0, EnableColdTier(segmentPath));
+    AddPatient(name1);
+    AddPatient(name2);
+    AddPatientDose(name1, &old, 120);
+    AddPatientDose(name1, &old, 80);
+    AddPatientDose(name2, &recent, 50);
+    GetMemoryUsage(&before);
+
+    TEST_ASSERT_EQUAL_INT(1, EvictInactivePatients(&today, 365));
+    GetMemoryUsage(&after);
+    GetColdTierStats(&stats);
+    TEST_ASSERT_EQUAL_INT(1, stats.evictedPatients);
+    TEST_ASSERT_TRUE(after.totalBytes < before.totalBytes);
+
+    // Answered from the index entry, no disk access
+    TEST_ASSERT_EQUAL_INT(0, IsPatientPresent(name1));
+    TEST_ASSERT_EQUAL_INT(0, GetNumberOfMeasurements(name1, &measurements));
+    TEST_ASSERT_EQUAL_INT(2, measurements);
+
+    // Needs the history: read back transparently
+    TEST_ASSERT_EQUAL_INT(0, PatientDoseInPeriod(name1, &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_UINT32(200, totalDose);
+    GetColdTierStats(&stats);
+    TEST_ASSERT_EQUAL_INT(0, stats.evictedPatients);
+    TEST_ASSERT_EQUAL_INT(1, stats.rehydrations);
+
+    // Evict again and add a dose straight away
+    TEST_ASSERT_EQUAL_INT(1, EvictInactivePatients(&today, 365));
+    TEST_ASSERT_EQUAL_INT(0, AddPatientDose(name1, &today, 5));
+    TEST_ASSERT_EQUAL_INT(0, GetNumberOfMeasurements(name1, &measurements));
+    TEST_ASSERT_EQUAL_INT(3, measurements);
+
+    TEST_ASSERT_EQUAL_INT(0, DisableColdTier());
+    remove(segmentPath);
+}
+
+void test_PatientDoseInPeriod_CachedAndInvalidatedPrecisely(void)
+{
+    Date jan = {15, 1, 2025};
+    Date jul = {15, 7, 2025};
+    Date nextYear = {15, 1, 2026};
+    Date yearStart = {1, 1, 2025};
+    Date yearEnd = {31, 12, 2025};
+    Date q1End = {31, 3, 2025};
+    uint32_t totalDose = 0;
+    PeriodCacheStats before, after;
+
+    AddPatient(name1);
+    AddPatientDose(name1, &jan, 100);
+    GetPeriodCacheStats(&before);
+
+    PatientDoseInPeriod(name1, &yearStart, &yearEnd, &totalDose);  // miss
+    PatientDoseInPeriod(name1, &yearStart, &q1End, &totalDose);    // miss
+    TEST_ASSERT_EQUAL_INT(0, PatientDoseInPeriod(name1, &yearStart, &yearEnd, &totalDose));
+    TEST_ASSERT_EQUAL_UINT32(100, totalDose);
+    GetPeriodCacheStats(&after);
+    TEST_ASSERT_EQUAL_INT(1, after.hits - before.hits);
+    TEST_ASSERT_EQUAL_INT(2, after.misses - before.misses);
+
+    // A dose outside both windows keeps them, a dose in July only drops the year
+    GetPeriodCacheStats(&before);
+    AddPatientDose(name1, &nextYear, 1);
+    AddPatientDose(name1, &jul, 50);
+    TEST_ASSERT_EQUAL_INT(0, PatientDoseInPeriod(name1, &yearStart, &q1End, &totalDose));
+    TEST_ASSERT_EQUAL_UINT32(100, totalDose);
+    TEST_ASSERT_EQUAL_INT(0, PatientDoseInPeriod(name1, &yearStart, &yearEnd, &totalDose));
+    TEST_ASSERT_EQUAL_UINT32(150, totalDose);
+    GetPeriodCacheStats(&after);
+    TEST_ASSERT_EQUAL_INT(1, after.hits - before.hits);
+    TEST_ASSERT_EQUAL_INT(1, after.misses - before.misses);
+    TEST_ASSERT_EQUAL_INT(1, after.invalidations - before.invalidations);
+}
+
+void test_PatientCursor_ByName_ReturnsSortedPatients(void)
+{
+    char name3[] = "Carol";
+    Date old = {1, 2, 2015};
+    Date today = {1, 1, 2025};
+    PatientCursor cursor;
+    const char* name;
+    const DoseData* doses;
+    size_t nrOfDoses;
+
+    AddPatient(name3);
+    AddPatient(name2);
+    AddPatient(name1);
+    AddPatientDose(name2, &today, 20);
+    AddPatientDose(name3, &old, 30);
+    AddPatientDose(name3, &old, 31);
+    EncodeInactivePatients(&today, 365); // Carol's doses now come from the encoded form
+
+    TEST_ASSERT_EQUAL_INT(0, OpenPatientCursor(&cursor, CURSOR_BY_NAME));
+    TEST_ASSERT_EQUAL_INT(0, NextPatient(&cursor, &name, &doses, &nrOfDoses));
+    TEST_ASSERT_EQUAL_STRING("Alice", name);
+    TEST_ASSERT_EQUAL_INT(0, nrOfDoses);
+    TEST_ASSERT_EQUAL_INT(0, NextPatient(&cursor, &name, &doses, &nrOfDoses));
+    TEST_ASSERT_EQUAL_STRING("Bob", name);
+    TEST_ASSERT_EQUAL_INT(1, nrOfDoses);
+    TEST_ASSERT_EQUAL_INT(20, doses[0].dose);
+    TEST_ASSERT_EQUAL_INT(0, NextPatient(&cursor, &name, &doses, &nrOfDoses));
+    TEST_ASSERT_EQUAL_STRING("Carol", name);
+    TEST_ASSERT_EQUAL_INT(2, nrOfDoses);
+    TEST_ASSERT_EQUAL_INT(31, doses[1].dose);
+    TEST_ASSERT_EQUAL_INT(2015, doses[1].date.year);
+    TEST_ASSERT_EQUAL_INT(-1, NextPatient(&cursor, &name, &doses, &nrOfDoses));
+    ClosePatientCursor(&cursor);
+}
+
+void test_PatientCursor_Unordered_SurvivesDoseInserts(void)
+{
+    // Same table entry, so the cursor walks one chain
+    char names[3][MAX_PATIENTNAME_SIZE] = {"Alice", "Alcie", "Aclie"};
+    Date old = {1, 2, 2015};
+    Date today = {1, 1, 2025};
+    PatientCursor cursor;
+    const char* name;
+    const DoseData* doses;
+    size_t nrOfDoses;
+    int seen = 0;
+
+    for (int i = 0; i < 3; i++) {
+        AddPatient(names[i]);
+        AddPatientDose(names[i], &old, 10);
+    }
+    EncodeInactivePatients(&today, 365);
+
+    OpenPatientCursor(&cursor, CURSOR_UNORDERED);
+    while (NextPatient(&cursor, &name, &doses, &nrOfDoses) == 0) {
+        char copy[MAX_PATIENTNAME_SIZE];
+        strcpy(copy, name);
+        // Expands the encoded patient, which replaces its record in the chain
+        TEST_ASSERT_EQUAL_INT(0, AddPatientDose(copy, &today, 5));
+        seen++;
+    }
+    ClosePatientCursor(&cursor);
+
+    TEST_ASSERT_EQUAL_INT(3, seen);
+}
+
+void test_WriteToFile_OneLinePerPatient(void)
+{
+    char filePath[MAX_FILEPATH_LEGTH] = "writeToFile_test.txt";
+    char line[200];
+    Date date = {5, 1, 2025};
+
+    AddPatient(name1);
+    AddPatientDose(name1, &date, 100);
+    AddPatientDose(name1, &date, 7);
+
+    TEST_ASSERT_EQUAL_INT(0, WriteToFile(filePath));
+    FILE* file = fopen(filePath, "r");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), file));
+    TEST_ASSERT_EQUAL_STRING("Alice\t05-01-2025 100\t05-01-2025 7\n", line);
+    TEST_ASSERT_NULL(fgets(line, sizeof(line), file));
+    fclose(file);
+    remove(filePath);
+}
+
+void test_PatientsExposedInPeriod_UsesDateIndex(void)
+{
+    char name3[] = "Carol";
+    char found[4][MAX_PATIENTNAME_SIZE];
+    size_t nrFound = 0;
+    Date d1 = {31, 1, 2024};
+    Date d2 = {1, 2, 2024};
+    Date d3 = {20, 6, 2024};
+    Date start = {1, 2, 2024};
+    Date end = {30, 6, 2024};
+
+    AddPatient(name1);
+    AddPatient(name2);
+    AddPatient(name3);
+    AddPatientDose(name1, &d1, 10);   // just before the period
+    AddPatientDose(name2, &d2, 10);
+    AddPatientDose(name2, &d3, 10);   // Bob twice, reported once
+    AddPatientDose(name3, &d3, 10);
+
+    TEST_ASSERT_EQUAL_INT(0, PatientsExposedInPeriod(&start, &end, found, 4, &nrFound));
+    TEST_ASSERT_EQUAL_INT(2, nrFound);
+    TEST_ASSERT_EQUAL_STRING("Bob", found[0]);
+    TEST_ASSERT_EQUAL_STRING("Carol", found[1]);
+
+    // Only one slot: the count still tells how many there are
+    TEST_ASSERT_EQUAL_INT(0, PatientsExposedInPeriod(&start, &end, found, 1, &nrFound));
+    TEST_ASSERT_EQUAL_INT(2, nrFound);
+
+    RemovePatient(name2);
+    TEST_ASSERT_EQUAL_INT(0, PatientsExposedInPeriod(&start, &end, found, 4, &nrFound));
+    TEST_ASSERT_EQUAL_INT(1, nrFound);
+    TEST_ASSERT_EQUAL_STRING("Carol", found[0]);
+}
+
+void test_PatientsExposedInPeriod_AfterBulkRemoval(void)
+{
+    static char names[2][150][MAX_PATIENTNAME_SIZE];
+    char found[1][MAX_PATIENTNAME_SIZE];
+    size_t nrFound = 0;
+    size_t nrOfRemoved = 0;
+    size_t expectedPatients = 0;
+    uint64_t expected = 0;
+    uint64_t registryDose = 0;
+    Date start = {2, 3, 2024};
+    Date end = {30, 3, 2024};
+    MemoryUsage empty, afterRemove;
+
+    // Many doses in one month, removed in bulk: the postings of the month stay right
+    GetMemoryUsage(&empty);
+    for (int i = 0; i < 300; i++) {
+        char* name = names[i % 2][i / 2];
+        Date date = {(uint8_t)(1 + i % 31), 3, 2024};
+        snprintf(name, MAX_PATIENTNAME_SIZE, "Exposed %03d", i);
+        AddPatient(name);
+        AddPatientDose(name, &date, (uint16_t)(i + 1));
+        AddPatientDose(name, &date, (uint16_t)(i + 2)); // the same day twice
+        if (i % 2 == 1 && date.day >= 2 && date.day <= 30) {
+            expectedPatients++;
+            expected += 2 * i + 3;
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, RemovePatients(names[0], 150, &nrOfRemoved));
+    TEST_ASSERT_EQUAL_INT(150, nrOfRemoved);
+    TEST_ASSERT_EQUAL_INT(0, PatientsExposedInPeriod(&start, &end, found, 1, &nrFound));
+    TEST_ASSERT_EQUAL_INT(expectedPatients, nrFound);
+    RegistryDoseInCalendarPeriod(&start, &end, &registryDose);
+    TEST_ASSERT_EQUAL_INT(expected, registryDose);
+
+    TEST_ASSERT_EQUAL_INT(0, RemovePatients(names[1], 150, &nrOfRemoved));
+    TEST_ASSERT_EQUAL_INT(0, PatientsExposedInPeriod(&start, &end, found, 1, &nrFound));
+    TEST_ASSERT_EQUAL_INT(0, nrFound);
+    ReclaimRemovedPatients();
+    GetMemoryUsage(&afterRemove);
+    TEST_ASSERT_EQUAL_INT(empty.totalBytes, afterRemove.totalBytes);
+}
+
+void test_CalendarPeriod_MatchesRawSumAtEveryAlignment(void)
+{
+    Date doses[] = {{31, 12, 2022}, {1, 1, 2023}, {15, 2, 2023}, {28, 2, 2023},
+                    {1, 3, 2023}, {31, 12, 2023}, {29, 2, 2024}};
+    Date periods[][2] = {
+        {{1, 1, 2023}, {31, 12, 2023}},   // a whole year
+        {{1, 2, 2023}, {28, 2, 2023}},    // a whole month
+        {{2, 1, 2023}, {27, 2, 2023}},    // two partial months
+        {{16, 2, 2023}, {30, 12, 2023}},  // partial edges around whole months
+        {{1, 1, 1900}, {31, 12, 2500}},   // everything
+        {{29, 2, 2024}, {29, 2, 2024}}    // a single day
+    };
+    uint32_t raw = 0;
+    uint32_t rolled = 0;
+    uint64_t registry = 0;
+
+    AddPatient(name1);
+    AddPatient(name2);
+    for (size_t i = 0; i < sizeof(doses) / sizeof(doses[0]); i++) {
+        AddPatientDose(name1, &doses[i], (uint16_t)(10 * (i + 1)));
+    }
+    AddPatientDose(name2, &doses[3], 1000);
+
+    for (size_t i = 0; i < sizeof(periods) / sizeof(periods[0]); i++) {
+        PatientDoseInPeriod(name1, &periods[i][0], &periods[i][1], &raw);
+        TEST_ASSERT_EQUAL_INT(0, PatientDoseInCalendarPeriod(name1, &periods[i][0],
+                                                             &periods[i][1], &rolled));
+        TEST_ASSERT_EQUAL_INT(raw, rolled);
+    }
+
+    // The registry totals include Bob, until he is removed
+    RegistryDoseInCalendarPeriod(&periods[3][0], &periods[3][1], &registry);
+    TEST_ASSERT_EQUAL_INT(40 + 50 + 1000, registry);
+    RemovePatient(name2);
+    RegistryDoseInCalendarPeriod(&periods[3][0], &periods[3][1], &registry);
+    TEST_ASSERT_EQUAL_INT(40 + 50, registry);
+
+    TEST_ASSERT_EQUAL_INT(-1, PatientDoseInCalendarPeriod(name2, &periods[0][0],
+                                                          &periods[0][1], &rolled));
+}
+
+void test_ExamType_StoredWithDoseAndTotalled(void)
+{
+    Date d1 = {1, 3, 2024};
+    Date d2 = {2, 3, 2024};
+    Date d3 = {3, 3, 2024};
+    Date start = {1, 1, 2024};
+    Date end = {31, 12, 2024};
+    Date today = {1, 1, 2026};
+    uint32_t perType[NR_OF_EXAM_TYPES];
+    uint64_t registry[NR_OF_EXAM_TYPES];
+    uint32_t totalDose = 0;
+
+    AddPatient(name1);
+    AddPatient(name2);
+    TEST_ASSERT_EQUAL_INT(0, AddPatientExamDose(name1, &d1, 40, EXAM_TYPE_SINGLE_SHOT));
+    TEST_ASSERT_EQUAL_INT(0, AddPatientExamDose(name1, &d2, 900, EXAM_TYPE_FLUORO));
+    TEST_ASSERT_EQUAL_INT(0, AddPatientDose(name1, &d3, 5));
+    TEST_ASSERT_EQUAL_INT(0, AddPatientExamDose(name2, &d1, 300, EXAM_TYPE_FLUORO));
+
+    TEST_ASSERT_EQUAL_INT(0, GetPatientDosePerExamType(name1, perType));
+    TEST_ASSERT_EQUAL_INT(40, perType[EXAM_TYPE_SINGLE_SHOT]);
+    TEST_ASSERT_EQUAL_INT(0, perType[EXAM_TYPE_SERIES]);
+    TEST_ASSERT_EQUAL_INT(900, perType[EXAM_TYPE_FLUORO]);
+    TEST_ASSERT_EQUAL_INT(5, perType[EXAM_TYPE_NONE]);
+    GetRegistryDosePerExamType(registry);
+    TEST_ASSERT_EQUAL_INT(1200, registry[EXAM_TYPE_FLUORO]);
+
+    // The type survives the encoded representation
+    EncodeInactivePatients(&today, 30);
+    TEST_ASSERT_EQUAL_INT(0, PatientExamDoseInPeriod(name1, EXAM_TYPE_FLUORO, &start, &end,
+                                                     &totalDose));
+    TEST_ASSERT_EQUAL_INT(900, totalDose);
+    TEST_ASSERT_EQUAL_INT(0, PatientExamDoseInPeriod(name1, EXAM_TYPE_SINGLE_SHOT, &start,
+                                                     &end, &totalDose));
+    TEST_ASSERT_EQUAL_INT(40, totalDose);
+
+    RemovePatient(name2);
+    GetRegistryDosePerExamType(registry);
+    TEST_ASSERT_EQUAL_INT(900, registry[EXAM_TYPE_FLUORO]);
+
+    // An unknown type is rejected before it reaches any per-type total
+    TEST_ASSERT_EQUAL_INT(-6, AddPatientExamDose(name1, &d1, 7,
+                                                 (EXAMINATION_TYPES)(EXAM_TYPE_NONE + 1)));
+    GetRegistryDosePerExamType(registry);
+    TEST_ASSERT_EQUAL_INT(900, registry[EXAM_TYPE_FLUORO]);
+    TEST_ASSERT_EQUAL_INT(5, registry[EXAM_TYPE_NONE]);
+}
+
+void test_ExamDoseQuantiles_WithinOnePercent(void)
+{
+    static char name[] = "Quantile";
+    const double quantiles[] = {0.0, 0.5, 0.95, 1.0};
+    uint16_t doses[4];
+    Date date = {1, 5, 2024};
+    Date start = {1, 1, 2024};
+    Date end = {31, 12, 2024};
+
+    // 100 fluoro runs of 100, 200, ... 10000 spread over patients of ten doses each
+    for (int i = 0; i < 100; i++) {
+        name[0] = (char)('A' + i / MAX_DOSES_PER_PATIENT);
+        AddPatient(name);
+        AddPatientExamDose(name, &date, (uint16_t)(100 * (i + 1)), EXAM_TYPE_FLUORO);
+    }
+    AddPatient(name2);
+    AddPatientExamDose(name2, &date, 7, EXAM_TYPE_SINGLE_SHOT);
+
+    TEST_ASSERT_EQUAL_INT(0, ExamDoseQuantiles(EXAM_TYPE_FLUORO, &start, &end, quantiles, 4,
+                                               doses));
+    TEST_ASSERT_UINT_WITHIN(1, 100, doses[0]);
+    TEST_ASSERT_UINT_WITHIN(51, 5100, doses[1]);
+    TEST_ASSERT_UINT_WITHIN(95, 9500, doses[2]);
+    TEST_ASSERT_UINT_WITHIN(100, 10000, doses[3]);
+
+    TEST_ASSERT_EQUAL_INT(0, ExamDoseQuantiles(EXAM_TYPE_SINGLE_SHOT, &start, &end, quantiles,
+                                               1, doses));
+    TEST_ASSERT_EQUAL_INT(7, doses[0]);
+    TEST_ASSERT_EQUAL_INT(-1, ExamDoseQuantiles(EXAM_TYPE_SERIES, &start, &end, quantiles, 1,
+                                                doses));
+
+    // Unknown types and quantiles outside [0, 1] are rejected
+    const double invalid[] = {-0.1, 1.5, NAN};
+    TEST_ASSERT_EQUAL_INT(-2, ExamDoseQuantiles((EXAMINATION_TYPES)(EXAM_TYPE_NONE + 1), &start,
+                                                &end, quantiles, 1, doses));
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_INT(-2, ExamDoseQuantiles(EXAM_TYPE_FLUORO, &start, &end, &invalid[i],
+                                                    1, doses));
+    }
+}
+
+void test_DoseWindows_AlertOnceWhenThresholdCrossed(void)
+{
+    DoseWindow windows[] = {{7, 1000}, {365, 1500}};
+    DoseAlert alert;
+    Date d1 = {1, 3, 2024};
+    Date d2 = {5, 3, 2024};
+    Date d3 = {6, 3, 2024};
+    Date d4 = {20, 3, 2024};
+
+    TEST_ASSERT_EQUAL_INT(0, SetDoseWindows(windows, 2));
+    AddPatient(name1);
+    AddPatientDose(name1, &d1, 600);
+    TEST_ASSERT_EQUAL_INT(-1, PollDoseAlert(&alert));
+
+    // 600 + 500 within a week crosses the 7 day threshold
+    AddPatientDose(name1, &d2, 500);
+    TEST_ASSERT_EQUAL_INT(0, PollDoseAlert(&alert));
+    TEST_ASSERT_EQUAL_STRING(name1, alert.patientName);
+    TEST_ASSERT_EQUAL_INT(7, alert.window.days);
+    TEST_ASSERT_EQUAL_INT(1100, alert.cumulativeDose);
+    TEST_ASSERT_EQUAL_INT(-1, PollDoseAlert(&alert));
+
+    // Still above the threshold: no new 7 day alert, but the yearly one is crossed
+    AddPatientDose(name1, &d3, 400);
+    TEST_ASSERT_EQUAL_INT(0, PollDoseAlert(&alert));
+    TEST_ASSERT_EQUAL_INT(365, alert.window.days);
+    TEST_ASSERT_EQUAL_INT(1500, alert.cumulativeDose);
+    TEST_ASSERT_EQUAL_INT(-1, PollDoseAlert(&alert));
+
+    // The first doses left the week window, so it can be crossed again
+    AddPatientDose(name1, &d4, 999);
+    TEST_ASSERT_EQUAL_INT(-1, PollDoseAlert(&alert));
+    AddPatientDose(name1, &d4, 1);
+    TEST_ASSERT_EQUAL_INT(0, PollDoseAlert(&alert));
+    TEST_ASSERT_EQUAL_INT(1000, alert.cumulativeDose);
+
+    TEST_ASSERT_EQUAL_INT(-1, SetDoseWindows(windows, MAX_DOSE_WINDOWS + 1));
+    TEST_ASSERT_EQUAL_INT(0, SetDoseWindows(NULL, 0));
+}
+
+void test_FindPatientsByPrefix_SortedTopK(void)
+{
+    char name[MAX_PATIENTNAME_SIZE];
+    char found[5][MAX_PATIENTNAME_SIZE];
+    size_t nrFound = 0;
+
+    // Enough names to need several blocks of the index
+    for (int i = 0; i < 200; i++) {
+        sprintf(name, "%s%03d", (i % 2 == 0) ? "vanderBerg" : "vanDijk", 199 - i);
+        TEST_ASSERT_EQUAL_INT(0, AddPatient(name));
+    }
+    AddPatient(name1);
+
+    TEST_ASSERT_EQUAL_INT(0, FindPatientsByPrefix("vanderBerg00", found, 5, &nrFound));
+    TEST_ASSERT_EQUAL_INT(5, nrFound);
+    TEST_ASSERT_EQUAL_STRING("vanderBerg001", found[0]);
+    TEST_ASSERT_EQUAL_STRING("vanderBerg009", found[4]);
+
+    TEST_ASSERT_EQUAL_INT(0, FindPatientsByPrefix("vanD", found, 5, &nrFound));
+    TEST_ASSERT_EQUAL_STRING("vanDijk000", found[0]);
+
+    RemovePatient("vanderBerg001");
+    TEST_ASSERT_EQUAL_INT(0, FindPatientsByPrefix("vanderBerg00", found, 5, &nrFound));
+    TEST_ASSERT_EQUAL_STRING("vanderBerg003", found[0]);
+
+    TEST_ASSERT_EQUAL_INT(0, FindPatientsByPrefix("Al", found, 5, &nrFound));
+    TEST_ASSERT_EQUAL_INT(1, nrFound);
+    TEST_ASSERT_EQUAL_STRING(name1, found[0]);
+    TEST_ASSERT_EQUAL_INT(0, FindPatientsByPrefix("Zz", found, 5, &nrFound));
+    TEST_ASSERT_EQUAL_INT(0, nrFound);
+}
+
+void test_LookupFilter_RejectsAbsentNamesAndGrows(void)
+{
+    char name[MAX_PATIENTNAME_SIZE];
+    LookupFilterStats stats;
+
+    // More patients than the initial filter has slots, so it is refilled at least once
+    for (int i = 0; i < 5000; i++) {
+        sprintf(name, "present%d", i);
+        TEST_ASSERT_EQUAL_INT(0, AddPatient(name));
+    }
+    for (int i = 0; i < 5000; i++) {
+        sprintf(name, "present%d", i);
+        TEST_ASSERT_EQUAL_INT(0, IsPatientPresent(name));
+        sprintf(name, "absent%d", i);
+        TEST_ASSERT_EQUAL_INT(-1, IsPatientPresent(name));
+    }
+
+    GetLookupFilterStats(&stats);
+    TEST_ASSERT_TRUE(stats.rebuilds >= 1);
+    TEST_ASSERT_TRUE(stats.rejectedLookups >= 4990);
+    TEST_ASSERT_TRUE(stats.falsePositiveRate < 0.002);
+
+    // A removed name is rejected again, the others stay present
+    TEST_ASSERT_EQUAL_INT(0, RemovePatient("present7"));
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientPresent("present7"));
+    TEST_ASSERT_EQUAL_INT(0, IsPatientPresent("present8"));
+}
+
+void test_SharedRegistry_ReaderSeesLiveChanges(void)
+{
+    static char segmentName[] = "/doseAdmin_test";
+    SharedRegistryView view;
+    DoseData doses[MAX_DOSES_PER_PATIENT];
+    size_t nrOfDoses = 0;
+    uint32_t totalDose = 0;
+    Date date = {3, 4, 2024};
+    Date start = {1, 1, 2024};
+    Date end = {31, 12, 2024};
+
+    // Patients present before publishing are copied into the segment
+    AddPatient(name1);
+    AddPatientDose(name1, &date, 120);
+    TEST_ASSERT_EQUAL_INT(0, EnableSharedRegistry(segmentName, 2));
+    TEST_ASSERT_EQUAL_INT(0, OpenSharedRegistry(segmentName, &view));
+    TEST_ASSERT_EQUAL_INT(0, SharedPatientDoses(&view, name1, doses, &nrOfDoses));
+    TEST_ASSERT_EQUAL_INT(1, nrOfDoses);
+    TEST_ASSERT_EQUAL_INT(120, doses[0].dose);
+
+    // Later changes are visible through the same mapping
+    AddPatient(name2);
+    AddPatientDose(name2, &date, 30);
+    AddPatientDose(name2, &date, 40);
+    TEST_ASSERT_EQUAL_INT(0, SharedPatientDoseInPeriod(&view, name2, &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_INT(70, totalDose);
+
+    // Room for two patients only
+    TEST_ASSERT_EQUAL_INT(-2, AddPatient("Carol"));
+    TEST_ASSERT_EQUAL_INT(0, RemovePatient(name1));
+    TEST_ASSERT_EQUAL_INT(-1, SharedPatientDoses(&view, name1, doses, &nrOfDoses));
+    TEST_ASSERT_EQUAL_INT(0, AddPatient("Carol"));
+
+    DisableSharedRegistry();
+    TEST_ASSERT_EQUAL_INT(-3, SharedPatientDoses(&view, name2, doses, &nrOfDoses));
+    CloseSharedRegistry(&view);
+    TEST_ASSERT_EQUAL_INT(-1, OpenSharedRegistry(segmentName, &view));
+}
+
+void test_SharedRegistry_ReaderStopsOnDamagedSegment(void)
+{
+    static char segmentName[] = "/doseAdmin_damaged_test";
+    SharedRegistryView view, other;
+    DoseData doses[MAX_DOSES_PER_PATIENT];
+    size_t nrOfDoses = 0;
+
+    AddPatient(name1);
+    TEST_ASSERT_EQUAL_INT(0, EnableSharedRegistry(segmentName, 2));
+    TEST_ASSERT_EQUAL_INT(0, OpenSharedRegistry(segmentName, &view));
+    int fd = shm_open(segmentName, O_RDWR, 0);
+    uint32_t* header = mmap(NULL, view.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    TEST_ASSERT_TRUE(header != MAP_FAILED);
+
+    // The second word is the sequence number, a writer that died during a change left it odd
+    header[1]++;
+    TEST_ASSERT_EQUAL_INT(-4, SharedPatientDoses(&view, name1, doses, &nrOfDoses));
+    header[1]++;
+    TEST_ASSERT_EQUAL_INT(0, SharedPatientDoses(&view, name1, doses, &nrOfDoses));
+
+    // The eighth word is the offset of the slots, it must lie within the segment
+    uint32_t slotsOffset = header[7];
+    header[7] = (uint32_t)view.size;
+    TEST_ASSERT_EQUAL_INT(-4, SharedPatientDoses(&view, name1, doses, &nrOfDoses));
+    TEST_ASSERT_EQUAL_INT(-1, OpenSharedRegistry(segmentName, &other));
+    header[7] = slotsOffset;
+    TEST_ASSERT_EQUAL_INT(0, SharedPatientDoses(&view, name1, doses, &nrOfDoses));
+
+    munmap(header, view.size);
+    DisableSharedRegistry();
+    CloseSharedRegistry(&view);
+}
+
+void test_Snapshot_SeesRegistryAsOfOpen(void)
+{
+    static char name3[] = "Carol";
+    RegistrySnapshot first;
+    RegistrySnapshot second;
+    PatientCursor cursor;
+    MemoryUsage during;
+    MemoryUsage after;
+    const char* name;
+    const DoseData* doses;
+    size_t nrOfDoses;
+    uint32_t totalDose = 0;
+    Date date = {10, 5, 2024};
+    Date start = {1, 1, 2024};
+    Date end = {31, 12, 2024};
+
+    AddPatient(name1);
+    AddPatientDose(name1, &date, 100);
+    AddPatientDose(name1, &date, 20);
+    AddPatient(name2);
+    AddPatientDose(name2, &date, 7);
+    TEST_ASSERT_EQUAL_INT(0, OpenSnapshot(&first));
+
+    // Live changes after the snapshot was opened
+    AddPatientDose(name1, &date, 3000);
+    TEST_ASSERT_EQUAL_INT(0, RemovePatient(name2));
+    AddPatient(name2);
+    AddPatientDose(name2, &date, 999);
+    AddPatient(name3);
+
+    TEST_ASSERT_EQUAL_INT(0, SnapshotPatientDoseInPeriod(&first, name1, &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_INT(120, totalDose);
+    TEST_ASSERT_EQUAL_INT(0, SnapshotPatientDoseInPeriod(&first, name2, &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_INT(7, totalDose);
+    TEST_ASSERT_EQUAL_INT(-1, SnapshotPatientDoseInPeriod(&first, name3, &start, &end, &totalDose));
+    PatientDoseInPeriod(name1, &start, &end, &totalDose);
+    TEST_ASSERT_EQUAL_INT(3120, totalDose);
+
+    // A second snapshot sees the third dose, the first one still does not
+    TEST_ASSERT_EQUAL_INT(0, OpenSnapshot(&second));
+    AddPatientDose(name1, &date, 1);
+    TEST_ASSERT_EQUAL_INT(0, SnapshotPatientDoseInPeriod(&second, name1, &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_INT(3120, totalDose);
+
+    // The cursor returns the patients as they were, even when they change underway
+    TEST_ASSERT_EQUAL_INT(0, OpenSnapshotCursor(&cursor, &first));
+    TEST_ASSERT_EQUAL_INT(0, NextPatient(&cursor, &name, &doses, &nrOfDoses));
+    TEST_ASSERT_EQUAL_STRING(name1, name);
+    TEST_ASSERT_EQUAL_INT(2, nrOfDoses);
+    TEST_ASSERT_EQUAL_INT(0, RemovePatient(name2));
+    TEST_ASSERT_EQUAL_INT(0, NextPatient(&cursor, &name, &doses, &nrOfDoses));
+    TEST_ASSERT_EQUAL_STRING(name2, name);
+    TEST_ASSERT_EQUAL_INT(1, nrOfDoses);
+    TEST_ASSERT_EQUAL_INT(7, doses[0].dose);
+    TEST_ASSERT_EQUAL_INT(-1, NextPatient(&cursor, &name, &doses, &nrOfDoses));
+    ClosePatientCursor(&cursor);
+
+    // Releasing the last snapshot frees what was kept for them
+    GetMemoryUsage(&during);
+    ReleaseSnapshot(&first);
+    ReleaseSnapshot(&second);
+    GetMemoryUsage(&after);
+    TEST_ASSERT_TRUE(after.totalBytes < during.totalBytes);
+
+    // Emptying the table ends open snapshots
+    TEST_ASSERT_EQUAL_INT(0, OpenSnapshot(&first));
+    RemoveAllDataFromHashTable();
+    TEST_ASSERT_EQUAL_INT(-3, SnapshotPatientDoseInPeriod(&first, name1, &start, &end, &totalDose));
+    ReleaseSnapshot(&first);
+}
+
+void test_ReadFromFile_RoundTripsWriteToFile(void)
+{
+    char filePath[MAX_FILEPATH_LEGTH] = "readFromFile_test.txt";
+    char name[MAX_PATIENTNAME_SIZE];
+    uint32_t perType[NR_OF_EXAM_TYPES];
+    size_t nrOfMeasurements = 0;
+    uint32_t totalDose = 0;
+    Date date = {29, 2, 2024};
+    Date start = {1, 1, 2024};
+    Date end = {31, 12, 2024};
+
+    // Large enough to be parsed in several parts
+    for (int i = 0; i < 5000; i++) {
+        sprintf(name, "patient_%04d", i);
+        AddPatient(name);
+        for (int j = 0; j < i % 4; j++) {
+            AddPatientExamDose(name, &date, (uint16_t)(i + j), (EXAMINATION_TYPES)(j % NR_OF_EXAM_TYPES));
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(0, WriteToFile(filePath));
+    RemoveAllDataFromHashTable();
+
+    TEST_ASSERT_EQUAL_INT(0, ReadFromFile(filePath));
+    for (int i = 0; i < 5000; i += 7) {
+        sprintf(name, "patient_%04d", i);
+        TEST_ASSERT_EQUAL_INT(0, GetNumberOfMeasurements(name, &nrOfMeasurements));
+        TEST_ASSERT_EQUAL_INT(i % 4, nrOfMeasurements);
+        PatientDoseInPeriod(name, &start, &end, &totalDose);
+        TEST_ASSERT_EQUAL_INT((i % 4) * i + ((i % 4) * (i % 4 - 1)) / 2, totalDose);
+    }
+    sprintf(name, "patient_%04d", 3);
+    GetPatientDosePerExamType(name, perType);
+    TEST_ASSERT_EQUAL_INT(3, perType[EXAM_TYPE_SINGLE_SHOT]);
+    TEST_ASSERT_EQUAL_INT(5, perType[EXAM_TYPE_SERIES_WITH_MOTION]);
+
+    // A malformed line rejects the whole file, the table is not touched
+    FILE* file = fopen(filePath, "a");
+    fputs("Mallory\t31-02-2024 10\n", file);
+    fclose(file);
+    TEST_ASSERT_EQUAL_INT(-1, ReadFromFile(filePath));
+    TEST_ASSERT_EQUAL_INT(0, IsPatientPresent(name));
+
+    // A patient listed twice is reported as such, the table is left empty
+    file = fopen(filePath, "w");
+    fputs("Mallory\t01-02-2024 10\nMallory\t02-02-2024 20\n", file);
+    fclose(file);
+    TEST_ASSERT_EQUAL_INT(-3, ReadFromFile(filePath));
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientPresent(name));
+    remove(filePath);
+    TEST_ASSERT_EQUAL_INT(-1, ReadFromFile(filePath));
+}
+
+void test_PatientNumber_SameOperationsAsNames(void)
+{
+    char name[MAX_PATIENTNAME_SIZE];
+    Date date = {1, 6, 2024};
+    Date start = {1, 1, 2024};
+    Date end = {31, 12, 2024};
+    uint32_t totalDose = 0;
+    size_t nrOfMeasurements = 0;
+
+    // Numbers far apart, names sharing table entries
+    for (uint64_t i = 1; i <= 1000; i++) {
+        sprintf(name, "patient_%04d", (int)i);
+        TEST_ASSERT_EQUAL_INT(0, AddPatientWithNumber(name, i * 1000003ULL));
+    }
+    TEST_ASSERT_EQUAL_INT(-1, AddPatientWithNumber("someone else", 5 * 1000003ULL));
+    TEST_ASSERT_EQUAL_INT(-1, AddPatientWithNumber("patient_0005", 42));
+    TEST_ASSERT_EQUAL_INT(-1, AddPatientWithNumber("someone else", 0));
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientPresent("someone else"));
+
+    // Patients added in between change the chains the cached links point into
+    for (uint64_t i = 1; i <= 1000; i++) {
+        TEST_ASSERT_EQUAL_INT(0, AddPatientExamDoseByNumber(i * 1000003ULL, &date, (uint16_t)i,
+                                                            EXAM_TYPE_SINGLE_SHOT));
+        if (i % 100 == 0) {
+            sprintf(name, "extra_%04d", (int)i);
+            AddPatient(name);
+        }
+    }
+    SetMemoryBudget(1); // Compacting replaces every record
+    TEST_ASSERT_EQUAL_INT(0, AddPatientDoseByNumber(7 * 1000003ULL, &date, 100));
+    SetMemoryBudget(0);
+
+    TEST_ASSERT_EQUAL_INT(0, PatientDoseInPeriodByNumber(7 * 1000003ULL, &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_INT(107, totalDose);
+    TEST_ASSERT_EQUAL_INT(0, PatientDoseInPeriod("patient_0007", &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_INT(107, totalDose);
+    TEST_ASSERT_EQUAL_INT(0, GetNumberOfMeasurementsByNumber(999 * 1000003ULL, &nrOfMeasurements));
+    TEST_ASSERT_EQUAL_INT(1, nrOfMeasurements);
+
+    // Removal by either key removes the patient under both
+    TEST_ASSERT_EQUAL_INT(0, RemovePatient("patient_0003"));
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientNumberPresent(3 * 1000003ULL));
+    TEST_ASSERT_EQUAL_INT(-1, AddPatientDoseByNumber(3 * 1000003ULL, &date, 1));
+    TEST_ASSERT_EQUAL_INT(0, RemovePatientByNumber(4 * 1000003ULL));
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientPresent("patient_0004"));
+    TEST_ASSERT_EQUAL_INT(-1, RemovePatientByNumber(4 * 1000003ULL));
+    TEST_ASSERT_EQUAL_INT(-1, PatientDoseInPeriodByNumber(12345, &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_INT(0, IsPatientNumberPresent(5 * 1000003ULL));
+
+    // A number freed by a removal can be given out again
+    TEST_ASSERT_EQUAL_INT(0, AddPatientWithNumber("patient_0003", 4 * 1000003ULL));
+    TEST_ASSERT_EQUAL_INT(0, GetNumberOfMeasurementsByNumber(4 * 1000003ULL, &nrOfMeasurements));
+    TEST_ASSERT_EQUAL_INT(0, nrOfMeasurements);
+
+    RemoveAllDataFromHashTable();
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientNumberPresent(5 * 1000003ULL));
+}
+
+void test_PurgeDosesBefore_DropsExpiredDosesLazily(void)
+{
+    Date dates[4] = {{10, 3, 2019}, {15, 6, 2020}, {1, 1, 2021}, {20, 8, 2023}};
+    Date horizon = {1, 1, 2021};
+    Date earlier = {1, 1, 2020};
+    Date start = {1, 1, 1990};
+    Date end = {31, 12, 2030};
+    Date today = {1, 1, 2025};
+    char names[3][MAX_PATIENTNAME_SIZE] = {"Ann", "Nobody", "Bob"};
+    uint32_t totalDose = 0;
+    uint64_t registryDose = 0;
+    uint64_t perType[NR_OF_EXAM_TYPES];
+    size_t nrOfMeasurements = 0;
+    size_t nrOfRemoved = 0;
+    RegistrySnapshot snapshot;
+    MemoryUsage before, after;
+
+    AddPatient("Ann");
+    AddPatient("Bob");
+    AddPatient("Cat");
+    for (int i = 0; i < 4; i++) {
+        AddPatientExamDose("Ann", &dates[i], 1, EXAM_TYPE_SINGLE_SHOT);
+        AddPatientExamDose("Bob", &dates[i], 10, EXAM_TYPE_SINGLE_SHOT);
+        AddPatientExamDose("Cat", &dates[i], 100, EXAM_TYPE_SINGLE_SHOT);
+    }
+    EncodeInactivePatients(&today, 365); // Cat is compacted from the encoded form
+    TEST_ASSERT_EQUAL_INT(0, OpenSnapshot(&snapshot));
+
+    PurgeDosesBefore(&horizon);
+    PurgeDosesBefore(&earlier); // Ignored, the horizon only moves forward
+    TEST_ASSERT_EQUAL_INT(0, PatientDoseInPeriod("Ann", &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_INT(2, totalDose);
+    TEST_ASSERT_EQUAL_INT(0, GetNumberOfMeasurements("Ann", &nrOfMeasurements));
+    TEST_ASSERT_EQUAL_INT(2, nrOfMeasurements);
+    RegistryDoseInCalendarPeriod(&start, &end, &registryDose);
+    TEST_ASSERT_EQUAL_INT(222, registryDose);
+    TEST_ASSERT_EQUAL_INT(-4, AddPatientDose("Ann", &dates[1], 5));
+
+    // Bob and Cat were not used since the purge
+    TEST_ASSERT_EQUAL_INT(2, CompactExpiredPatients(SIZE_MAX));
+    TEST_ASSERT_EQUAL_INT(0, CompactExpiredPatients(SIZE_MAX));
+    GetRegistryDosePerExamType(perType);
+    TEST_ASSERT_EQUAL_INT(222, perType[EXAM_TYPE_SINGLE_SHOT]);
+    TEST_ASSERT_EQUAL_INT(0, PatientDoseInPeriod("Cat", &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_INT(200, totalDose);
+
+    // The snapshot still sees the registry as it was when it was opened
+    TEST_ASSERT_EQUAL_INT(0, SnapshotPatientDoseInPeriod(&snapshot, "Cat", &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_INT(400, totalDose);
+    ReleaseSnapshot(&snapshot);
+
+    // Removed in bulk: gone right away, the memory is given back by the reclaim
+    GetMemoryUsage(&before);
+    TEST_ASSERT_EQUAL_INT(0, RemovePatients(names, 3, &nrOfRemoved));
+    TEST_ASSERT_EQUAL_INT(2, nrOfRemoved);
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientPresent("Ann"));
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientPresent("Bob"));
+    TEST_ASSERT_EQUAL_INT(0, IsPatientPresent("Cat"));
+    TEST_ASSERT_EQUAL_INT(2, ReclaimRemovedPatients());
+    GetMemoryUsage(&after);
+    TEST_ASSERT_TRUE(after.recordBytes < before.recordBytes);
+}
+
+void test_ChangeFeed_ExportsChangesSinceSequence(void)
+{
+    Date date = {3, 4, 2024};
+    Date horizon = {1, 1, 2020};
+    uint8_t buffer[2 * MAX_CHANGE_SIZE];
+    const uint8_t types[] = {CHANGE_ADD_PATIENT, CHANGE_ADD_DOSE, CHANGE_ADD_PATIENT,
+                             CHANGE_ADD_DOSE, CHANGE_REMOVE_PATIENT, CHANGE_PURGE_DOSES};
+    size_t nrOfBytes = 0;
+    size_t nrOfChanges = 0;
+    PatientChange change;
+
+    AddPatient("Before"); // Not in the log, it was not enabled yet
+    EnableChangeFeed();
+    uint64_t start = GetChangeSequence();
+    AddPatient("Ann");
+    AddPatientExamDose("Ann", &date, 42, EXAM_TYPE_SINGLE_SHOT);
+    AddPatient("Bob");
+    AddPatientDose("Bob", &date, 7);
+    RemovePatient("Ann");
+    PurgeDosesBefore(&horizon);
+    TEST_ASSERT_EQUAL_INT(start + 6, GetChangeSequence());
+
+    // A small buffer takes several calls, each continuing where the previous one ended
+    uint64_t sequence = start;
+    while (sequence < GetChangeSequence()) {
+        TEST_ASSERT_EQUAL_INT(0, ExportChangesSince(sequence, buffer, sizeof(buffer),
+                                                    &nrOfBytes, &sequence));
+        const uint8_t* position = buffer;
+        while (ReadPatientChange(&position, buffer + nrOfBytes, &change) == 0) {
+            TEST_ASSERT_EQUAL_INT(types[nrOfChanges], change.type);
+            nrOfChanges++;
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(6, nrOfChanges);
+
+    // Only what came after a sequence number
+    TEST_ASSERT_EQUAL_INT(0, ExportChangesSince(start + 1, buffer, sizeof(buffer),
+                                                &nrOfBytes, &sequence));
+    TEST_ASSERT_EQUAL_INT(GetChangeSequence(), sequence);
+    const uint8_t* position = buffer;
+    TEST_ASSERT_EQUAL_INT(0, ReadPatientChange(&position, buffer + nrOfBytes, &change));
+    TEST_ASSERT_EQUAL_INT(CHANGE_ADD_DOSE, change.type);
+    TEST_ASSERT_EQUAL_STRING("Ann", change.patientName);
+    TEST_ASSERT_EQUAL_INT(42, change.dose.dose);
+    TEST_ASSERT_EQUAL_INT(EXAM_TYPE_SINGLE_SHOT, change.dose.examType);
+    TEST_ASSERT_EQUAL_INT(2024, change.dose.date.year);
+    TEST_ASSERT_EQUAL_INT(4, change.dose.date.month);
+    TEST_ASSERT_EQUAL_INT(3, change.dose.date.day);
+    TEST_ASSERT_EQUAL_INT(-1, ReadPatientChange(&position, position + 1, &change));
+
+    TEST_ASSERT_EQUAL_INT(-3, ExportChangesSince(start, buffer, 2, &nrOfBytes, &sequence));
+    TEST_ASSERT_EQUAL_INT(-1, ExportChangesSince(GetChangeSequence() + 1, buffer, sizeof(buffer),
+                                                 &nrOfBytes, &sequence));
+    TEST_ASSERT_EQUAL_INT(-2, ExportChangesSince(start - 1, buffer, sizeof(buffer),
+                                                 &nrOfBytes, &sequence));
+
+    // Emptying the registry is a change as well
+    RemoveAllDataFromHashTable();
+    TEST_ASSERT_EQUAL_INT(0, ExportChangesSince(start + 6, buffer, sizeof(buffer),
+                                                &nrOfBytes, &sequence));
+    TEST_ASSERT_EQUAL_INT(1, nrOfBytes);
+    DisableChangeFeed();
+    TEST_ASSERT_EQUAL_INT(-2, ExportChangesSince(start, buffer, sizeof(buffer),
+                                                 &nrOfBytes, &sequence));
+}
+
+void test_Archive_AnswersSinglePatientsFromFile(void)
+{
+    char filePath[MAX_FILEPATH_LEGTH] = "archive_test.bin";
+    char name[MAX_PATIENTNAME_SIZE];
+    DoseData doses[MAX_DOSES_PER_PATIENT];
+    size_t nrOfDoses = 0;
+    uint32_t totalDose = 0;
+    Date dates[3] = {{10, 1, 2024}, {2, 1, 2024}, {15, 6, 2024}}; // Not in date order
+    Date start = {1, 1, 2024};
+    Date end = {31, 3, 2024};
+    PatientArchive archive;
+
+    // Many blocks, names that share long prefixes
+    for (int i = 0; i < 3000; i++) {
+        sprintf(name, "department_radiology_%05d", i);
+        AddPatient(name);
+        for (int j = 0; j < i % 4; j++) {
+            AddPatientExamDose(name, &dates[j], (uint16_t)(i + j), EXAM_TYPE_SINGLE_SHOT);
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(0, WriteArchive(filePath));
+    RemoveAllDataFromHashTable(); // The archive does not need the table
+
+    TEST_ASSERT_EQUAL_INT(0, OpenArchive(filePath, &archive));
+    TEST_ASSERT_TRUE(archive.nrOfBlocks > 1);
+    for (int i = 0; i < 3000; i += 7) {
+        sprintf(name, "department_radiology_%05d", i);
+        TEST_ASSERT_EQUAL_INT(0, ArchiveIsPatientPresent(&archive, name));
+        TEST_ASSERT_EQUAL_INT(0, ArchivePatientDoseInPeriod(&archive, name, &start, &end, &totalDose));
+        TEST_ASSERT_EQUAL_INT(((i % 4) >= 1 ? i : 0) + ((i % 4) >= 2 ? i + 1 : 0), totalDose);
+    }
+    sprintf(name, "department_radiology_%05d", 3);
+    TEST_ASSERT_EQUAL_INT(0, ArchivePatientDoses(&archive, name, doses, &nrOfDoses));
+    TEST_ASSERT_EQUAL_INT(3, nrOfDoses);
+    TEST_ASSERT_EQUAL_INT(2, doses[1].date.day);
+    TEST_ASSERT_EQUAL_INT(5, doses[2].dose);
+    TEST_ASSERT_EQUAL_INT(EXAM_TYPE_SINGLE_SHOT, doses[2].examType);
+
+    TEST_ASSERT_EQUAL_INT(-1, ArchiveIsPatientPresent(&archive, "aardvark"));
+    TEST_ASSERT_EQUAL_INT(-1, ArchiveIsPatientPresent(&archive, "department_radiology_0100"));
+    TEST_ASSERT_EQUAL_INT(-1, ArchiveIsPatientPresent(&archive, "zebra"));
+    CloseArchive(&archive);
+
+    // Not an archive
+    FILE* file = fopen(filePath, "w");
+    fputs("Ann\t01-01-2024 10\n", file);
+    fclose(file);
+    TEST_ASSERT_EQUAL_INT(-1, OpenArchive(filePath, &archive));
+    remove(filePath);
+}
+
+void test_ImportCsvFile_AddsRowsAndReportsFailedOnes(void)
+{
+    char filePath[MAX_FILEPATH_LEGTH] = "import_test.csv";
+    char longName[MAX_PATIENTNAME_SIZE + 10];
+    CsvImportStats stats;
+    CsvRowError errors[2];
+    size_t nrOfMeasurements = 0;
+    uint32_t totalDose = 0;
+    uint32_t perType[NR_OF_EXAM_TYPES];
+    Date start = {1, 1, 2024};
+    Date end = {31, 12, 2024};
+
+    memset(longName, 'x', sizeof(longName) - 1);
+    longName[sizeof(longName) - 1] = '\0';
+    AddPatient("Ann");
+    FILE* file = fopen(filePath, "w");
+    fputs("name,date,dose\n", file);
+    fputs("Ann,2024-03-01,10\n", file);
+    fputs("Ann,02-03-2024,20,1\r\n", file);
+    fputs("\"Doe, \"\"Jo\"\"\",2024-05-06,30\n", file);
+    fputs("\n", file);
+    fputs("Bob,2024-02-30,40\n", file);   // No such date
+    fprintf(file, "%s,2024-01-01,50\n", longName);
+    fputs("Bob,2024-01-01\n", file);      // No dose
+    fputs("Bob,2024-01-01,60", file);      // No line end at the end of the file
+    fclose(file);
+
+    TEST_ASSERT_EQUAL_INT(0, ImportCsvFile(filePath, &stats, errors, 2));
+    TEST_ASSERT_EQUAL_INT(7, stats.rows);
+    TEST_ASSERT_EQUAL_INT(4, stats.importedRows);
+    TEST_ASSERT_EQUAL_INT(2, stats.addedPatients);
+    TEST_ASSERT_EQUAL_INT(3, stats.failedRows);
+    TEST_ASSERT_EQUAL_INT(6, errors[0].line);
+    TEST_ASSERT_EQUAL_INT(-1, errors[0].result);
+    TEST_ASSERT_EQUAL_INT(7, errors[1].line);
+    TEST_ASSERT_EQUAL_INT(-3, errors[1].result);
+
+    TEST_ASSERT_EQUAL_INT(0, PatientDoseInPeriod("Ann", &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_INT(30, totalDose);
+    GetPatientDosePerExamType("Ann", perType);
+    TEST_ASSERT_EQUAL_INT(20, perType[EXAM_TYPE_SERIES]);
+    TEST_ASSERT_EQUAL_INT(0, GetNumberOfMeasurements("Doe, \"Jo\"", &nrOfMeasurements));
+    TEST_ASSERT_EQUAL_INT(1, nrOfMeasurements);
+    TEST_ASSERT_EQUAL_INT(0, PatientDoseInPeriod("Bob", &start, &end, &totalDose));
+    TEST_ASSERT_EQUAL_INT(60, totalDose);
+
+    remove(filePath);
+    TEST_ASSERT_EQUAL_INT(-1, ImportCsvFile(filePath, &stats, errors, 2));
+}
+
+void test_ExportColumns_WritesNumpyArrays(void)
+{
+    char filePrefix[MAX_FILEPATH_LEGTH] = "columns_test_";
+    const char* files[] = {"columns_test_patient.npy", "columns_test_day.npy",
+                           "columns_test_dose.npy", "columns_test_examType.npy",
+                           "columns_test_names.npy"};
+    uint8_t data[128 + 3 * MAX_PATIENTNAME_SIZE];
+    Date date = {2, 1, 1900};
+
+    AddPatient("Ann");
+    AddPatient("Bob");
+    AddPatientExamDose("Ann", &date, 300, EXAM_TYPE_FLUORO);
+    AddPatientDose("Ann", &date, 5);
+    TEST_ASSERT_EQUAL_INT(0, ExportColumns(filePrefix));
+
+    // A 128 byte header, then the array; both patients have a name, only Ann has doses
+    FILE* file = fopen(files[0], "rb");
+    size_t size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    TEST_ASSERT_EQUAL_INT(128 + 2 * 4, size);
+    TEST_ASSERT_EQUAL_MEMORY("\x93NUMPY\x01\x00", data, 8);
+    TEST_ASSERT_EQUAL_INT(128 - 10, data[8]); // Length of the rest of the header
+    TEST_ASSERT_EQUAL_MEMORY("{'descr': '<u4', 'fortran_order': False, 'shape': (2,), }", data + 10, 57);
+    TEST_ASSERT_EQUAL_INT('\n', data[127]);
+    uint32_t annRow = data[128];
+    TEST_ASSERT_EQUAL_INT(annRow, data[132]);
+
+    file = fopen(files[1], "rb");
+    size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    TEST_ASSERT_EQUAL_INT(128 + 2 * 4, size);
+    TEST_ASSERT_EQUAL_INT(1, data[128]); // Days since 1 January 1900
+
+    file = fopen(files[2], "rb");
+    size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    TEST_ASSERT_EQUAL_INT(128 + 2 * 2, size);
+    TEST_ASSERT_EQUAL_INT(300, data[128] | (data[129] << 8));
+
+    file = fopen(files[3], "rb");
+    size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    TEST_ASSERT_EQUAL_INT(128 + 2, size);
+    TEST_ASSERT_EQUAL_INT(EXAM_TYPE_FLUORO, data[128]);
+    TEST_ASSERT_EQUAL_INT(EXAM_TYPE_NONE, data[129]);
+
+    file = fopen(files[4], "rb");
+    size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    TEST_ASSERT_EQUAL_INT(128 + 2 * (MAX_PATIENTNAME_SIZE - 1), size);
+    TEST_ASSERT_EQUAL_STRING("Ann", (char*)data + 128 + annRow * (MAX_PATIENTNAME_SIZE - 1));
+
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        remove(files[i]);
+    }
+}
+
+void test_MaintenanceThreads_SameResultsInParallel(void)
+{
+    char name[MAX_PATIENTNAME_SIZE];
+    char segmentPath[MAX_FILEPATH_LEGTH] = "maintenance_test.seg";
+    MemoryUsage empty, afterRemove;
+    Date date = {1, 1, 2025};
+    Date recent = {1, 6, 2026};
+    Date horizon = {1, 6, 2025};
+    Date today = {1, 7, 2026};
+    Date start = {1, 1, 2020};
+    uint64_t registryDose = 0;
+    size_t total, measurements;
+    double average, deviation;
+    const size_t nrOfPatients = 20000; // Enough to be split over the threads
+
+    SetMaintenanceThreads(4);
+    GetMemoryUsage(&empty);
+    for (size_t i = 0; i < nrOfPatients; i++) {
+        // Digits first, so the names spread over many table entries and threads
+        snprintf(name, sizeof(name), "%05zu Patient", i);
+        TEST_ASSERT_EQUAL_INT(0, AddPatient(name));
+        if (i % 10 == 0) {
+            AddPatientDose(name, &date, 100);
+        }
+        else if (i % 10 == 1) {
+            AddPatientDose(name, &recent, 10);
+        }
+    }
+
+    GetHashPerformance(&total, &average, &deviation);
+    TEST_ASSERT_EQUAL_INT(nrOfPatients, total);
+    TEST_ASSERT_EQUAL_INT(nrOfPatients, (size_t)(average * HASHTABLE_SIZE + 0.5));
+
+    // The passes find the patients on the threads and change them on this one; a small
+    // step of the compaction only looks at part of the table
+    TEST_ASSERT_EQUAL_INT(0, PurgeDosesBefore(&horizon));
+    total = CompactExpiredPatients(1000);
+    TEST_ASSERT_TRUE(total < nrOfPatients / 10);
+    total += CompactExpiredPatients(SIZE_MAX);
+    TEST_ASSERT_EQUAL_INT(nrOfPatients / 10, total);
+    TEST_ASSERT_EQUAL_INT(nrOfPatients - nrOfPatients / 10, EncodeInactivePatients(&today, 180));
+    TEST_ASSERT_EQUAL_INT(0, EnableColdTier(segmentPath));
+    TEST_ASSERT_EQUAL_INT(nrOfPatients - nrOfPatients / 10, EvictInactivePatients(&today, 180));
+    TEST_ASSERT_EQUAL_INT(0, DisableColdTier());
+    remove(segmentPath);
+    RegistryDoseInCalendarPeriod(&start, &today, &registryDose);
+    TEST_ASSERT_EQUAL_INT(10 * (nrOfPatients / 10), registryDose);
+    TEST_ASSERT_EQUAL_INT(0, GetNumberOfMeasurements("00000 Patient", &measurements));
+    TEST_ASSERT_EQUAL_INT(0, measurements);
+    TEST_ASSERT_EQUAL_INT(0, GetNumberOfMeasurements("19991 Patient", &measurements));
+    TEST_ASSERT_EQUAL_INT(1, measurements);
+
+    RemoveAllDataFromHashTable();
+    GetMemoryUsage(&afterRemove);
+    TEST_ASSERT_EQUAL_INT(empty.totalBytes, afterRemove.totalBytes);
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientPresent("00000 Patient"));
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientPresent("19999 Patient"));
+    GetHashPerformance(&total, &average, &deviation);
+    TEST_ASSERT_EQUAL_INT(0, total);
+    SetMaintenanceThreads(0);
+}
+
+void test_NameKey_LengthsPrefixesAndPageEnds(void)
+{
+    char name[MAX_PATIENTNAME_SIZE + 1];
+    NameKey key, other;
+
+    // Up to MAX_PATIENTNAME_SIZE - 1 characters fit, with the terminator
+    memset(name, 'x', MAX_PATIENTNAME_SIZE);
+    name[MAX_PATIENTNAME_SIZE - 1] = '\0';
+    TEST_ASSERT_TRUE(MakeNameKey(name, &key));
+    TEST_ASSERT_EQUAL_INT(MAX_PATIENTNAME_SIZE - 1, key.length);
+    TEST_ASSERT_TRUE(key.hash == NameHash(name));
+    TEST_ASSERT_EQUAL_INT(0, AddPatient(name));
+    TEST_ASSERT_EQUAL_INT(0, IsPatientPresent(name));
+    name[MAX_PATIENTNAME_SIZE - 1] = 'x';
+    name[MAX_PATIENTNAME_SIZE] = '\0';
+    TEST_ASSERT_FALSE(MakeNameKey(name, &key));
+    TEST_ASSERT_EQUAL_INT(-3, AddPatient(name));
+
+    // Names that share whole chunks differ in the chunk after them
+    TEST_ASSERT_TRUE(MakeNameKey("vanderBerg_Maria", &key));
+    TEST_ASSERT_TRUE(MakeNameKey("vanderBerg_Maria1", &other));
+    TEST_ASSERT_FALSE(NameKeyEquals(&key, other.slot));
+    TEST_ASSERT_FALSE(NameKeyEquals(&other, key.slot));
+    TEST_ASSERT_TRUE(MakeNameKey("vanderBerg_Maria_Johanna_Petra_1", &key));
+    TEST_ASSERT_TRUE(MakeNameKey("vanderBerg_Maria_Johanna_Petra_2", &other));
+    TEST_ASSERT_FALSE(NameKeyEquals(&key, other.slot));
+    TEST_ASSERT_TRUE(MakeNameKey("vanderBerg_Maria_Johanna_Petra_1", &other));
+    TEST_ASSERT_TRUE(NameKeyEquals(&key, other.slot));
+    TEST_ASSERT_EQUAL_INT(key.bucket, other.bucket);
+
+    // A name that ends right before an unmapped page gives the same key as a copy
+    long pageSize = sysconf(_SC_PAGESIZE);
+    void* memory = NULL;
+    TEST_ASSERT_EQUAL_INT(0, posix_memalign(&memory, (size_t)pageSize, 2 * (size_t)pageSize));
+    char* pages = memory;
+    TEST_ASSERT_EQUAL_INT(0, mprotect(pages + pageSize, (size_t)pageSize, PROT_NONE));
+    for (size_t length = 0; length < MAX_PATIENTNAME_SIZE; length++) {
+        char* atPageEnd = pages + pageSize - length - 1;
+        for (size_t i = 0; i < length; i++) {
+            atPageEnd[i] = (char)('a' + i % 26);
+        }
+        atPageEnd[length] = '\0';
+        memcpy(name, atPageEnd, length + 1);
+        TEST_ASSERT_TRUE(MakeNameKey(atPageEnd, &key));
+        TEST_ASSERT_TRUE(MakeNameKey(name, &other));
+        TEST_ASSERT_EQUAL_INT(length, key.length);
+        TEST_ASSERT_TRUE(key.hash == other.hash);
+        TEST_ASSERT_EQUAL_INT(other.bucket, key.bucket);
+        TEST_ASSERT_TRUE(NameKeyEquals(&key, other.slot));
+    }
+    mprotect(pages + pageSize, (size_t)pageSize, PROT_READ | PROT_WRITE);
+    free(memory);
+}
+
+void test_NameKey_FindsCompactAndEncodedPatients(void)
+{
+    static char names[][MAX_PATIENTNAME_SIZE] = {
+        "vanderBerg_Maria", "vanderBerg_Maria1", "vanderBerg_Mari", "vanderBerg_Maria_Johanna_Petra"
+    };
+    const size_t nrOfNames = sizeof(names) / sizeof(names[0]);
+    Date date = {1, 1, 2025};
+    size_t measurements = 0;
+
+    for (size_t i = 0; i < nrOfNames; i++) {
+        AddPatient(names[i]);
+        AddPatientDose(names[i], &date, (uint16_t)(10 + i));
+    }
+
+    // Compact: exact-length names, zero padded to their slot only
+    SetMemoryBudget(1);
+    for (size_t i = 0; i < nrOfNames; i++) {
+        TEST_ASSERT_EQUAL_INT(0, GetNumberOfMeasurements(names[i], &measurements));
+        TEST_ASSERT_EQUAL_INT(1, measurements);
+    }
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientPresent("vanderBerg_Maria_Johanna"));
+
+    // Encoded: the dose history follows right behind the slot of the name
+    TEST_ASSERT_EQUAL_INT(nrOfNames, EncodeInactivePatients(&date, 0));
+    for (size_t i = 0; i < nrOfNames; i++) {
+        TEST_ASSERT_EQUAL_INT(0, IsPatientPresent(names[i]));
+    }
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientPresent("vanderBerg_Maria2"));
+    TEST_ASSERT_EQUAL_INT(-1, IsPatientPresent("vanderBerg_Maria_Johanna_Petr"));
+    TEST_ASSERT_EQUAL_INT(0, AddPatientDose(names[3], &date, 5));
+    TEST_ASSERT_EQUAL_INT(0, GetNumberOfMeasurements(names[3], &measurements));
+    TEST_ASSERT_EQUAL_INT(2, measurements);
+
+    SetMemoryBudget(0);
+}
+
 // add here all your dose admin testcases, and call them in main!! Remove the given testcases
 
 int main(void)
@@ -190,9 +1533,41 @@ int main(void)
     MY_RUN_TEST(test_AddDose_And_GetMeasurements);
     MY_RUN_TEST(test_AddDose_Error_PatientNotFound);
     MY_RUN_TEST(test_AddDose_Error_DoseArrayFull);
+    MY_RUN_TEST(test_AddDose_Error_DateOutOfRange);
     MY_RUN_TEST(test_PatientDoseInPeriod_Calculation);
     MY_RUN_TEST(test_PatientDoseInPeriod_NoDoses);
     MY_RUN_TEST(test_GetHashPerformance);
+    MY_RUN_TEST(test_AddPatient_HashCollision_BothPresent);
+    MY_RUN_TEST(test_MemoryUsage_GrowsAndShrinks);
+    MY_RUN_TEST(test_MemoryBudget_CompactsPatients);
+    MY_RUN_TEST(test_MemoryBudget_DecodesOverBudgetPatientsCompact);
+    MY_RUN_TEST(test_EncodeInactivePatients_QueriesUseEncodedHistory);
+    MY_RUN_TEST(test_EvictInactivePatients_RehydratesOnAccess);
+    MY_RUN_TEST(test_PatientDoseInPeriod_CachedAndInvalidatedPrecisely);
+    MY_RUN_TEST(test_PatientCursor_ByName_ReturnsSortedPatients);
+    MY_RUN_TEST(test_PatientCursor_Unordered_SurvivesDoseInserts);
+    MY_RUN_TEST(test_WriteToFile_OneLinePerPatient);
+    MY_RUN_TEST(test_PatientsExposedInPeriod_UsesDateIndex);
+    MY_RUN_TEST(test_PatientsExposedInPeriod_AfterBulkRemoval);
+    MY_RUN_TEST(test_CalendarPeriod_MatchesRawSumAtEveryAlignment);
+    MY_RUN_TEST(test_ExamType_StoredWithDoseAndTotalled);
+    MY_RUN_TEST(test_ExamDoseQuantiles_WithinOnePercent);
+    MY_RUN_TEST(test_DoseWindows_AlertOnceWhenThresholdCrossed);
+    MY_RUN_TEST(test_FindPatientsByPrefix_SortedTopK);
+    MY_RUN_TEST(test_LookupFilter_RejectsAbsentNamesAndGrows);
+    MY_RUN_TEST(test_SharedRegistry_ReaderSeesLiveChanges);
+    MY_RUN_TEST(test_SharedRegistry_ReaderStopsOnDamagedSegment);
+    MY_RUN_TEST(test_Snapshot_SeesRegistryAsOfOpen);
+    MY_RUN_TEST(test_ReadFromFile_RoundTripsWriteToFile);
+    MY_RUN_TEST(test_PatientNumber_SameOperationsAsNames);
+    MY_RUN_TEST(test_PurgeDosesBefore_DropsExpiredDosesLazily);
+    MY_RUN_TEST(test_ChangeFeed_ExportsChangesSinceSequence);
+    MY_RUN_TEST(test_Archive_AnswersSinglePatientsFromFile);
+    MY_RUN_TEST(test_ImportCsvFile_AddsRowsAndReportsFailedOnes);
+    MY_RUN_TEST(test_ExportColumns_WritesNumpyArrays);
+    MY_RUN_TEST(test_MaintenanceThreads_SameResultsInParallel);
+    MY_RUN_TEST(test_NameKey_LengthsPrefixesAndPageEnds);
+    MY_RUN_TEST(test_NameKey_FindsCompactAndEncodedPatients);
 
     // You can keep these original tests if you want
     // MY_RUN_TEST(test_FailTest);
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include "menu.h"
 #include <fcntl.h>
 #include "doseAdmin.h"
@@ -10,6 +11,55 @@ typedef enum {
 	CONNECTED_WITH_CENTRAL_ACQUISITION
 } CENTRAL_ACQUISITION_CONNECTION_STATE;
 
+// Cumulative dose limits that are reported while the admin runs, in the units of the
+// dose data received from CentralAcquisition
+static const DoseWindow DoseWindows[] = {
+	{7, 5000},
+	{90, 20000},
+	{365, 50000}
+};
+
+#define MAX_SEARCH_RESULTS (10)
+
+static void selectPatient(char selectedPatient[MAX_PATIENTNAME_SIZE])
+{
+	char prefix[MAX_PATIENTNAME_SIZE];
+	char matches[MAX_SEARCH_RESULTS][MAX_PATIENTNAME_SIZE];
+	char choice[MAX_PATIENTNAME_SIZE];
+	size_t nrOfMatches = 0;
+	int selection = -1;
+
+	getText("Patient name starts with: ", prefix, sizeof(prefix));
+	FindPatientsByPrefix(prefix, matches, MAX_SEARCH_RESULTS, &nrOfMatches);
+	if (nrOfMatches == 0) {
+		printf("No patient found starting with \"%s\"\n", prefix);
+		return;
+	}
+
+	for (size_t i = 0; i < nrOfMatches; i++) {
+		printf("  [%zu] %s\n", i, matches[i]);
+	}
+	getText("select: ", choice, sizeof(choice));
+	if (sscanf(choice, "%d", &selection) == 1 && selection >= 0 &&
+	    (size_t)selection < nrOfMatches) {
+		strcpy(selectedPatient, matches[selection]);
+		printf("Selected patient: %s\n", selectedPatient);
+	}
+	else {
+		printf("Invalid selection, %s stays selected\n", selectedPatient);
+	}
+}
+
+static void displayDoseAlerts(void)
+{
+	DoseAlert alert;
+	while (PollDoseAlert(&alert) == 0) {
+		printf("\nDOSE ALERT: %s received %u in the last %u days (threshold %u) on %02u-%02u-%04u\n",
+		       alert.patientName, alert.cumulativeDose, alert.window.days, alert.window.threshold,
+		       alert.date.day, alert.date.month, alert.date.year);
+	}
+}
+
 /*---------------------------------------------------------------*/
 int main(int argc, char* argv[])
 {
@@ -38,15 +88,18 @@ int main(int argc, char* argv[])
 	}
 	
 	fcntl(0, F_SETFL, fcntl(0, F_GETFL) | O_NONBLOCK);   //non blocking standard input
+
+	CreateHashTable();
+	SetDoseWindows(DoseWindows, sizeof(DoseWindows) / sizeof(DoseWindows[0]));
 	 
 	char selectedPatient[MAX_PATIENTNAME_SIZE] = "JohnDoe";
-	(void) selectedPatient; // remove this line when you are doing something with selectedPatient
-	// add here the code that adds John Doe into the admin
+	AddPatient(selectedPatient);
 	
 	displayMenu();	
 	while (true) {  
         MenuOptions choice = getMenuChoice();
 		if (choice == -1) {
+			displayDoseAlerts();
 			if (centralAcqConnectionState == CONNECTED_WITH_CENTRAL_ACQUISITION) {
 				uint32_t doseData;
 				if (getDoseDataFromCentralAcquisition(&doseData)) {
@@ -64,7 +117,7 @@ int main(int argc, char* argv[])
 				// add here your delete patient code
 				break;
 			case MO_SELECT_PATIENT:
-				// add here your select patient code
+				selectPatient(selectedPatient);
 				break;
 			case MO_SELECT_EXAMINATION_TYPE:
 			    if (centralAcqConnectionState == CONNECTED_WITH_CENTRAL_ACQUISITION) {	
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <fcntl.h>
+#include <string.h>
 
 static int getInt(void);
 
@@ -42,3 +43,19 @@ static int getInt(void)
     return value;
 }
 
+
+void getText(const char* prompt, char* text, size_t size)
+{
+    // Standard input is non blocking for the main loop, wait for the operator here
+    int flags = fcntl(0, F_GETFL);
+    fcntl(0, F_SETFL, flags & ~O_NONBLOCK);
+
+    printf("%s", prompt);
+    fflush(stdout);
+    if (fgets(text, (int)size, stdin) == NULL) {
+        text[0] = '\0';
+    }
+    text[strcspn(text, "\n")] = '\0';
+
+    fcntl(0, F_SETFL, flags);
+}
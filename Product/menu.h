@@ -9,8 +9,11 @@ typedef enum {
     MO_QUIT
 } MenuOptions;
 
+#include <stddef.h>
+
 MenuOptions getMenuChoice(void);
 void displayMenu(void);
+void getText(const char* prompt, char* text, size_t size);
 
 
 #endif
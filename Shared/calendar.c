@@ -0,0 +1,51 @@
+#include "calendar.h"
+
+#define FIRST_YEAR      (1900)
+#define LAST_YEAR       (2500)
+// Days from 1 March of year 0 to 1 January 1900 in the proleptic Gregorian calendar
+#define DAYS_UNTIL_1900 (693901)
+
+
+// Counting years from 1 March puts the leap day at the end of the year, which turns
+// the month lengths into a simple formula (153 days per 5 months).
+uint32_t DateToDayNumber(const Date* date)
+{
+	uint32_t year = date->year;
+	uint32_t month = date->month;
+
+	if (month <= 2) {
+		year--;
+		month += 12;
+	}
+	uint32_t dayOfYear = (153 * (month - 3) + 2) / 5 + date->day - 1;
+	uint32_t days = 365 * year + year / 4 - year / 100 + year / 400 + dayOfYear;
+	return days - DAYS_UNTIL_1900;
+}
+
+void DayNumberToDate(uint32_t dayNumber, Date* date)
+{
+	uint32_t days = dayNumber + DAYS_UNTIL_1900;
+	uint32_t era = days / 146097;
+	uint32_t dayOfEra = days - era * 146097;
+	uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+	uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+	uint32_t monthIndex = (5 * dayOfYear + 2) / 153;
+
+	date->day = (uint8_t)(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+	date->month = (uint8_t)(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+	date->year = (uint16_t)(era * 400 + yearOfEra + (date->month <= 2 ? 1 : 0));
+}
+
+uint8_t DaysInMonth(uint8_t month, uint16_t year)
+{
+	static const uint8_t days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	bool leapYear = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+
+	return (month == 2 && leapYear) ? 29 : days[month - 1];
+}
+
+bool IsValidDate(const Date* date)
+{
+	return date->year >= FIRST_YEAR && date->year <= LAST_YEAR && date->month >= 1 &&
+	       date->month <= 12 && date->day >= 1 && date->day <= DaysInMonth(date->month, date->year);
+}
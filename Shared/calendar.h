@@ -0,0 +1,36 @@
+#ifndef CALENDAR_H
+#define CALENDAR_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "doseAdmin.h"
+
+
+/***************************************************************************************
+ * Converts a date to the number of days since 1 January 1900 (which is day 0).
+ * Consecutive calendar days have consecutive day numbers, so a difference of day 
+ * numbers is a number of days.
+ * 
+ * It is a precondition that date is a valid calendar date in range [1900, 2500]
+ */
+uint32_t DateToDayNumber(const Date* date);
+
+
+/***************************************************************************************
+ * Converts a day number as returned by DateToDayNumber back to a date
+ */
+void DayNumberToDate(uint32_t dayNumber, Date* date);
+
+
+/***************************************************************************************
+ * Returns the number of days of a month, taking leap years into account
+ */
+uint8_t DaysInMonth(uint8_t month, uint16_t year);
+
+
+/***************************************************************************************
+ * Returns true when date is a calendar date in the supported range [1900, 2500], the 
+ * range of the date index, the rollups and the dose sketch
+ */
+bool IsValidDate(const Date* date);
+
+#endif
@@ -0,0 +1,326 @@
+#include "changeFeed.h"
+#include <stdlib.h>
+#include <string.h>
+#include "calendar.h"
+#include "varint.h"
+
+#define INITIAL_BLOCKS (4)
+// The dose varint carries the examination type in its low bits, as in encoded patients
+#define EXAM_TYPE_BITS (3)
+#define EXAM_TYPE_MASK ((1u << EXAM_TYPE_BITS) - 1)
+
+// Changes in the export format: a type byte, then for patient changes the name as a
+// varint length and its characters, then for a dose two varints (day number, dose
+// shifted left by EXAM_TYPE_BITS with the examination type), for a purge one (day number)
+typedef struct {
+	uint64_t firstSequence;  // sequence number of the first change in data
+	uint32_t count;          // changes in data
+	uint32_t used;           // bytes of data in use
+	uint8_t  data[CHANGE_BLOCK_SIZE];
+} ChangeBlock;
+
+static bool enabled = false;
+static uint64_t sequence = 0;        // newest change
+static uint64_t oldestSequence = 1;  // oldest change still in the log (when there is one)
+
+// Blocks in sequence order, only the last one is appended to
+static ChangeBlock** blocks = NULL;
+static size_t nrOfBlocks = 0;
+static size_t blockCapacity = 0;
+
+
+static void freeBlocks(void)
+{
+	for (size_t i = 0; i < nrOfBlocks; i++) {
+		free(blocks[i]);
+	}
+	free(blocks);
+	blocks = NULL;
+	nrOfBlocks = 0;
+	blockCapacity = 0;
+}
+
+/**
+ * @brief Drops the log and skips a sequence number, followers have to start over.
+ */
+static void restart(void)
+{
+	freeBlocks();
+	sequence++;
+	oldestSequence = sequence + 1;
+}
+
+/**
+ * @brief Returns the block to append size bytes to, NULL when allocation of memory failed.
+ */
+static ChangeBlock* blockFor(size_t size)
+{
+	if (nrOfBlocks > 0 && blocks[nrOfBlocks - 1]->used + size <= CHANGE_BLOCK_SIZE) {
+		return blocks[nrOfBlocks - 1];
+	}
+	if (nrOfBlocks == blockCapacity) {
+		size_t capacity = (blockCapacity == 0) ? INITIAL_BLOCKS : 2 * blockCapacity;
+		ChangeBlock** grown = realloc(blocks, capacity * sizeof(ChangeBlock*));
+		if (grown == NULL) {
+			return NULL;
+		}
+		blocks = grown;
+		blockCapacity = capacity;
+	}
+	ChangeBlock* block = malloc(sizeof(ChangeBlock));
+	if (block == NULL) {
+		return NULL;
+	}
+	block->firstSequence = sequence + 1;
+	block->count = 0;
+	block->used = 0;
+	blocks[nrOfBlocks++] = block;
+	return block;
+}
+
+static void append(const uint8_t* change, size_t size)
+{
+	ChangeBlock* block = blockFor(size);
+	if (block == NULL) {
+		restart(); // A gap in the log would go unnoticed otherwise
+		return;
+	}
+	memcpy(block->data + block->used, change, size);
+	block->used += (uint32_t)size;
+	block->count++;
+	sequence++;
+}
+
+/**
+ * @brief Writes type and name of a patient change, returns the bytes written.
+ */
+static size_t encodeHeader(ChangeType type, const char* name, uint8_t* out)
+{
+	size_t length = strlen(name);
+	size_t size = 0;
+
+	out[size++] = (uint8_t)type;
+	size += EncodeVarint((uint32_t)length, out + size);
+	memcpy(out + size, name, length);
+	return size + length;
+}
+
+void ChangeFeedEnable(void)
+{
+	if (!enabled) {
+		enabled = true;
+		restart(); // Changes made while disabled are missing
+	}
+}
+
+void ChangeFeedDisable(void)
+{
+	enabled = false;
+	freeBlocks();
+}
+
+void ChangeFeedAddPatient(const char* name)
+{
+	uint8_t change[MAX_CHANGE_SIZE];
+
+	if (enabled) {
+		append(change, encodeHeader(CHANGE_ADD_PATIENT, name, change));
+	}
+}
+
+void ChangeFeedAddDose(const char* name, const DoseData* dose)
+{
+	uint8_t change[MAX_CHANGE_SIZE];
+
+	if (enabled) {
+		size_t size = encodeHeader(CHANGE_ADD_DOSE, name, change);
+		size += EncodeVarint(DateToDayNumber(&dose->date), change + size);
+		size += EncodeVarint(((uint32_t)dose->dose << EXAM_TYPE_BITS) | dose->examType, change + size);
+		append(change, size);
+	}
+}
+
+void ChangeFeedRemovePatient(const char* name)
+{
+	uint8_t change[MAX_CHANGE_SIZE];
+
+	if (enabled) {
+		append(change, encodeHeader(CHANGE_REMOVE_PATIENT, name, change));
+	}
+}
+
+void ChangeFeedPurge(const Date* horizon)
+{
+	uint8_t change[1 + MAX_VARINT_SIZE];
+
+	if (enabled) {
+		change[0] = CHANGE_PURGE_DOSES;
+		append(change, 1 + EncodeVarint(DateToDayNumber(horizon), change + 1));
+	}
+}
+
+void ChangeFeedRemoveAll(void)
+{
+	uint8_t change = CHANGE_REMOVE_ALL;
+
+	if (enabled) {
+		append(&change, 1);
+	}
+}
+
+uint64_t ChangeFeedSequence(void)
+{
+	return sequence;
+}
+
+/**
+ * @brief Reads a varint of a change that may be incomplete.
+ */
+static bool readVarint(const uint8_t** position, const uint8_t* end, uint32_t* value)
+{
+	size_t size = DecodeVarintBounded(*position, end, value);
+	*position += size;
+	return size > 0;
+}
+
+bool ChangeFeedRead(const uint8_t** position, const uint8_t* end, PatientChange* change)
+{
+	const uint8_t* p = *position;
+	uint32_t length, day, value;
+
+	if (p >= end || *p > CHANGE_REMOVE_ALL) {
+		return false;
+	}
+	change->type = *p++;
+	change->patientName[0] = '\0';
+
+	switch (change->type) {
+	case CHANGE_ADD_PATIENT:
+	case CHANGE_ADD_DOSE:
+	case CHANGE_REMOVE_PATIENT:
+		if (!readVarint(&p, end, &length) || length >= MAX_PATIENTNAME_SIZE ||
+		    (size_t)(end - p) < length) {
+			return false;
+		}
+		memcpy(change->patientName, p, length);
+		change->patientName[length] = '\0';
+		p += length;
+		if (change->type == CHANGE_ADD_DOSE) {
+			if (!readVarint(&p, end, &day) || !readVarint(&p, end, &value)) {
+				return false;
+			}
+			DayNumberToDate(day, &change->dose.date);
+			change->dose.dose = (uint16_t)(value >> EXAM_TYPE_BITS);
+			change->dose.examType = (uint8_t)(value & EXAM_TYPE_MASK);
+		}
+		break;
+	case CHANGE_PURGE_DOSES:
+		if (!readVarint(&p, end, &day)) {
+			return false;
+		}
+		DayNumberToDate(day, &change->dose.date);
+		break;
+	default:
+		break;
+	}
+	*position = p;
+	return true;
+}
+
+/**
+ * @brief Returns the size of the change at data, which is known to be well formed.
+ */
+static size_t changeSize(const uint8_t* data)
+{
+	const uint8_t* p = data + 1;
+	uint32_t value;
+
+	if (*data == CHANGE_REMOVE_ALL) {
+		return 1;
+	}
+	if (*data != CHANGE_PURGE_DOSES) {
+		p += DecodeVarint(p, &value);
+		p += value;
+	}
+	if (*data == CHANGE_ADD_DOSE) {
+		p += DecodeVarint(p, &value);
+		p += DecodeVarint(p, &value);
+	}
+	else if (*data == CHANGE_PURGE_DOSES) {
+		p += DecodeVarint(p, &value);
+	}
+	return (size_t)(p - data);
+}
+
+int8_t ChangeFeedExport(uint64_t after, uint8_t buffer[], size_t bufferSize,
+                        size_t* nrOfBytes, uint64_t* lastSequence)
+{
+	*nrOfBytes = 0;
+	*lastSequence = after;
+
+	if (!enabled || after + 1 < oldestSequence) {
+		return -2; // Changes after it are not in the log (anymore)
+	}
+	if (after > sequence) {
+		return -1; // Not handed out yet
+	}
+	if (after == sequence) {
+		return 0;
+	}
+
+	// The last block that starts at or before the first change wanted
+	size_t low = 0;
+	size_t high = nrOfBlocks;
+	while (high - low > 1) {
+		size_t middle = low + (high - low) / 2;
+		if (blocks[middle]->firstSequence <= after + 1) {
+			low = middle;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	uint64_t next = blocks[low]->firstSequence;
+	size_t offset = 0;
+	for (size_t b = low; b < nrOfBlocks; b++, offset = 0) {
+		const ChangeBlock* block = blocks[b];
+		next = block->firstSequence;
+		while (offset < block->used) {
+			size_t size = changeSize(block->data + offset);
+			if (next > after) {
+				if (*nrOfBytes + size > bufferSize) {
+					return (*nrOfBytes == 0) ? -3 : 0;
+				}
+				memcpy(buffer + *nrOfBytes, block->data + offset, size);
+				*nrOfBytes += size;
+				*lastSequence = next;
+			}
+			offset += size;
+			next++;
+		}
+	}
+	return 0;
+}
+
+void ChangeFeedTrim(uint64_t after)
+{
+	size_t dropped = 0;
+
+	while (dropped < nrOfBlocks &&
+	       blocks[dropped]->firstSequence + blocks[dropped]->count - 1 <= after &&
+	       dropped + 1 < nrOfBlocks) {
+		free(blocks[dropped]);
+		dropped++;
+	}
+	if (dropped > 0) {
+		memmove(blocks, blocks + dropped, (nrOfBlocks - dropped) * sizeof(ChangeBlock*));
+		nrOfBlocks -= dropped;
+		oldestSequence = blocks[0]->firstSequence;
+	}
+}
+
+size_t ChangeFeedBytes(void)
+{
+	return nrOfBlocks * sizeof(ChangeBlock) + blockCapacity * sizeof(ChangeBlock*);
+}
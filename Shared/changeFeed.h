@@ -0,0 +1,68 @@
+#ifndef CHANGEFEED_H
+#define CHANGEFEED_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "doseAdmin.h"
+
+// Internal to the Shared module: log of the changes to the registry, for systems that
+// follow it. Every change gets the next sequence number and is appended to the newest
+// block in the export format, so an export copies bytes and only has to find where the
+// first change after the requested sequence starts. Sequence numbers within the log are
+// consecutive; when the log loses changes (disabled, allocation of memory failed) a
+// number is skipped, so a follower that missed changes is told to start over.
+#define CHANGE_BLOCK_SIZE (64 * 1024)
+
+
+/***************************************************************************************
+ * Starts logging. The sequence number skips one, as changes made until now are missing.
+ */
+void ChangeFeedEnable(void);
+
+
+/***************************************************************************************
+ * Stops logging and frees the log
+ */
+void ChangeFeedDisable(void);
+
+
+/***************************************************************************************
+ * Writer side, called after the change was made. All do nothing when not enabled.
+ */
+void ChangeFeedAddPatient(const char* name);
+void ChangeFeedAddDose(const char* name, const DoseData* dose);
+void ChangeFeedRemovePatient(const char* name);
+void ChangeFeedPurge(const Date* horizon);
+void ChangeFeedRemoveAll(void);
+
+
+/***************************************************************************************
+ * Returns the sequence number of the newest change
+ */
+uint64_t ChangeFeedSequence(void);
+
+
+/***************************************************************************************
+ * See ExportChangesSince
+ */
+int8_t ChangeFeedExport(uint64_t sequence, uint8_t buffer[], size_t bufferSize,
+                        size_t* nrOfBytes, uint64_t* lastSequence);
+
+
+/***************************************************************************************
+ * Drops the blocks that only hold changes up to sequence
+ */
+void ChangeFeedTrim(uint64_t sequence);
+
+
+/***************************************************************************************
+ * Decodes the change at *position and moves *position behind it
+ *
+ * Returns false at end or when the bytes are not a complete change
+ */
+bool ChangeFeedRead(const uint8_t** position, const uint8_t* end, PatientChange* change);
+
+
+size_t ChangeFeedBytes(void);
+
+#endif
@@ -0,0 +1,87 @@
+#include "columnExport.h"
+#include <string.h>
+#include <inttypes.h>
+
+#define NPY_MAGIC      "\x93NUMPY\x01\x00" // magic string, format version 1.0
+#define NPY_MAGIC_SIZE (8)
+#define NPY_PREFIX_SIZE (NPY_MAGIC_SIZE + 2) // magic, little endian header length
+
+
+/**
+ * @brief Writes the header for the current count at the start of the file.
+ */
+static bool writeHeader(NpyWriter* writer)
+{
+	char header[NPY_HEADER_SIZE + 1];
+	size_t dictionarySize = NPY_HEADER_SIZE - NPY_PREFIX_SIZE;
+
+	memcpy(header, NPY_MAGIC, NPY_MAGIC_SIZE);
+	header[NPY_MAGIC_SIZE] = (char)(dictionarySize & 0xFF);
+	header[NPY_MAGIC_SIZE + 1] = (char)(dictionarySize >> 8);
+	int length = snprintf(header + NPY_PREFIX_SIZE, dictionarySize + 1,
+	                      "{'descr': '%s', 'fortran_order': False, 'shape': (%" PRIu64 ",), }",
+	                      writer->descr, writer->count);
+	// Padded with spaces up to the size of the header, which ends with a line end
+	memset(header + NPY_PREFIX_SIZE + length, ' ', dictionarySize - (size_t)length);
+	header[NPY_HEADER_SIZE - 1] = '\n';
+
+	return fseek(writer->file, 0, SEEK_SET) == 0 &&
+	       fwrite(header, 1, NPY_HEADER_SIZE, writer->file) == NPY_HEADER_SIZE;
+}
+
+static void flush(NpyWriter* writer)
+{
+	if (fwrite(writer->buffer, 1, writer->used, writer->file) != writer->used) {
+		writer->failed = true;
+	}
+	writer->used = 0;
+}
+
+bool NpyWriterOpen(NpyWriter* writer, const char* filePath, const char* descr, size_t itemSize)
+{
+	writer->file = fopen(filePath, "wb");
+	if (writer->file == NULL) {
+		return false;
+	}
+	strncpy(writer->descr, descr, sizeof(writer->descr) - 1);
+	writer->descr[sizeof(writer->descr) - 1] = '\0';
+	writer->itemSize = itemSize;
+	writer->count = 0;
+	writer->used = 0;
+	writer->failed = !writeHeader(writer);
+	return true;
+}
+
+void NpyWriterAppend(NpyWriter* writer, uint64_t value)
+{
+	if (writer->used + writer->itemSize > NPY_BUFFER_SIZE) {
+		flush(writer);
+	}
+	for (size_t i = 0; i < writer->itemSize; i++) {
+		writer->buffer[writer->used++] = (uint8_t)(value >> (8 * i));
+	}
+	writer->count++;
+}
+
+void NpyWriterAppendBytes(NpyWriter* writer, const void* item)
+{
+	if (writer->used + writer->itemSize > NPY_BUFFER_SIZE) {
+		flush(writer);
+	}
+	memcpy(writer->buffer + writer->used, item, writer->itemSize);
+	writer->used += writer->itemSize;
+	writer->count++;
+}
+
+bool NpyWriterClose(NpyWriter* writer)
+{
+	flush(writer);
+	if (!writeHeader(writer)) {
+		writer->failed = true;
+	}
+	if (fclose(writer->file) != 0) {
+		writer->failed = true;
+	}
+	writer->file = NULL;
+	return !writer->failed;
+}
@@ -0,0 +1,54 @@
+#ifndef COLUMNEXPORT_H
+#define COLUMNEXPORT_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Internal to the Shared module: writes one column of ExportColumns as a NumPy .npy file
+// (format version 1.0): a fixed size header that describes a one dimensional array,
+// then the items back to back in little endian order, so the file can be mapped or
+// loaded without parsing. The number of items is only known at the end, so the header
+// is written with room for any count and written again when the file is closed.
+#define NPY_HEADER_SIZE (128)
+#define NPY_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+	FILE*    file;
+	char     descr[8];   // NumPy type of an item, e.g. "<u4"
+	size_t   itemSize;
+	uint64_t count;
+	size_t   used;       // bytes of buffer in use
+	bool     failed;
+	uint8_t  buffer[NPY_BUFFER_SIZE];
+} NpyWriter;
+
+
+/***************************************************************************************
+ * Creates (or truncates) the file for a column of items of itemSize bytes
+ *
+ * Returns false when the file cannot be created
+ */
+bool NpyWriterOpen(NpyWriter* writer, const char* filePath, const char* descr, size_t itemSize);
+
+
+/***************************************************************************************
+ * Appends an unsigned number of itemSize bytes
+ */
+void NpyWriterAppend(NpyWriter* writer, uint64_t value);
+
+
+/***************************************************************************************
+ * Appends an item of itemSize bytes as it is, e.g. a name
+ */
+void NpyWriterAppendBytes(NpyWriter* writer, const void* item);
+
+
+/***************************************************************************************
+ * Writes the remaining items and the final header and closes the file
+ *
+ * Returns false when writing failed at any point
+ */
+bool NpyWriterClose(NpyWriter* writer);
+
+#endif
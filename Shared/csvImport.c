@@ -0,0 +1,274 @@
+#include "csvImport.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "calendar.h"
+
+#define FIRST_YEAR   (1900)
+#define LAST_YEAR    (2500)
+#define VECTOR_SIZE  (16)
+
+
+#ifdef __SSE2__
+
+/**
+ * @brief Returns the first a or b in [p, end), end when there is none. The buffer has
+ *        VECTOR_SIZE bytes of room behind its end, so a load never leaves it.
+ */
+static char* findEither(char* p, char* end, char a, char b)
+{
+	const __m128i first = _mm_set1_epi8(a);
+	const __m128i second = _mm_set1_epi8(b);
+
+	for (; p < end; p += VECTOR_SIZE) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)p);
+		unsigned mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, first),
+		                                                         _mm_cmpeq_epi8(bytes, second)));
+		if (mask != 0) {
+			char* found = p + __builtin_ctz(mask);
+			return (found < end) ? found : end;
+		}
+	}
+	return end;
+}
+
+#else
+
+static char* findEither(char* p, char* end, char a, char b)
+{
+	while (p < end && *p != a && *p != b) {
+		p++;
+	}
+	return p;
+}
+
+#endif
+
+/**
+ * @brief Reads minDigits to maxDigits decimal digits.
+ * @return false when there are fewer digits
+ */
+static bool parseDigits(const char** position, const char* end, int minDigits, int maxDigits,
+                        uint32_t* value)
+{
+	const char* p = *position;
+	int digits = 0;
+
+	*value = 0;
+	while (p < end && (unsigned char)(*p - '0') <= 9 && digits < maxDigits) {
+		*value = *value * 10 + (uint32_t)(*p - '0');
+		p++;
+		digits++;
+	}
+	*position = p;
+	return digits >= minDigits;
+}
+
+static bool expect(const char** position, const char* end, char c)
+{
+	if (*position < end && **position == c) {
+		(*position)++;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Parses a yyyy-mm-dd or dd-mm-yyyy date.
+ */
+static bool parseDate(const char** position, const char* end, Date* date)
+{
+	const char* start = *position;
+	uint32_t first, month, last;
+
+	if (!parseDigits(position, end, 1, 4, &first) || !expect(position, end, '-')) {
+		return false;
+	}
+	bool isoOrder = (*position - start == 5);
+	if (!parseDigits(position, end, 1, 2, &month) || !expect(position, end, '-') ||
+	    !parseDigits(position, end, 1, isoOrder ? 2 : 4, &last)) {
+		return false;
+	}
+	uint32_t year = isoOrder ? first : last;
+	uint32_t day = isoOrder ? last : first;
+	if (year < FIRST_YEAR || year > LAST_YEAR || month < 1 || month > 12 || day < 1 ||
+	    day > DaysInMonth((uint8_t)month, (uint16_t)year)) {
+		return false;
+	}
+	date->day = (uint8_t)day;
+	date->month = (uint8_t)month;
+	date->year = (uint16_t)year;
+	return true;
+}
+
+/**
+ * @brief Parses the name field and terminates the name in place.
+ * @return the position behind the field, NULL when it is malformed
+ */
+static char* parseName(char* p, char* end, CsvRow* row)
+{
+	char* nameEnd;
+
+	row->patientName = p;
+	if (p < end && *p == '"') {
+		// Quoted: move the name down over the quote while removing the doubled quotes
+		char* out = p;
+		char* in = p + 1;
+		for (;;) {
+			char* quote = findEither(in, end, '"', '"');
+			if (quote == end) {
+				return NULL; // Not closed
+			}
+			memmove(out, in, (size_t)(quote - in));
+			out += quote - in;
+			if (quote + 1 < end && quote[1] == '"') {
+				*out++ = '"';
+				in = quote + 2;
+				continue;
+			}
+			nameEnd = out;
+			p = quote + 1;
+			break;
+		}
+		if (p == end || *p != ',') {
+			return NULL;
+		}
+	}
+	else {
+		p = findEither(p, end, ',', '"');
+		if (p == end || *p == '"') {
+			return NULL; // No more fields, or a quote inside a name that is not quoted
+		}
+		nameEnd = p;
+	}
+	if (nameEnd == row->patientName) {
+		return NULL; // No name
+	}
+	*nameEnd = '\0';
+	row->nameLength = (size_t)(nameEnd - row->patientName);
+	return p + 1;
+}
+
+/**
+ * @brief Parses a line without its line end.
+ */
+static bool parseRow(char* line, char* end, CsvRow* row)
+{
+	uint32_t dose, examType = EXAM_TYPE_NONE;
+	const char* p = parseName(line, end, row);
+
+	if (p == NULL || !parseDate(&p, end, &row->dose.date) || !expect(&p, end, ',') ||
+	    !parseDigits(&p, end, 1, 5, &dose)) {
+		return false;
+	}
+	if (expect(&p, end, ',') && !parseDigits(&p, end, 1, 1, &examType)) {
+		return false;
+	}
+	if (p != end || dose == 0 || dose > UINT16_MAX || examType > EXAM_TYPE_NONE) {
+		return false;
+	}
+	row->dose.dose = (uint16_t)dose;
+	row->dose.examType = (uint8_t)examType;
+	return true;
+}
+
+/**
+ * @brief Moves the unread bytes to the front of the buffer and fills the rest.
+ */
+static void refill(CsvReader* reader)
+{
+	size_t left = reader->size - reader->start;
+
+	memmove(reader->buffer, reader->buffer + reader->start, left);
+	reader->start = 0;
+	reader->size = left;
+	size_t read = fread(reader->buffer + left, 1, CSV_BUFFER_SIZE - left, reader->file);
+	reader->size += read;
+	if (read < CSV_BUFFER_SIZE - left) {
+		reader->endOfFile = true;
+		reader->readFailed = ferror(reader->file) != 0;
+	}
+}
+
+int8_t CsvReaderOpen(CsvReader* reader, const char* filePath)
+{
+	memset(reader, 0, sizeof(*reader));
+	reader->buffer = calloc(1, CSV_BUFFER_SIZE + VECTOR_SIZE);
+	if (reader->buffer == NULL) {
+		return -2;
+	}
+	reader->file = fopen(filePath, "rb");
+	if (reader->file == NULL) {
+		free(reader->buffer);
+		reader->buffer = NULL;
+		return -1;
+	}
+	reader->line = 1;
+	return 0;
+}
+
+CsvResult CsvReaderNext(CsvReader* reader, CsvRow* row)
+{
+	for (;;) {
+		char* line = reader->buffer + reader->start;
+		char* dataEnd = reader->buffer + reader->size;
+		char* newline = findEither(line, dataEnd, '\n', '\n');
+
+		if (newline == dataEnd && !reader->endOfFile) {
+			if (reader->start > 0 || reader->size < CSV_BUFFER_SIZE) {
+				refill(reader); // Only part of the line is in the buffer
+				continue;
+			}
+			// Longer than the buffer: skip it up to its end
+			row->line = reader->line;
+			do {
+				reader->start = reader->size;
+				refill(reader);
+				dataEnd = reader->buffer + reader->size;
+				newline = findEither(reader->buffer, dataEnd, '\n', '\n');
+			} while (newline == dataEnd && !reader->endOfFile);
+			reader->start = (newline < dataEnd) ? (size_t)(newline + 1 - reader->buffer) : reader->size;
+			reader->line++;
+			return CSV_MALFORMED;
+		}
+		if (line == dataEnd) {
+			return CSV_END;
+		}
+
+		char* lineEnd = newline;
+		reader->start = (newline < dataEnd) ? (size_t)(newline + 1 - reader->buffer) : reader->size;
+		row->line = reader->line++;
+		if (lineEnd > line && lineEnd[-1] == '\r') {
+			lineEnd--;
+		}
+		if (lineEnd == line) {
+			continue; // Empty line
+		}
+		bool header = false;
+		if (row->line == 1) {
+			// A header names the columns: no digit where the date should be
+			char* comma = findEither(line, lineEnd, ',', ',');
+			header = comma + 1 < lineEnd && (unsigned char)(comma[1] - '0') > 9;
+		}
+		if (parseRow(line, lineEnd, row)) {
+			return CSV_ROW;
+		}
+		if (!header) {
+			return CSV_MALFORMED;
+		}
+	}
+}
+
+bool CsvReaderClose(CsvReader* reader)
+{
+	bool readFailed = reader->readFailed;
+
+	if (reader->file != NULL) {
+		fclose(reader->file);
+	}
+	free(reader->buffer);
+	memset(reader, 0, sizeof(*reader));
+	return !readFailed;
+}
@@ -0,0 +1,64 @@
+#ifndef CSVIMPORT_H
+#define CSVIMPORT_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "doseAdmin.h"
+
+// Internal to the Shared module: reads the rows "name,date,dose[,examType]" of a CSV
+// file through one fixed size buffer, for ImportCsvFile. Line ends and field delimiters
+// are found 16 bytes at a time (SSE2 when available); dates and numbers are parsed
+// digit by digit without calls into the C library. A name may be quoted ("Doe, John",
+// with "" for a quote), a date is yyyy-mm-dd or dd-mm-yyyy.
+#define CSV_BUFFER_SIZE (256 * 1024)
+
+typedef enum {
+	CSV_ROW,       // row is filled in
+	CSV_MALFORMED, // row.line is the line that could not be parsed, it was skipped
+	CSV_END
+} CsvResult;
+
+typedef struct {
+	char*    patientName;  // points into the buffer, \0 terminated, valid until the next row
+	size_t   nameLength;
+	DoseData dose;
+	size_t   line;         // line number in the file, from 1
+} CsvRow;
+
+typedef struct {
+	FILE*  file;
+	char*  buffer;     // CSV_BUFFER_SIZE bytes and room for the vector loads behind them
+	size_t start;      // first byte of the next line
+	size_t size;       // bytes in buffer
+	size_t line;       // number of the next line
+	bool   endOfFile;
+	bool   readFailed;
+} CsvReader;
+
+
+/***************************************************************************************
+ * Opens a CSV file
+ *
+ * Returns  0 on success
+ * Returns -1 when the file cannot be opened
+ * Returns -2 when allocation of memory failed
+ */
+int8_t CsvReaderOpen(CsvReader* reader, const char* filePath);
+
+
+/***************************************************************************************
+ * Reads the next row. Empty lines are skipped, and so is a header: a first line whose
+ * date field does not start with a digit. A line longer than the buffer is malformed.
+ */
+CsvResult CsvReaderNext(CsvReader* reader, CsvRow* row);
+
+
+/***************************************************************************************
+ * Closes the file
+ *
+ * Returns false when reading the file failed before its end
+ */
+bool CsvReaderClose(CsvReader* reader);
+
+#endif
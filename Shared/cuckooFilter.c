@@ -0,0 +1,149 @@
+#include "cuckooFilter.h"
+#include <stdlib.h>
+
+#define MIN_NR_OF_BUCKETS (1024)
+#define MAX_KICKS         (500)
+// Items per bucket planned for on a reset; a filter of 4-slot buckets reliably fills 
+// to about 95%, so this leaves room to grow before a reset is needed again
+#define PLANNED_LOAD      (2)
+
+typedef struct {
+	uint16_t slots[CUCKOO_BUCKET_SIZE]; // 0: empty, fingerprints are never 0
+} CuckooBucket;
+
+static CuckooBucket* buckets = NULL;
+static size_t nrOfBuckets = 0;
+static bool enabled = false;
+static uint32_t kickState = 1; // chooses the slot to displace
+
+
+static uint16_t fingerprintOf(uint64_t hash)
+{
+	return (uint16_t)((hash >> 32) % UINT16_MAX + 1);
+}
+
+static size_t firstBucketOf(uint64_t hash)
+{
+	return (size_t)hash & (nrOfBuckets - 1);
+}
+
+/**
+ * @brief The two buckets of an item are each other's alternative: bucket XOR a hash of
+ *        the fingerprint, so the other one can be found without the original key.
+ */
+static size_t alternativeBucket(size_t bucket, uint16_t fingerprint)
+{
+	return (bucket ^ ((size_t)fingerprint * 0x5bd1e995u)) & (nrOfBuckets - 1);
+}
+
+static bool putInBucket(size_t bucket, uint16_t fingerprint)
+{
+	for (int i = 0; i < CUCKOO_BUCKET_SIZE; i++) {
+		if (buckets[bucket].slots[i] == 0) {
+			buckets[bucket].slots[i] = fingerprint;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool isInBucket(size_t bucket, uint16_t fingerprint)
+{
+	for (int i = 0; i < CUCKOO_BUCKET_SIZE; i++) {
+		if (buckets[bucket].slots[i] == fingerprint) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool CuckooFilterReset(size_t nrOfItems)
+{
+	size_t count = MIN_NR_OF_BUCKETS;
+	while (count * PLANNED_LOAD < nrOfItems) {
+		count *= 2;
+	}
+
+	free(buckets);
+	buckets = calloc(count, sizeof(CuckooBucket));
+	nrOfBuckets = (buckets != NULL) ? count : 0;
+	enabled = (buckets != NULL);
+	return enabled;
+}
+
+void CuckooFilterDisable(void)
+{
+	free(buckets);
+	buckets = NULL;
+	nrOfBuckets = 0;
+	enabled = false;
+}
+
+bool CuckooFilterAdd(uint64_t hash)
+{
+	if (!enabled) {
+		return true;
+	}
+
+	uint16_t fingerprint = fingerprintOf(hash);
+	size_t bucket = firstBucketOf(hash);
+	if (putInBucket(bucket, fingerprint) ||
+	    putInBucket(alternativeBucket(bucket, fingerprint), fingerprint)) {
+		return true;
+	}
+
+	// Both buckets are full: displace fingerprints to their alternative bucket
+	for (int kick = 0; kick < MAX_KICKS; kick++) {
+		kickState = kickState * 1103515245u + 12345u;
+		int slot = (int)((kickState >> 16) % CUCKOO_BUCKET_SIZE);
+		uint16_t displaced = buckets[bucket].slots[slot];
+		buckets[bucket].slots[slot] = fingerprint;
+		fingerprint = displaced;
+		bucket = alternativeBucket(bucket, fingerprint);
+		if (putInBucket(bucket, fingerprint)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void CuckooFilterRemove(uint64_t hash)
+{
+	if (!enabled) {
+		return;
+	}
+
+	uint16_t fingerprint = fingerprintOf(hash);
+	size_t bucket = firstBucketOf(hash);
+	for (int candidate = 0; candidate < 2; candidate++) {
+		for (int i = 0; i < CUCKOO_BUCKET_SIZE; i++) {
+			if (buckets[bucket].slots[i] == fingerprint) {
+				buckets[bucket].slots[i] = 0;
+				return;
+			}
+		}
+		bucket = alternativeBucket(bucket, fingerprint);
+	}
+}
+
+bool CuckooFilterMayContain(uint64_t hash)
+{
+	if (!enabled) {
+		return true;
+	}
+
+	uint16_t fingerprint = fingerprintOf(hash);
+	size_t bucket = firstBucketOf(hash);
+	return isInBucket(bucket, fingerprint) ||
+	       isInBucket(alternativeBucket(bucket, fingerprint), fingerprint);
+}
+
+size_t CuckooFilterCapacity(void)
+{
+	return nrOfBuckets * CUCKOO_BUCKET_SIZE;
+}
+
+size_t CuckooFilterBytes(void)
+{
+	return nrOfBuckets * sizeof(CuckooBucket);
+}
@@ -0,0 +1,61 @@
+#ifndef CUCKOOFILTER_H
+#define CUCKOOFILTER_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Internal to the Shared module: approximate set of the names in the table, to answer
+// most lookups of absent names without walking a chain. Every name is a 16-bit 
+// fingerprint in one of two buckets of CUCKOO_BUCKET_SIZE slots (cuckoo hashing on 
+// partial keys), so it can be removed again.
+#define CUCKOO_BUCKET_SIZE (4)
+
+
+/***************************************************************************************
+ * Replaces the filter by an empty one with room for at least nrOfItems items
+ * 
+ * Returns false when allocation of memory failed, the filter is disabled in that case
+ */
+bool CuckooFilterReset(size_t nrOfItems);
+
+
+/***************************************************************************************
+ * Disables the filter: it keeps answering "may contain" until the next reset
+ */
+void CuckooFilterDisable(void);
+
+
+/***************************************************************************************
+ * Adds an item by the 64-bit hash of its key
+ * 
+ * Returns false when the filter is full; it must then be reset and refilled, because
+ * the last displaced item is lost
+ */
+bool CuckooFilterAdd(uint64_t hash);
+
+
+/***************************************************************************************
+ * Removes an item that was added before. Removing an item that was not added can 
+ * remove another item with the same fingerprint.
+ */
+void CuckooFilterRemove(uint64_t hash);
+
+
+/***************************************************************************************
+ * Returns false when the item is certainly not in the filter
+ */
+bool CuckooFilterMayContain(uint64_t hash);
+
+
+/***************************************************************************************
+ * Returns the number of slots, the upper bound of the number of items
+ */
+size_t CuckooFilterCapacity(void);
+
+
+/***************************************************************************************
+ * Returns the bytes allocated by the filter
+ */
+size_t CuckooFilterBytes(void);
+
+#endif
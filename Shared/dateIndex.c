@@ -0,0 +1,246 @@
+#include "dateIndex.h"
+#include <stdlib.h>
+#include <string.h>
+#include "calendar.h"
+
+#define FIRST_YEAR       (1900)
+#define LAST_YEAR        (2500)
+#define NR_OF_MONTHS     ((LAST_YEAR - FIRST_YEAR + 1) * 12)
+#define INITIAL_CAPACITY (8)
+
+// A posting to remove, not searched for until a query visits its month
+typedef struct {
+	uint32_t patientId;
+	uint32_t dayNumber;
+	uint16_t dose;
+	uint32_t count;      // identical postings to remove
+} PendingRemoval;
+
+typedef struct {
+	DatePosting* postings;
+	uint32_t count;
+	uint32_t capacity;
+	PendingRemoval* removals;
+	uint32_t removalCount;
+	uint32_t removalCapacity;
+} MonthBucket;
+
+// Directory of all months in the supported date range, buckets are allocated on use
+static MonthBucket* months[NR_OF_MONTHS];
+static size_t allocatedBytes = 0;
+// Months before this one were dropped, so the next drop starts here
+static size_t firstKeptMonth = 0;
+
+
+static size_t monthIndex(const Date* date)
+{
+	return (size_t)(date->year - FIRST_YEAR) * 12 + (date->month - 1);
+}
+
+bool DateIndexAdd(const Date* date, uint16_t dose, uint32_t patientId, uint8_t hash)
+{
+	size_t index = monthIndex(date);
+	MonthBucket* bucket = months[index];
+
+	if (bucket == NULL) {
+		bucket = calloc(1, sizeof(MonthBucket));
+		if (bucket == NULL) {
+			return false;
+		}
+		months[index] = bucket;
+		allocatedBytes += sizeof(MonthBucket);
+	}
+	if (bucket->count == bucket->capacity) {
+		uint32_t capacity = (bucket->capacity == 0) ? INITIAL_CAPACITY : 2 * bucket->capacity;
+		DatePosting* postings = realloc(bucket->postings, capacity * sizeof(DatePosting));
+		if (postings == NULL) {
+			return false;
+		}
+		allocatedBytes += (capacity - bucket->capacity) * sizeof(DatePosting);
+		bucket->postings = postings;
+		bucket->capacity = capacity;
+	}
+
+	DatePosting* posting = &bucket->postings[bucket->count++];
+	posting->dayNumber = DateToDayNumber(date);
+	posting->patientId = patientId;
+	posting->dose = dose;
+	posting->hash = hash;
+	return true;
+}
+
+static void freeMonth(size_t index)
+{
+	if (months[index] != NULL) {
+		allocatedBytes -= sizeof(MonthBucket) + months[index]->capacity * sizeof(DatePosting) +
+		                  months[index]->removalCapacity * sizeof(PendingRemoval);
+		free(months[index]->postings);
+		free(months[index]->removals);
+		free(months[index]);
+		months[index] = NULL;
+	}
+}
+
+static int compareRemovals(const void* a, const void* b)
+{
+	const PendingRemoval* x = a;
+	const PendingRemoval* y = b;
+
+	if (x->patientId != y->patientId) {
+		return (x->patientId > y->patientId) - (x->patientId < y->patientId);
+	}
+	if (x->dayNumber != y->dayNumber) {
+		return (x->dayNumber > y->dayNumber) - (x->dayNumber < y->dayNumber);
+	}
+	return (x->dose > y->dose) - (x->dose < y->dose);
+}
+
+/**
+ * @brief Searches the posting linearly and removes it at once, when no room is left to
+ *        record the removal.
+ */
+static void removePosting(MonthBucket* bucket, const PendingRemoval* removal)
+{
+	for (uint32_t i = 0; i < bucket->count; i++) {
+		if (bucket->postings[i].patientId == removal->patientId &&
+		    bucket->postings[i].dayNumber == removal->dayNumber &&
+		    bucket->postings[i].dose == removal->dose) {
+			// Order within a month does not matter: move the last posting into the gap
+			bucket->postings[i] = bucket->postings[--bucket->count];
+			return;
+		}
+	}
+}
+
+/**
+ * @brief Applies the pending removals of a month in one pass over its postings: the 
+ *        removals are sorted, and every posting is looked up among them.
+ */
+static void applyRemovals(size_t index)
+{
+	MonthBucket* bucket = months[index];
+	uint32_t kept = 0;
+	uint32_t unique = 0;
+
+	if (bucket == NULL || bucket->removalCount == 0) {
+		return;
+	}
+	qsort(bucket->removals, bucket->removalCount, sizeof(PendingRemoval), compareRemovals);
+	for (uint32_t i = 1; i < bucket->removalCount; i++) {
+		if (compareRemovals(&bucket->removals[unique], &bucket->removals[i]) == 0) {
+			bucket->removals[unique].count += bucket->removals[i].count;
+		}
+		else {
+			bucket->removals[++unique] = bucket->removals[i];
+		}
+	}
+	unique++;
+
+	for (uint32_t i = 0; i < bucket->count; i++) {
+		const DatePosting* posting = &bucket->postings[i];
+		PendingRemoval key = {posting->patientId, posting->dayNumber, posting->dose, 0};
+		PendingRemoval* removal = bsearch(&key, bucket->removals, unique,
+		                                  sizeof(PendingRemoval), compareRemovals);
+		if (removal != NULL && removal->count > 0) {
+			removal->count--;
+		}
+		else {
+			bucket->postings[kept++] = *posting;
+		}
+	}
+	bucket->count = kept;
+
+	allocatedBytes -= bucket->removalCapacity * sizeof(PendingRemoval);
+	free(bucket->removals);
+	bucket->removals = NULL;
+	bucket->removalCount = 0;
+	bucket->removalCapacity = 0;
+	if (bucket->count == 0) {
+		freeMonth(index);
+	}
+}
+
+void DateIndexRemove(const Date* date, uint16_t dose, uint32_t patientId)
+{
+	size_t index = monthIndex(date);
+	MonthBucket* bucket = months[index];
+	PendingRemoval removal = {patientId, DateToDayNumber(date), dose, 1};
+
+	if (bucket == NULL) {
+		return;
+	}
+	if (bucket->removalCount + 1 >= bucket->count) {
+		// Every posting of the month is removed (the removals are of added doses)
+		freeMonth(index);
+		return;
+	}
+	if (bucket->removalCount == bucket->removalCapacity) {
+		uint32_t capacity = (bucket->removalCapacity == 0) ? INITIAL_CAPACITY
+		                                                   : 2 * bucket->removalCapacity;
+		PendingRemoval* removals = realloc(bucket->removals, capacity * sizeof(PendingRemoval));
+		if (removals == NULL) {
+			applyRemovals(index); // Makes room, the month keeps this posting
+			removePosting(months[index], &removal);
+			return;
+		}
+		allocatedBytes += (capacity - bucket->removalCapacity) * sizeof(PendingRemoval);
+		bucket->removals = removals;
+		bucket->removalCapacity = capacity;
+	}
+	bucket->removals[bucket->removalCount++] = removal;
+}
+
+void DateIndexClear(void)
+{
+	for (size_t i = 0; i < NR_OF_MONTHS; i++) {
+		freeMonth(i);
+	}
+	allocatedBytes = 0;
+	firstKeptMonth = 0;
+}
+
+void DateIndexDropBefore(const Date* horizon)
+{
+	size_t end = monthIndex(horizon);
+
+	for (; firstKeptMonth < end; firstKeptMonth++) {
+		freeMonth(firstKeptMonth);
+	}
+}
+
+void DateIndexForEach(uint32_t startDay, uint32_t endDay,
+                      void (*visit)(const DatePosting* posting, void* context), void* context)
+{
+	Date startDate;
+	Date endDate;
+
+	if (startDay > endDay) {
+		return;
+	}
+	DayNumberToDate(startDay, &startDate);
+	DayNumberToDate(endDay, &endDate);
+	if (endDate.year > LAST_YEAR) {
+		endDate.year = LAST_YEAR;
+		endDate.month = 12;
+	}
+
+	for (size_t index = monthIndex(&startDate); index <= monthIndex(&endDate); index++) {
+		applyRemovals(index);
+		MonthBucket* bucket = months[index];
+		if (bucket == NULL) {
+			continue;
+		}
+		for (uint32_t i = 0; i < bucket->count; i++) {
+			// Only the first and last month can hold postings outside the range
+			const DatePosting* posting = &bucket->postings[i];
+			if (posting->dayNumber >= startDay && posting->dayNumber <= endDay) {
+				visit(posting, context);
+			}
+		}
+	}
+}
+
+size_t DateIndexBytes(void)
+{
+	return sizeof(months) + allocatedBytes;
+}
@@ -0,0 +1,62 @@
+#ifndef DATEINDEX_H
+#define DATEINDEX_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "doseAdmin.h"
+
+// Internal to the Shared module: secondary index from exposure date to patient.
+// Postings (day number, patient id) are kept in one list per calendar month, so a
+// date range query only visits the months of the range. Removals are recorded per 
+// month and applied in one pass when a query visits the month next, so removing many
+// doses does not search the month for each of them.
+
+typedef struct {
+	uint32_t dayNumber;
+	uint32_t patientId;
+	uint16_t dose;
+	uint8_t  hash;       // table entry of the patient, to find it without its name
+} DatePosting;
+
+
+/***************************************************************************************
+ * Adds a posting for a dose of the patient at date
+ * 
+ * Returns false when allocation of memory failed
+ */
+bool DateIndexAdd(const Date* date, uint16_t dose, uint32_t patientId, uint8_t hash);
+
+
+/***************************************************************************************
+ * Removes one posting of the patient at date with dose, which has to be present. Takes
+ * constant time; the posting is left out from the next query of its month on.
+ */
+void DateIndexRemove(const Date* date, uint16_t dose, uint32_t patientId);
+
+
+/***************************************************************************************
+ * Frees all postings
+ */
+void DateIndexClear(void);
+
+
+/***************************************************************************************
+ * Frees the postings of all months before the month of horizon, in one step per month.
+ * Postings of the month of horizon itself are kept.
+ */
+void DateIndexDropBefore(const Date* horizon);
+
+
+/***************************************************************************************
+ * Calls visit for every posting with a day number in [startDay, endDay]
+ */
+void DateIndexForEach(uint32_t startDay, uint32_t endDay,
+                      void (*visit)(const DatePosting* posting, void* context), void* context);
+
+
+/***************************************************************************************
+ * Returns the bytes allocated by the index
+ */
+size_t DateIndexBytes(void);
+
+#endif
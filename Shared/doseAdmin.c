@@ -1,248 +1,2798 @@
 #include "doseAdmin.h"
+#include <stdio.h>   // For the cold tier segment file
 #include <string.h>  // For strlen, strcmp, strncpy
 #include <stdbool.h> // For bool type
 #include <stdlib.h>  // For malloc, free
 #include <math.h>    // For GetHashPerformance (sqrt)
+#include "calendar.h"
+#include "varint.h"
+#include "periodCache.h"
+#include "dateIndex.h"
+#include "doseRollup.h"
+#include "doseSketch.h"
+#include "doseMonitor.h"
+#include "nameIndex.h"
+#include "cuckooFilter.h"
+#include "nameHash.h"
+#include "sharedRegistry.h"
+#include "versionLog.h"
+#include "registryLoader.h"
+#include "patientNumberIndex.h"
+#include "changeFeed.h"
+#include "patientArchive.h"
+#include "csvImport.h"
+#include "columnExport.h"
+#include "threadPool.h"
 
-#define MAX_DOSES_PER_PATIENT 10 // Sprint 2: Still a fixed array of 10
+// Worst case encoded size of one dose: a day delta and a dose varint
+#define MAX_ENCODED_DOSE_SIZE (2 * MAX_VARINT_SIZE)
+// The encoded dose varint carries the examination type in its low bits
+#define EXAM_TYPE_BITS        (3)
+#define EXAM_TYPE_MASK        ((1u << EXAM_TYPE_BITS) - 1)
 
-// Represents a single dose measurement
+// Passes over the whole table look at the patients on the thread pool, in tasks of this
+// many entries, once the table holds enough patients to be worth waking the threads
+#define ENTRIES_PER_TASK       (8)
+#define MIN_PARALLEL_PATIENTS  (16384)
+#define MAX_TABLE_TASKS        (HASHTABLE_SIZE / ENTRIES_PER_TASK)
+
+// Rough model of the allocator: an 8 byte chunk header, 16 byte granularity and a
+// 32 byte minimum chunk (glibc ptmalloc on 64-bit). Only used for the slack estimate.
+#define ALLOC_HEADER_SIZE  (8)
+#define ALLOC_GRANULARITY  (16)
+#define ALLOC_MIN_CHUNK    (32)
+
+typedef enum {
+	PATIENT_EXPANDED, // full name buffer and room for all doses in one allocation
+	PATIENT_COMPACT,  // exact-length name, doses in a separate exact-size allocation
+	PATIENT_ENCODED,  // exact-length name followed by the varint encoded dose history
+	PATIENT_EVICTED   // exact-length name followed by the segment offset of the history
+} PatientRepresentation;
+
+// Represents a patient (dynamically allocated)
+typedef struct Patient {
+	struct Patient* next;     // Next patient in the same hash table entry
+	DoseData* doses;          // Inline behind the name (expanded) or own allocation (compact)
+	uint8_t doseCount;        // Tracks used dose spots
+	uint8_t representation;   // PatientRepresentation
+	uint16_t encodedSize;     // Bytes of the encoded dose history (encoded and evicted)
+	uint32_t patientId;       // Unique for the lifetime of the process, never reused
+	char patientName[];       // Expanded: MAX_PATIENTNAME_SIZE bytes, otherwise strlen + 1
+} Patient;
+
+
+// --- The Hash Table ---
+// An array of POINTERS to patients, patients with the same hash are chained.
+static Patient* hashTable[HASHTABLE_SIZE];
+
+// --- Memory accounting ---
+// Kept up to date on every allocation, so GetMemoryUsage and the budget check are O(1).
+static MemoryUsage memoryUsage;
+static size_t memoryBudget = 0; // 0: no budget, patients stay expanded
+static size_t expandedPatients = 0; // patients the budget can still compact
+static size_t budgetBucket = 0;     // table entry where the next compaction pass starts
+
+// --- Cold tier ---
+// Evicted patients keep only name, dose count and the offset of their encoded history
+// in an append-only segment file. Records are read back on first use.
+static FILE* coldSegment = NULL;
+static ColdTierStats coldTierStats;
+
+// --- Lookup filter ---
+// Most lookups of absent names are answered by a cuckoo filter without walking a chain.
+static LookupFilterStats lookupFilterStats;
+
+static uint32_t nextPatientId = 1; // 0 is never a valid patient id
+
+// Incremented whenever a patient record is added, removed or replaced by another 
+// representation, so open cursors know when their cached position has to be looked up.
+static uint32_t layoutVersion = 0;
+
+// --- Retention ---
+// Doses before the horizon are purged: whole months from the indexes at once, from a
+// patient when it is next used or when the sweep of CompactExpiredPatients reaches it.
+static Date retentionHorizon;
+static uint32_t retentionValue = 0;    // horizon as YYYYMMDD, 0: no horizon
+static bool compactionPending = false; // patients may still hold expired doses
+static size_t sweepBucket = 0;         // next table entry of the sweep
+static bool sweepFailed = false;       // a patient of this pass could not be compacted
+
+// Patients removed by RemovePatients, chained by next until ReclaimRemovedPatients
+static Patient* removedPatients = NULL;
+
+
+/**
+ * @brief Calculates the hash index (0-255) for a patient name.
+ * @details Sums first 5 chars (uses 255 for missing chars) and takes modulo 256.
+ */
+static uint8_t hashFunction(char patientName[MAX_PATIENTNAME_SIZE]){
+	unsigned long sum = 0;
+    size_t len = strlen(patientName);
+
+    for (int i = 0; i < 5; i++) {
+        if (i < len) {
+            sum += (unsigned char)patientName[i];
+        } else {
+            sum += 255; // Value for missing characters
+        }
+    }
+	return (uint8_t)(sum % HASHTABLE_SIZE);
+}
+
+/**
+ * @brief Estimated allocator overhead (header and rounding) of a malloc of size bytes.
+ */
+static size_t allocationSlack(size_t size)
+{
+	size_t chunk = (size + ALLOC_HEADER_SIZE + ALLOC_GRANULARITY - 1) & ~(size_t)(ALLOC_GRANULARITY - 1);
+	if (chunk < ALLOC_MIN_CHUNK) {
+		chunk = ALLOC_MIN_CHUNK;
+	}
+	return chunk - size;
+}
+
+/**
+ * @brief Bytes taken by the name of a patient: the full buffer when expanded, otherwise
+ *        the name zero padded to its slot, so names compare a chunk at a time.
+ */
+static size_t storedNameSize(const Patient* patient)
+{
+	if (patient->representation == PATIENT_EXPANDED) {
+		return MAX_PATIENTNAME_SIZE;
+	}
+	return NameSlotSize(strlen(patient->patientName));
+}
+
+static size_t recordSize(const Patient* patient)
+{
+	// The chain pointer is accounted as index, the rest of the record as record bytes
+	size_t header = sizeof(Patient) - sizeof(struct Patient*);
+
+	if (patient->representation == PATIENT_EVICTED) {
+		return header + storedNameSize(patient) + sizeof(uint64_t);
+	}
+	return header + storedNameSize(patient);
+}
+
+static size_t doseStorageSize(const Patient* patient)
+{
+	if (patient->representation == PATIENT_EXPANDED) {
+		return MAX_DOSES_PER_PATIENT * sizeof(DoseData);
+	}
+	if (patient->representation == PATIENT_ENCODED) {
+		return patient->encodedSize;
+	}
+	if (patient->representation == PATIENT_EVICTED) {
+		return 0; // On disk
+	}
+	return patient->doseCount * sizeof(DoseData);
+}
+
+/**
+ * @brief Adds (sign = 1) or removes (sign = -1) the footprint of a patient to the totals.
+ */
+static void accountPatient(const Patient* patient, int sign)
+{
+	size_t records = recordSize(patient);
+	size_t doses = doseStorageSize(patient);
+	size_t slack;
+
+	if (patient->representation != PATIENT_COMPACT) {
+		// Name, record and doses share one allocation
+		slack = allocationSlack(records + doses);
+	}
+	else {
+		slack = allocationSlack(records) + ((doses > 0) ? allocationSlack(doses) : 0);
+	}
+
+	if (sign > 0) {
+		memoryUsage.recordBytes += records;
+		memoryUsage.doseBytes += doses;
+		memoryUsage.slackBytes += slack;
+		expandedPatients += (patient->representation == PATIENT_EXPANDED) ? 1 : 0;
+	}
+	else {
+		memoryUsage.recordBytes -= records;
+		memoryUsage.doseBytes -= doses;
+		memoryUsage.slackBytes -= slack;
+		expandedPatients -= (patient->representation == PATIENT_EXPANDED) ? 1 : 0;
+	}
+}
+
+static size_t totalMemory(void)
+{
+	return memoryUsage.recordBytes + memoryUsage.doseBytes + memoryUsage.indexBytes +
+	       memoryUsage.slackBytes + DateIndexBytes() + RollupBytes() + DoseSketchBytes() +
+	       DoseMonitorBytes() + NameIndexBytes() + CuckooFilterBytes() + VersionLogBytes() +
+	       PatientNumberIndexBytes() + ChangeFeedBytes();
+}
+
+static bool isOverBudget(void)
+{
+	return memoryBudget > 0 && totalMemory() > memoryBudget;
+}
+
+/**
+ * @brief The representation of a patient that is added or expanded again: compact when
+ *        an expanded record would not fit in the budget anymore.
+ */
+static PatientRepresentation hotRepresentation(void)
+{
+	size_t expandedSize = sizeof(Patient) + MAX_PATIENTNAME_SIZE +
+	                      MAX_DOSES_PER_PATIENT * sizeof(DoseData);
+
+	if (memoryBudget > 0 && totalMemory() + expandedSize > memoryBudget) {
+		return PATIENT_COMPACT;
+	}
+	return PATIENT_EXPANDED;
+}
+
+static Patient* allocatePatient(char patientName[MAX_PATIENTNAME_SIZE], PatientRepresentation representation)
+{
+	Patient* patient;
+
+	if (representation == PATIENT_EXPANDED) {
+		patient = malloc(sizeof(Patient) + MAX_PATIENTNAME_SIZE +
+		                 MAX_DOSES_PER_PATIENT * sizeof(DoseData));
+		if (patient == NULL) {
+			return NULL;
+		}
+		// strncpy zero-pads the whole buffer; the doses live right behind it
+		strncpy(patient->patientName, patientName, MAX_PATIENTNAME_SIZE);
+		patient->doses = (DoseData*)(patient->patientName + MAX_PATIENTNAME_SIZE);
+	}
+	else {
+		size_t length = strlen(patientName);
+		size_t slotSize = NameSlotSize(length);
+		patient = malloc(sizeof(Patient) + slotSize);
+		if (patient == NULL) {
+			return NULL;
+		}
+		memcpy(patient->patientName, patientName, length);
+		memset(patient->patientName + length, 0, slotSize - length);
+		patient->doses = NULL;
+	}
+	patient->next = NULL;
+	patient->patientId = 0;
+	patient->doseCount = 0;
+	patient->representation = (uint8_t)representation;
+	patient->encodedSize = 0;
+	return patient;
+}
+
+static void freePatient(Patient* patient)
+{
+	if (patient->representation == PATIENT_EVICTED) {
+		// Its history in the segment is garbage from now on
+		coldTierStats.evictedPatients--;
+		coldTierStats.deadBytes += patient->encodedSize;
+	}
+	accountPatient(patient, -1);
+	memoryUsage.indexBytes -= sizeof(Patient*);
+	layoutVersion++;
+	if (patient->representation == PATIENT_COMPACT) {
+		free(patient->doses);
+	}
+	free(patient);
+}
+
+/**
+ * @brief Replaces an expanded patient by a compact copy at the same place in its chain.
+ * @return the compact patient, or the original one when memory allocation failed
+ */
+static Patient* compactPatient(Patient** link)
+{
+	Patient* expanded = *link;
+	Patient* compact = allocatePatient(expanded->patientName, PATIENT_COMPACT);
+	if (compact == NULL) {
+		return expanded;
+	}
+	if (expanded->doseCount > 0) {
+		compact->doses = malloc(expanded->doseCount * sizeof(DoseData));
+		if (compact->doses == NULL) {
+			free(compact);
+			return expanded;
+		}
+		memcpy(compact->doses, expanded->doses, expanded->doseCount * sizeof(DoseData));
+	}
+	compact->doseCount = expanded->doseCount;
+	compact->next = expanded->next;
+	compact->patientId = expanded->patientId;
+
+	accountPatient(expanded, -1);
+	accountPatient(compact, 1);
+	free(expanded);
+	*link = compact;
+	layoutVersion++;
+	return compact;
+}
+
+static uint8_t* encodedDoses(const Patient* patient)
+{
+	return (uint8_t*)patient->patientName + storedNameSize(patient);
+}
+
+/**
+ * @brief Decodes the next dose of an encoded dose history.
+ * @return the number of bytes read
+ */
+static size_t decodeDose(const uint8_t* stream, uint32_t* dayNumber, uint16_t* dose,
+                         uint8_t* examType)
+{
+	uint32_t delta;
+	uint32_t value;
+	size_t size = DecodeVarint(stream, &delta);
+
+	size += DecodeVarint(stream + size, &value);
+	*dayNumber += (uint32_t)ZigZagDecode(delta);
+	*dose = (uint16_t)(value >> EXAM_TYPE_BITS);
+	*examType = (uint8_t)(value & EXAM_TYPE_MASK);
+	return size;
+}
+
+/**
+ * @brief Replaces a patient by one allocation holding its name and its dose history 
+ *        encoded as zigzag varint day number deltas followed by varint doses, each 
+ *        dose shifted left to make room for its examination type.
+ * @return the encoded patient, or the original one when memory allocation failed
+ */
+static Patient* encodePatient(Patient** link)
+{
+	Patient* patient = *link;
+	uint8_t stream[MAX_DOSES_PER_PATIENT * MAX_ENCODED_DOSE_SIZE];
+	size_t streamSize = 0;
+	uint32_t previousDay = 0;
+
+	for (size_t i = 0; i < patient->doseCount; i++) {
+		uint32_t day = DateToDayNumber(&patient->doses[i].date);
+		streamSize += EncodeVarint(ZigZagEncode((int32_t)(day - previousDay)), stream + streamSize);
+		uint32_t value = ((uint32_t)patient->doses[i].dose << EXAM_TYPE_BITS) |
+		                 patient->doses[i].examType;
+		streamSize += EncodeVarint(value, stream + streamSize);
+		previousDay = day;
+	}
+
+	size_t nameSize = NameSlotSize(strlen(patient->patientName));
+	Patient* encoded = malloc(sizeof(Patient) + nameSize + streamSize);
+	if (encoded == NULL) {
+		return patient;
+	}
+	memcpy(encoded->patientName, patient->patientName, nameSize);
+	memcpy(encoded->patientName + nameSize, stream, streamSize);
+	encoded->next = patient->next;
+	encoded->patientId = patient->patientId;
+	encoded->doses = NULL;
+	encoded->doseCount = patient->doseCount;
+	encoded->representation = PATIENT_ENCODED;
+	encoded->encodedSize = (uint16_t)streamSize;
+
+	accountPatient(patient, -1);
+	accountPatient(encoded, 1);
+	if (patient->representation == PATIENT_COMPACT) {
+		free(patient->doses);
+	}
+	free(patient);
+	*link = encoded;
+	layoutVersion++;
+	return encoded;
+}
+
+/**
+ * @brief Turns an encoded patient back into the hot (expanded, or compact when over 
+ *        budget) form, so doses can be appended again.
+ * @return the decoded patient, or NULL when memory allocation failed
+ */
+static Patient* decodePatient(Patient** link)
+{
+	Patient* encoded = *link;
+	PatientRepresentation representation = hotRepresentation();
+	Patient* patient = allocatePatient(encoded->patientName, representation);
+	if (patient == NULL) {
+		return NULL;
+	}
+	if (representation == PATIENT_COMPACT && encoded->doseCount > 0) {
+		patient->doses = malloc(encoded->doseCount * sizeof(DoseData));
+		if (patient->doses == NULL) {
+			free(patient);
+			return NULL;
+		}
+	}
+
+	const uint8_t* stream = encodedDoses(encoded);
+	uint32_t day = 0;
+	for (size_t i = 0; i < encoded->doseCount; i++) {
+		stream += decodeDose(stream, &day, &patient->doses[i].dose, &patient->doses[i].examType);
+		DayNumberToDate(day, &patient->doses[i].date);
+	}
+	patient->doseCount = encoded->doseCount;
+	patient->next = encoded->next;
+	patient->patientId = encoded->patientId;
+
+	accountPatient(encoded, -1);
+	accountPatient(patient, 1);
+	free(encoded);
+	*link = patient;
+	layoutVersion++;
+	return patient;
+}
+
+/**
+ * @brief Writes the encoded history of a patient to the cold segment and replaces the
+ *        patient by a stub with its name, dose count and segment offset.
+ * @return true when the patient was evicted
+ */
+static bool evictPatient(Patient** link)
+{
+	Patient* patient = *link;
+	if (patient->representation != PATIENT_ENCODED) {
+		patient = encodePatient(link);
+		if (patient->representation != PATIENT_ENCODED) {
+			return false;
+		}
+	}
+
+	size_t nameSize = NameSlotSize(strlen(patient->patientName));
+	uint64_t offset = coldTierStats.segmentBytes;
+	if (fseek(coldSegment, (long)offset, SEEK_SET) != 0 ||
+	    fwrite(encodedDoses(patient), 1, patient->encodedSize, coldSegment) != patient->encodedSize) {
+		return false;
+	}
+
+	Patient* stub = malloc(sizeof(Patient) + nameSize + sizeof(uint64_t));
+	if (stub == NULL) {
+		return false;
+	}
+	memcpy(stub->patientName, patient->patientName, nameSize);
+	memcpy(stub->patientName + nameSize, &offset, sizeof(uint64_t));
+	stub->next = patient->next;
+	stub->patientId = patient->patientId;
+	stub->doses = NULL;
+	stub->doseCount = patient->doseCount;
+	stub->representation = PATIENT_EVICTED;
+	stub->encodedSize = patient->encodedSize;
+
+	coldTierStats.segmentBytes += patient->encodedSize;
+	coldTierStats.evictedPatients++;
+	accountPatient(patient, -1);
+	accountPatient(stub, 1);
+	free(patient);
+	*link = stub;
+	layoutVersion++;
+	return true;
+}
+
+/**
+ * @brief Reads the history of an evicted patient back from the cold segment.
+ * @return the patient in encoded form, or NULL when reading or allocation failed
+ */
+static bool readEvictedHistory(const Patient* stub, uint8_t* stream)
+{
+	size_t nameSize = NameSlotSize(strlen(stub->patientName));
+	uint64_t offset;
+	memcpy(&offset, stub->patientName + nameSize, sizeof(uint64_t));
+
+	fflush(coldSegment);
+	return fseek(coldSegment, (long)offset, SEEK_SET) == 0 &&
+	       fread(stream, 1, stub->encodedSize, coldSegment) == stub->encodedSize;
+}
+
+static Patient* rehydratePatient(Patient** link)
+{
+	Patient* stub = *link;
+	size_t nameSize = NameSlotSize(strlen(stub->patientName));
+
+	Patient* patient = malloc(sizeof(Patient) + nameSize + stub->encodedSize);
+	if (patient == NULL) {
+		return NULL;
+	}
+	if (!readEvictedHistory(stub, (uint8_t*)patient->patientName + nameSize)) {
+		free(patient);
+		return NULL;
+	}
+	memcpy(patient->patientName, stub->patientName, nameSize);
+	patient->next = stub->next;
+	patient->patientId = stub->patientId;
+	patient->doses = NULL;
+	patient->doseCount = stub->doseCount;
+	patient->representation = PATIENT_ENCODED;
+	patient->encodedSize = stub->encodedSize;
+
+	coldTierStats.evictedPatients--;
+	coldTierStats.deadBytes += stub->encodedSize;
+	coldTierStats.rehydrations++;
+	accountPatient(stub, -1);
+	accountPatient(patient, 1);
+	free(stub);
+	*link = patient;
+	layoutVersion++;
+	return patient;
+}
+
+/**
+ * @brief Returns the resident form of the patient behind link, reading an evicted 
+ *        patient back from disk first. Returns NULL when that failed.
+ */
+static Patient* residentPatient(Patient** link)
+{
+	if ((*link)->representation == PATIENT_EVICTED) {
+		return rehydratePatient(link);
+	}
+	return *link;
+}
+
+/**
+ * @brief Makes the doses of a patient available as an array: the patient's own array 
+ *        when it has one (zero-copy), otherwise decoded into scratch.
+ * @return false when the history of an evicted patient could not be read
+ */
+static bool loadDoses(const Patient* patient, DoseData scratch[MAX_DOSES_PER_PATIENT],
+                      const DoseData** doses)
+{
+	uint8_t buffer[MAX_DOSES_PER_PATIENT * MAX_ENCODED_DOSE_SIZE];
+	const uint8_t* stream;
+
+	switch (patient->representation) {
+	case PATIENT_EXPANDED:
+	case PATIENT_COMPACT:
+		*doses = patient->doses;
+		return true;
+	case PATIENT_ENCODED:
+		stream = encodedDoses(patient);
+		break;
+	default:
+		// Read without rehydrating, a read-only pass should not pull the registry in
+		if (!readEvictedHistory(patient, buffer)) {
+			return false;
+		}
+		stream = buffer;
+		break;
+	}
+
+	uint32_t day = 0;
+	for (size_t i = 0; i < patient->doseCount; i++) {
+		stream += decodeDose(stream, &day, &scratch[i].dose, &scratch[i].examType);
+		DayNumberToDate(day, &scratch[i].date);
+	}
+	*doses = scratch;
+	return true;
+}
+
+/**
+ * @brief Returns the day number of the most recent dose, 0 when there are no doses.
+ */
+static uint32_t lastDoseDay(const Patient* patient)
+{
+	uint32_t lastDay = 0;
+
+	if (patient->representation == PATIENT_ENCODED) {
+		const uint8_t* stream = encodedDoses(patient);
+		uint32_t day = 0;
+		uint16_t dose;
+		uint8_t examType;
+		for (size_t i = 0; i < patient->doseCount; i++) {
+			stream += decodeDose(stream, &day, &dose, &examType);
+			if (day > lastDay) {
+				lastDay = day;
+			}
+		}
+		return lastDay;
+	}
+
+	for (size_t i = 0; i < patient->doseCount; i++) {
+		uint32_t day = DateToDayNumber(&patient->doses[i].date);
+		if (day > lastDay) {
+			lastDay = day;
+		}
+	}
+	return lastDay;
+}
+
+static bool isIdle(const Patient* patient, uint32_t todayNumber, uint16_t idleDays)
+{
+	// Idle since the most recent dose, patients without doses are idle anyway
+	return patient->doseCount == 0 || lastDoseDay(patient) + idleDays <= todayNumber;
+}
+
+/**
+ * @brief Compacts expanded patients until the registry fits in the budget again. Each 
+ *        pass goes on at the table entry where the previous one stopped, and returns at
+ *        once when no patient is left to compact.
+ * @details Replaces records, so links into the table are not valid anymore afterwards.
+ */
+static void enforceMemoryBudget(void)
+{
+	for (size_t n = 0; n < HASHTABLE_SIZE && expandedPatients > 0 && isOverBudget(); n++) {
+		for (Patient** link = &hashTable[budgetBucket]; *link != NULL; link = &(*link)->next) {
+			if ((*link)->representation == PATIENT_EXPANDED) {
+				compactPatient(link);
+			}
+		}
+		budgetBucket = (budgetBucket + 1) % HASHTABLE_SIZE;
+	}
+}
+
+/**
+ * @brief Refills a larger lookup filter from the names in the table. The filter holds 
+ *        only fingerprints, so it cannot grow by itself.
+ */
+static void rebuildLookupFilter(void)
+{
+	lookupFilterStats.rebuilds++;
+	if (!CuckooFilterReset(CuckooFilterCapacity())) {
+		return; // Without a filter every lookup walks its chain
+	}
+	for (int i = 0; i < HASHTABLE_SIZE; i++) {
+		for (Patient* patient = hashTable[i]; patient != NULL; patient = patient->next) {
+			if (!CuckooFilterAdd(NameHash(patient->patientName))) {
+				CuckooFilterDisable();
+				return;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Converts a date to YYYYMMDD for simple integer comparison.
+ */
+static uint32_t dateValue(const Date* date)
+{
+    return date->year * 10000 + date->month * 100 + date->day;
+}
+
+/**
+ * @brief NameHash of a stored name for the shared registry, for callers that have no
+ *        key of the name. Only computed while the registry is shared, 0 otherwise.
+ */
+static uint64_t sharedNameHash(const Patient* patient)
+{
+    return SharedRegistryIsEnabled() ? NameHash(patient->patientName) : 0;
+}
+
+/**
+ * @brief Drops the doses before the retention horizon from the patient behind link,
+ *        from its record and from every index.
+ * @param key the key the patient was found with, NULL when there is none
+ * @return 1 when doses were dropped, 0 when it had none to drop, -1 when reading the
+ *         cold patient back or allocation of memory failed (the doses stay then)
+ */
+static int8_t expireDoses(Patient** link, const NameKey* key)
+{
+	DoseData scratch[MAX_DOSES_PER_PATIENT];
+	const DoseData* doses;
+	size_t expired = 0;
+
+	// Look first, a patient without expired doses keeps its representation
+	if (!loadDoses(*link, scratch, &doses)) {
+		return -1;
+	}
+	for (size_t i = 0; i < (*link)->doseCount; i++) {
+		if (dateValue(&doses[i].date) < retentionValue) {
+			expired++;
+		}
+	}
+	if (expired == 0) {
+		return 0;
+	}
+
+	Patient* patient = residentPatient(link);
+	if (patient != NULL && patient->representation == PATIENT_ENCODED) {
+		patient = decodePatient(link);
+	}
+	// Open snapshots keep the doses as they were
+	if (patient == NULL || !VersionLogReplace(patient->patientId, patient->doses, patient->doseCount)) {
+		return -1;
+	}
+
+	accountPatient(patient, -1);
+	size_t kept = 0;
+	for (size_t i = 0; i < patient->doseCount; i++) {
+		DoseData dose = patient->doses[i];
+		if (dateValue(&dose.date) < retentionValue) {
+			DateIndexRemove(&dose.date, dose.dose, patient->patientId);
+			RollupRemove(patient->patientId, &dose.date, dose.dose, dose.examType);
+			DoseSketchRemove(&dose.date, dose.examType, dose.dose);
+		}
+		else {
+			patient->doses[kept++] = dose;
+		}
+	}
+	patient->doseCount = (uint8_t)kept;
+	if (patient->representation == PATIENT_COMPACT) {
+		// Shrink the exact-size array; should that fail the larger one is fine
+		if (kept == 0) {
+			free(patient->doses);
+			patient->doses = NULL;
+		}
+		else {
+			DoseData* shrunk = realloc(patient->doses, kept * sizeof(DoseData));
+			if (shrunk != NULL) {
+				patient->doses = shrunk;
+			}
+		}
+	}
+	accountPatient(patient, 1);
+
+	PeriodCacheInvalidatePatient(patient->patientId);
+	DoseMonitorForget(patient->patientId); // Its windows are summed again on the next dose
+	SharedRegistrySetDoses((key != NULL) ? key->hash : sharedNameHash(patient),
+	                       patient->patientName, patient->doses, patient->doseCount);
+	return 1;
+}
+
+/**
+ * @brief Leaves out the doses before horizon (YYYYMMDD), copying the others to scratch
+ *        when any is left out.
+ */
+static void retainDoses(uint32_t horizon, DoseData scratch[MAX_DOSES_PER_PATIENT],
+                        const DoseData** doses, size_t* nrOfDoses)
+{
+	size_t i = 0;
+	while (i < *nrOfDoses && dateValue(&(*doses)[i].date) >= horizon) {
+		i++;
+	}
+	if (i == *nrOfDoses) {
+		return; // Nothing expired, keep the array as it is
+	}
+
+	size_t kept = 0;
+	for (i = 0; i < *nrOfDoses; i++) {
+		if (dateValue(&(*doses)[i].date) >= horizon) {
+			scratch[kept++] = (*doses)[i];
+		}
+	}
+	*doses = scratch;
+	*nrOfDoses = kept;
+}
+
+/**
+ * @brief Returns the link (table entry or next pointer) that points to the patient,
+ *        or NULL when the patient is not present.
+ * @details After a purge, the patient found loses its expired doses first.
+ */
+static Patient** findPatientLink(const NameKey* key)
+{
+	if (!CuckooFilterMayContain(key->hash)) {
+		lookupFilterStats.rejectedLookups++;
+		return NULL;
+	}
+
+	Patient** link = &hashTable[key->bucket];
+	while (*link != NULL) {
+		if (NameKeyEquals(key, (*link)->patientName)) {
+			if (compactionPending) {
+				expireDoses(link, key);
+			}
+			return link;
+		}
+		link = &(*link)->next;
+	}
+	if (CuckooFilterCapacity() > 0) {
+		lookupFilterStats.falsePositives++;
+	}
+	return NULL;
+}
+
+static Patient* findPatient(const NameKey* key)
+{
+	Patient** link = findPatientLink(key);
+	return (link != NULL) ? *link : NULL;
+}
+
+/**
+ * @brief Returns the link that points to the patient with a patient number, or NULL.
+ *        bucket, when not NULL, is set to the table entry of the patient.
+ * @details The link is cached in the index entry until a record is added, removed or 
+ *          replaced; then the table entry is walked again, comparing patient ids only.
+ */
+static Patient** findPatientLinkByNumber(uint64_t patientNumber, uint8_t* bucket)
+{
+	PatientNumberEntry* entry = PatientNumberIndexFind(patientNumber);
+	if (entry == NULL) {
+		return NULL;
+	}
+	if (bucket != NULL) {
+		*bucket = entry->bucket;
+	}
+
+	Patient** link = entry->link;
+	if (link == NULL || entry->layoutVersion != layoutVersion) {
+		for (link = &hashTable[entry->bucket]; (*link)->patientId != entry->patientId;
+		     link = &(*link)->next) {
+		}
+	}
+	if (compactionPending) {
+		expireDoses(link, NULL); // Replaces the record at most, the link stays valid
+	}
+	entry->link = link;
+	entry->layoutVersion = layoutVersion;
+	return link;
+}
+
+static void resetRetention(void)
+{
+	retentionValue = 0;
+	compactionPending = false;
+	sweepBucket = 0;
+	sweepFailed = false;
+}
+
+void CreateHashTable(void)
+{
+    // Initialize all pointers in the hash table to NULL.
+	for (int i = 0; i < HASHTABLE_SIZE; i++) {
+        hashTable[i] = NULL;
+    }
+    memoryUsage = (MemoryUsage){0};
+    memoryUsage.indexBytes = sizeof(hashTable);
+    expandedPatients = 0;
+    budgetBucket = 0;
+    lookupFilterStats = (LookupFilterStats){0};
+    CuckooFilterReset(0);
+    SharedRegistryClear();
+    PeriodCacheClear();
+    DateIndexClear();
+    RollupClear();
+    DoseSketchClear();
+    DoseMonitorClear();
+    NameIndexClear();
+    VersionLogClear();
+    PatientNumberIndexClear();
+    removedPatients = NULL;
+    resetRetention();
+    ChangeFeedRemoveAll();
+}
+
+static size_t patientCount(void)
+{
+	// Every patient has one link in the table, an entry or the next pointer before it
+	return (memoryUsage.indexBytes - sizeof(hashTable)) / sizeof(Patient*);
+}
+
+/**
+ * @brief The number of tasks for a pass over the table, 1 while it is small: starting
+ *        the threads would then take longer than the pass itself.
+ */
+static size_t tableTasks(void)
+{
+	return (patientCount() < MIN_PARALLEL_PATIENTS) ? 1 : MAX_TABLE_TASKS;
+}
+
+static void tableRange(size_t task, size_t nrOfTasks, size_t* first, size_t* end)
+{
+	*first = HASHTABLE_SIZE * task / nrOfTasks;
+	*end = HASHTABLE_SIZE * (task + 1) / nrOfTasks;
+}
+
+// --- Table scans ---
+// The maintenance passes look at every patient but change few of them. Looking is
+// read-only and runs on the thread pool per range of table entries; the changes are
+// made on the calling thread afterwards, in table order, to the patients found.
+
+// Decides on a worker thread whether a patient is changed, must only read the patient
+typedef bool (*PatientFilter)(const Patient* patient, const void* context);
+
+typedef struct {
+	const Patient** patients; // in table order
+	size_t count;
+	size_t capacity;
+	bool failed;              // allocation failed, the filter is applied again serially
+} ScanCandidates;
+
+typedef struct {
+	size_t first;             // the table entries [first, end) are scanned
+	size_t end;
+	size_t nrOfTasks;
+	PatientFilter filter;
+	const void* context;
+	ScanCandidates tasks[MAX_TABLE_TASKS];
+	size_t task;              // position of the serial pass in the candidates
+	size_t next;
+} TableScan;
+
+static void scanRange(const TableScan* scan, size_t task, size_t* first, size_t* end)
+{
+	*first = scan->first + (scan->end - scan->first) * task / scan->nrOfTasks;
+	*end = scan->first + (scan->end - scan->first) * (task + 1) / scan->nrOfTasks;
+}
+
+static void scanEntries(size_t task, void* context)
+{
+	TableScan* scan = context;
+	ScanCandidates* candidates = &scan->tasks[task];
+	size_t first, end;
+
+	scanRange(scan, task, &first, &end);
+	for (size_t i = first; i < end && !candidates->failed; i++) {
+		for (const Patient* patient = hashTable[i]; patient != NULL; patient = patient->next) {
+			if (!scan->filter(patient, scan->context)) {
+				continue;
+			}
+			if (candidates->count == candidates->capacity) {
+				size_t capacity = (candidates->capacity == 0) ? 16 : 2 * candidates->capacity;
+				const Patient** patients = realloc(candidates->patients,
+				                                   capacity * sizeof(Patient*));
+				if (patients == NULL) {
+					candidates->failed = true;
+					break;
+				}
+				candidates->patients = patients;
+				candidates->capacity = capacity;
+			}
+			candidates->patients[candidates->count++] = patient;
+		}
+	}
+}
+
+/**
+ * @brief Finds the patients of the table entries [first, end) that pass filter, on the 
+ *        thread pool.
+ */
+static void scanTable(TableScan* scan, size_t first, size_t end, PatientFilter filter,
+                      const void* context)
+{
+	memset(scan, 0, sizeof(*scan));
+	scan->first = first;
+	scan->end = end;
+	scan->filter = filter;
+	scan->context = context;
+	scan->nrOfTasks = tableTasks();
+	if (scan->nrOfTasks > end - first) {
+		scan->nrOfTasks = (end > first) ? end - first : 1;
+	}
+	ThreadPoolRun(scan->nrOfTasks, scanEntries, scan);
+}
+
+/**
+ * @brief Tells whether the patient, in table entry bucket, passed the filter of the 
+ *        scan. Has to be asked for the patients in table order.
+ * @details The patients found are compared by address. Patients that were replaced 
+ *          before were already passed, and a record allocated since can not have the
+ *          address of one still to come.
+ */
+static bool isScanCandidate(TableScan* scan, size_t bucket, const Patient* patient)
+{
+	size_t first, end;
+
+	scanRange(scan, scan->task, &first, &end);
+	while (bucket >= end) {
+		scan->task++;
+		scan->next = 0;
+		scanRange(scan, scan->task, &first, &end);
+	}
+
+	ScanCandidates* candidates = &scan->tasks[scan->task];
+	if (candidates->failed) {
+		return scan->filter(patient, scan->context);
+	}
+	if (scan->next < candidates->count && candidates->patients[scan->next] == patient) {
+		scan->next++;
+		return true;
+	}
+	return false;
+}
+
+static void endScan(TableScan* scan)
+{
+	for (size_t task = 0; task < scan->nrOfTasks; task++) {
+		free(scan->tasks[task].patients);
+	}
+}
+
+void RemoveAllDataFromHashTable(void)
+{
+	// Loop through the table and free any allocated patient data
+    for (int i = 0; i < HASHTABLE_SIZE; i++) {
+        while (hashTable[i] != NULL) {
+            Patient* patient = hashTable[i];
+            hashTable[i] = patient->next;
+            freePatient(patient);
+        }
+    }
+    PeriodCacheClear();
+    DateIndexClear();
+    RollupClear();
+    DoseSketchClear();
+    DoseMonitorClear();
+    NameIndexClear();
+    CuckooFilterReset(0);
+    SharedRegistryClear();
+    VersionLogClear();
+    PatientNumberIndexClear();
+    ReclaimRemovedPatients();
+    resetRetention();
+    ChangeFeedRemoveAll();
+    if (coldSegment != NULL) {
+        // Nothing refers to the segment anymore, start writing at the beginning again
+        coldTierStats.segmentBytes = 0;
+        coldTierStats.deadBytes = 0;
+    }
+}
+
+int8_t AddPatient(char patientName[MAX_PATIENTNAME_SIZE])
+{
+    NameKey key;
+	if (!MakeNameKey(patientName, &key)) {
+        return -3; // Name too long
+    }
+
+    if (findPatient(&key) != NULL) {
+        return -1; // Patient already present
+    }
+
+    uint64_t fullHash = key.hash;
+    if (!SharedRegistryAdd(fullHash, patientName, NULL, 0)) {
+        return -2; // Shared registry segment full
+    }
+    if (!NameIndexAdd(patientName)) {
+        SharedRegistryRemove(fullHash, patientName);
+        return -2; // Allocation of memory failed
+    }
+
+    // Allocate memory for the new patient, compact once the budget is exhausted
+    Patient* newPatient = allocatePatient(patientName, hotRepresentation());
+    if (newPatient == NULL) {
+        NameIndexRemove(patientName);
+        SharedRegistryRemove(fullHash, patientName);
+        return -2; // Allocation of memory failed
+    }
+
+    uint8_t hash = key.bucket;
+    newPatient->patientId = nextPatientId++;
+    newPatient->next = hashTable[hash];
+    hashTable[hash] = newPatient;
+    layoutVersion++;
+    if (!CuckooFilterAdd(fullHash)) {
+        rebuildLookupFilter();
+    }
+
+    accountPatient(newPatient, 1);
+    memoryUsage.indexBytes += sizeof(Patient*);
+    ChangeFeedAddPatient(patientName);
+    enforceMemoryBudget();
+
+    return 0; // Success
+}
+
+/**
+ * @brief Removes the patient the link points to from the table and every index.
+ * @param nameHash NameHash of the patient's name
+ * @param deferFree keep the record in removedPatients instead of freeing it
+ */
+static int8_t removePatient(Patient** link, uint64_t nameHash, bool deferFree)
+{
+	Patient* patient = *link;
+	DoseData scratch[MAX_DOSES_PER_PATIENT];
+	const DoseData* doses = NULL;
+	bool readable = loadDoses(patient, scratch, &doses);
+	if (!VersionLogRemove(patient->patientId, patient->patientName, doses, patient->doseCount,
+	                      readable)) {
+		return -3; // Allocation of the copy for an open snapshot failed
+	}
+	if (readable) {
+		for (size_t i = 0; i < patient->doseCount; i++) {
+			DateIndexRemove(&doses[i].date, doses[i].dose, patient->patientId);
+			RollupRemove(patient->patientId, &doses[i].date, doses[i].dose, doses[i].examType);
+			DoseSketchRemove(&doses[i].date, doses[i].examType, doses[i].dose);
+		}
+	}
+	// else: the postings and totals stay behind, queries skip ids that are no longer present
+
+	*link = patient->next;
+	PeriodCacheInvalidatePatient(patient->patientId);
+	DoseMonitorForget(patient->patientId);
+	PatientNumberIndexForget(patient->patientId);
+	NameIndexRemove(patient->patientName);
+	CuckooFilterRemove(nameHash);
+	SharedRegistryRemove(nameHash, patient->patientName);
+	ChangeFeedRemovePatient(patient->patientName);
+	if (deferFree) {
+		patient->next = removedPatients;
+		removedPatients = patient;
+		layoutVersion++;
+	}
+	else {
+		freePatient(patient); // Free the dynamically allocated memory
+	}
+	return 0; // Success
+}
+
+int8_t AddPatientWithNumber(char patientName[MAX_PATIENTNAME_SIZE], uint64_t patientNumber)
+{
+    NameKey key;
+	if (!MakeNameKey(patientName, &key)) {
+        return -3; // Name too long
+    }
+
+    if (patientNumber == 0 || PatientNumberIndexFind(patientNumber) != NULL) {
+        return -1; // Not a valid number, or already in use
+    }
+    // Reserve first, so a failure leaves no patient behind
+    if (!PatientNumberIndexReserve()) {
+        return -2; // Allocation of memory failed
+    }
+
+    int8_t result = AddPatient(patientName);
+    if (result != 0) {
+        return result;
+    }
+    // AddPatient puts the new patient in front of its table entry
+    PatientNumberIndexAdd(patientNumber, hashTable[key.bucket]->patientId, key.bucket);
+    return 0; // Success
+}
+
+int8_t RemovePatient(char patientName[MAX_PATIENTNAME_SIZE])
+{
+    NameKey key;
+	if (!MakeNameKey(patientName, &key)) {
+        return -2; // Name too long
+    }
+
+    Patient** link = findPatientLink(&key);
+    if (link == NULL) {
+        return -1; // Patient not present
+    }
+    return removePatient(link, key.hash, false);
+}
+
+int8_t RemovePatients(char patientNames[][MAX_PATIENTNAME_SIZE], size_t nrOfPatients,
+                      size_t* nrOfRemoved)
+{
+	int8_t result = 0;
+
+	*nrOfRemoved = 0; // Initialize output parameter
+	for (size_t i = 0; i < nrOfPatients; i++) {
+		NameKey key;
+		if (!MakeNameKey(patientNames[i], &key)) {
+			continue; // Name too long
+		}
+		Patient** link = findPatientLink(&key);
+		if (link == NULL) {
+			continue; // Patient not present
+		}
+		if (removePatient(link, key.hash, true) != 0) {
+			result = -3; // This one stays, go on with the others
+			continue;
+		}
+		(*nrOfRemoved)++;
+	}
+	return result;
+}
+
+size_t ReclaimRemovedPatients(void)
+{
+	size_t freed = 0;
+
+	while (removedPatients != NULL) {
+		Patient* patient = removedPatients;
+		removedPatients = patient->next;
+		freePatient(patient);
+		freed++;
+	}
+	return freed;
+}
+
+int8_t FindPatientsByPrefix(char prefix[MAX_PATIENTNAME_SIZE],
+                            char patientNames[][MAX_PATIENTNAME_SIZE],
+                            size_t maxNrOfPatients, size_t* nrOfPatients)
+{
+    *nrOfPatients = 0; // Initialize output parameter
+
+	if (strlen(prefix) >= MAX_PATIENTNAME_SIZE) {
+        return -2; // Prefix too long
+    }
+
+    *nrOfPatients = NameIndexFind(prefix, patientNames, maxNrOfPatients);
+    return 0; // Success
+}
+
+int8_t IsPatientPresent(char patientName[MAX_PATIENTNAME_SIZE])
+{
+    NameKey key;
+	if (!MakeNameKey(patientName, &key)) {
+        return -2; // Name too long
+    }
+
+    if (findPatient(&key) != NULL) {
+        return 0; // Patient is present
+    }
+
+	return -1; // Patient not present
+}
+
+/**
+ * @brief Returns startDate, or the retention horizon when that is later.
+ */
+static Date* retainedStart(Date* startDate)
+{
+	return (dateValue(startDate) < retentionValue) ? &retentionHorizon : startDate;
+}
+
+/**
+ * @brief Helper function to check if a date is within a given period.
+ */
+static bool isDateInRange(const Date* date, Date* startDate, Date* endDate)
+{
+    uint32_t dateVal = dateValue(date);
+    return (dateVal >= dateValue(startDate)) && (dateVal <= dateValue(endDate));
+}
+
+int8_t AddPatientDose(char patientName[MAX_PATIENTNAME_SIZE],
+			          Date* date, uint16_t dose)
+{
+    return AddPatientExamDose(patientName, date, dose, EXAM_TYPE_NONE);
+}
+
+/**
+ * @brief Takes a dose that could not be appended out of the date index, the rollups and
+ *        the dose sketch again.
+ */
+static void unindexDose(uint32_t patientId, Date* date, uint16_t dose, EXAMINATION_TYPES examType)
+{
+    DateIndexRemove(date, dose, patientId);
+    RollupRemove(patientId, date, dose, examType);
+    DoseSketchRemove(date, (uint8_t)examType, dose);
+}
+
+/**
+ * @brief Appends a dose to the patient behind link and to every structure that tracks 
+ *        doses. Returns the values of AddPatientExamDose for a known patient.
+ * @param bucket table entry of the patient
+ * @param nameHash NameHash of the patient's name, only used while the registry is shared
+ * @details The link stays valid, so the caller applies the memory budget when it is 
+ *          done with it.
+ */
+static int8_t appendDose(Patient** link, uint8_t bucket, uint64_t nameHash, Date* date,
+                         uint16_t dose, EXAMINATION_TYPES examType)
+{
+    if (!IsValidDate(date)) {
+        return -5; // Every index keeps its doses per month of the supported range
+    }
+    if ((unsigned)examType > EXAM_TYPE_NONE) {
+        return -6; // Unknown examination type
+    }
+    if (dateValue(date) < retentionValue) {
+        return -4; // Before the retention horizon
+    }
+    if ((*link)->doseCount >= MAX_DOSES_PER_PATIENT) {
+        return -2; // Dose array is full
+    }
+
+    Patient* patient = residentPatient(link);
+    if (patient == NULL) {
+        return -2; // Reading the cold patient back failed
+    }
+
+    if (patient->representation == PATIENT_ENCODED) {
+        // The patient is active again, expand the history before appending
+        patient = decodePatient(link);
+        if (patient == NULL) {
+            return -2; // Allocation of memory failed
+        }
+    }
+
+    if (!DateIndexAdd(date, dose, patient->patientId, bucket)) {
+        return -2; // Allocation of memory failed
+    }
+    if (!RollupAdd(patient->patientId, date, dose, examType)) {
+        DateIndexRemove(date, dose, patient->patientId);
+        return -2; // Allocation of memory failed
+    }
+    if (!DoseSketchAdd(date, (uint8_t)examType, dose)) {
+        DateIndexRemove(date, dose, patient->patientId);
+        RollupRemove(patient->patientId, date, dose, examType);
+        return -2; // Allocation of memory failed
+    }
+
+    if (patient->representation == PATIENT_COMPACT) {
+        // Grow the exact-size dose array by one, should a later step fail it stays larger
+        DoseData* doses = realloc(patient->doses, (patient->doseCount + 1) * sizeof(DoseData));
+        if (doses == NULL) {
+            unindexDose(patient->patientId, date, dose, examType);
+            return -2; // Allocation of memory failed
+        }
+        patient->doses = doses;
+    }
+
+    // Open snapshots keep seeing the old dose count. Recorded as the last step that can
+    // fail, so a failed append leaves no record of a change that was never made.
+    if (!VersionLogAppend(patient->patientId, patient->doseCount)) {
+        unindexDose(patient->patientId, date, dose, examType);
+        return -2; // Allocation of memory failed
+    }
+    if (patient->representation == PATIENT_COMPACT) {
+        accountPatient(patient, -1);
+    }
+
+    // Only the cached windows that contain the new date change
+    PeriodCacheInvalidateDate(patient->patientId, dateValue(date));
+    DoseMonitorAdd(patient->patientId, patient->patientName, patient->doses, patient->doseCount,
+                   date, dose);
+
+    // Add the dose
+    patient->doses[patient->doseCount].date = *date;
+    patient->doses[patient->doseCount].dose = dose;
+    patient->doses[patient->doseCount].examType = (uint8_t)examType;
+    SharedRegistryAppendDose(nameHash, patient->patientName, &patient->doses[patient->doseCount]);
+    ChangeFeedAddDose(patient->patientName, &patient->doses[patient->doseCount]);
+    patient->doseCount++;
+
+    if (patient->representation == PATIENT_COMPACT) {
+        accountPatient(patient, 1);
+    }
+
+	return 0; // Success
+}
+
+int8_t AddPatientExamDose(char patientName[MAX_PATIENTNAME_SIZE],
+                          Date* date, uint16_t dose, EXAMINATION_TYPES examType)
+{
+    NameKey key;
+	if (!MakeNameKey(patientName, &key)) {
+        return -3; // Name too long
+    }
+
+    Patient** link = findPatientLink(&key);
+    if (link == NULL) {
+        return -1; // Patient unknown
+    }
+    int8_t result = appendDose(link, key.bucket, key.hash, date, dose, examType);
+    enforceMemoryBudget();
+    return result;
+}
+
+/**
+ * @brief Sums the doses of the patient the link points to within a period.
+ */
+static int8_t doseInPeriod(Patient** link, Date* startDate, Date* endDate, uint32_t* totalDose)
+{
+    startDate = retainedStart(startDate);
+
+    // A repeated window is a cache probe, even for an evicted patient
+    uint32_t startValue = dateValue(startDate);
+    uint32_t endValue = dateValue(endDate);
+    if (PeriodCacheLookup((*link)->patientId, startValue, endValue, totalDose)) {
+        return 0; // Success
+    }
+
+    Patient* patient = residentPatient(link);
+    if (patient == NULL) {
+        return -3; // Reading the cold patient back failed
+    }
+
+    if (patient->representation == PATIENT_ENCODED) {
+        // Sum directly over the encoded history, without expanding it
+        const uint8_t* stream = encodedDoses(patient);
+        uint32_t startDay = DateToDayNumber(startDate);
+        uint32_t endDay = DateToDayNumber(endDate);
+        uint32_t day = 0;
+        uint16_t dose;
+        uint8_t examType;
+
+        for (size_t i = 0; i < patient->doseCount; i++) {
+            stream += decodeDose(stream, &day, &dose, &examType);
+            if (day >= startDay && day <= endDay) {
+                *totalDose += dose;
+            }
+        }
+    }
+    else {
+        // Iterate through the patient's doses
+        for (size_t i = 0; i < patient->doseCount; i++) {
+            if (isDateInRange(&patient->doses[i].date, startDate, endDate)) {
+                *totalDose += patient->doses[i].dose;
+            }
+        }
+    }
+
+    PeriodCacheStore(patient->patientId, startValue, endValue, *totalDose);
+	return 0; // Success
+}
+
+int8_t PatientDoseInPeriod(char patientName[MAX_PATIENTNAME_SIZE],
+                           Date* startDate, Date* endDate, uint32_t* totalDose)
+{
+    *totalDose = 0; // Initialize output parameter
+
+    NameKey key;
+	if (!MakeNameKey(patientName, &key)) {
+        return -2; // Name too long
+    }
+
+    Patient** link = findPatientLink(&key);
+    if (link == NULL) {
+        return -1; // Patient unknown
+    }
+    return doseInPeriod(link, startDate, endDate, totalDose);
+}
+
+int8_t PatientExamDoseInPeriod(char patientName[MAX_PATIENTNAME_SIZE], EXAMINATION_TYPES examType,
+                               Date* startDate, Date* endDate, uint32_t* totalDose)
+{
+    *totalDose = 0; // Initialize output parameter
+
+    NameKey key;
+    if (!MakeNameKey(patientName, &key)) {
+        return -2; // Name too long
+    }
+
+    Patient* patient = findPatient(&key);
+    if (patient == NULL) {
+        return -1; // Patient unknown
+    }
+
+    DoseData scratch[MAX_DOSES_PER_PATIENT];
+    const DoseData* doses;
+    if (!loadDoses(patient, scratch, &doses)) {
+        return -3; // Reading the cold patient back failed
+    }
+    startDate = retainedStart(startDate);
+    for (size_t i = 0; i < patient->doseCount; i++) {
+        if (doses[i].examType == examType &&
+            isDateInRange(&doses[i].date, startDate, endDate)) {
+            *totalDose += doses[i].dose;
+        }
+    }
+	return 0; // Success
+}
+
+int8_t GetPatientDosePerExamType(char patientName[MAX_PATIENTNAME_SIZE],
+                                 uint32_t totalDose[NR_OF_EXAM_TYPES])
+{
+    NameKey key;
+	if (!MakeNameKey(patientName, &key)) {
+        return -2; // Name too long
+    }
+
+    Patient* patient = findPatient(&key);
+    if (patient == NULL) {
+        return -1; // Patient not present
+    }
+
+    for (int type = 0; type < NR_OF_EXAM_TYPES; type++) {
+        totalDose[type] = (uint32_t)RollupExamTypeTotal(patient->patientId, (uint8_t)type);
+    }
+    return 0; // Success
+}
+
+void GetRegistryDosePerExamType(uint64_t totalDose[NR_OF_EXAM_TYPES])
+{
+    for (int type = 0; type < NR_OF_EXAM_TYPES; type++) {
+        totalDose[type] = RollupExamTypeTotal(ROLLUP_REGISTRY, (uint8_t)type);
+    }
+}
+
+int8_t ExamDoseQuantiles(EXAMINATION_TYPES examType, Date* startDate, Date* endDate,
+                         const double quantiles[], size_t nrOfQuantiles, uint16_t doses[])
+{
+    if ((unsigned)examType > EXAM_TYPE_NONE) {
+        return -2; // Unknown examination type
+    }
+    for (size_t i = 0; i < nrOfQuantiles; i++) {
+        if (!(quantiles[i] >= 0.0 && quantiles[i] <= 1.0)) {
+            return -2; // Not a quantile, NaN included
+        }
+    }
+
+    startDate = retainedStart(startDate);
+    if (DoseSketchQuantiles((uint8_t)examType, startDate, endDate, quantiles, nrOfQuantiles,
+                            doses) == 0) {
+        return -1; // No doses of this type in the period
+    }
+    return 0; // Success
+}
+
+int8_t SetDoseWindows(const DoseWindow windows[], size_t nrOfWindows)
+{
+    if (nrOfWindows > MAX_DOSE_WINDOWS) {
+        return -1; // Too many windows
+    }
+    for (size_t i = 0; i < nrOfWindows; i++) {
+        if (windows[i].days == 0) {
+            return -1; // Empty window
+        }
+    }
+
+    DoseMonitorConfigure(windows, nrOfWindows);
+    return 0; // Success
+}
+
+int8_t PollDoseAlert(DoseAlert* alert)
+{
+    return DoseMonitorPoll(alert) ? 0 : -1;
+}
+
+int8_t GetNumberOfMeasurements(char patientName[MAX_PATIENTNAME_SIZE],
+                               size_t * nrOfMeasurements)
+{
+    NameKey key;
+	if (!MakeNameKey(patientName, &key)) {
+        return -2; // Name too long
+    }
+
+    Patient* patient = findPatient(&key);
+    if (patient == NULL) {
+        return -1; // Patient not present
+    }
+
+    *nrOfMeasurements = patient->doseCount;
+	return 0; // Success
+}
+
+int8_t IsPatientNumberPresent(uint64_t patientNumber)
+{
+    return (PatientNumberIndexFind(patientNumber) != NULL) ? 0 : -1;
+}
+
+int8_t AddPatientDoseByNumber(uint64_t patientNumber, Date* date, uint16_t dose)
+{
+    return AddPatientExamDoseByNumber(patientNumber, date, dose, EXAM_TYPE_NONE);
+}
+
+int8_t AddPatientExamDoseByNumber(uint64_t patientNumber, Date* date, uint16_t dose,
+                                  EXAMINATION_TYPES examType)
+{
+    uint8_t bucket;
+    Patient** link = findPatientLinkByNumber(patientNumber, &bucket);
+    if (link == NULL) {
+        return -1; // Patient unknown
+    }
+    int8_t result = appendDose(link, bucket, sharedNameHash(*link), date, dose, examType);
+    enforceMemoryBudget();
+    return result;
+}
+
+int8_t PatientDoseInPeriodByNumber(uint64_t patientNumber, Date* startDate, Date* endDate,
+                                   uint32_t* totalDose)
+{
+    *totalDose = 0; // Initialize output parameter
+
+    Patient** link = findPatientLinkByNumber(patientNumber, NULL);
+    if (link == NULL) {
+        return -1; // Patient unknown
+    }
+    return doseInPeriod(link, startDate, endDate, totalDose);
+}
+
+int8_t GetNumberOfMeasurementsByNumber(uint64_t patientNumber, size_t* nrOfMeasurements)
+{
+    Patient** link = findPatientLinkByNumber(patientNumber, NULL);
+    if (link == NULL) {
+        return -1; // Patient not present
+    }
+
+    *nrOfMeasurements = (*link)->doseCount;
+    return 0; // Success
+}
+
+int8_t RemovePatientByNumber(uint64_t patientNumber)
+{
+    Patient** link = findPatientLinkByNumber(patientNumber, NULL);
+    if (link == NULL) {
+        return -1; // Patient not present
+    }
+    return removePatient(link, NameHash((*link)->patientName), false);
+}
+
+void SetMaintenanceThreads(size_t nrOfThreads)
+{
+	ThreadPoolSetLimit(nrOfThreads);
+}
+
+typedef struct {
+	size_t nrOfTasks;
+	size_t entries[HASHTABLE_SIZE]; // patients per table entry
+} CountTask;
+
+static void countEntries(size_t task, void* context)
+{
+	CountTask* count = context;
+	size_t first, end;
+
+	tableRange(task, count->nrOfTasks, &first, &end);
+	for (size_t i = first; i < end; i++) {
+		for (Patient* patient = hashTable[i]; patient != NULL; patient = patient->next) {
+			count->entries[i]++;
+		}
+	}
+}
+
+void GetHashPerformance(size_t *totalNumberOfPatients, double *averageNumberOfPatients,
+                        double *standardDeviation)
+{
+    size_t totalPatients = 0;
+    double sumOfSquares = 0.0; // Sum of (entries_in_slot)^2
+    CountTask count = { tableTasks(), {0} };
+
+    ThreadPoolRun(count.nrOfTasks, countEntries, &count);
+    for (int i = 0; i < HASHTABLE_SIZE; i++) {
+        totalPatients += count.entries[i];
+        sumOfSquares += (double)count.entries[i] * count.entries[i];
+    }
+
+    *totalNumberOfPatients = totalPatients;
+    *averageNumberOfPatients = (double)totalPatients / HASHTABLE_SIZE;
+
+    // Calculate variance and standard deviation
+    double meanOfSquares = sumOfSquares / HASHTABLE_SIZE;
+    double variance = meanOfSquares - (*averageNumberOfPatients * *averageNumberOfPatients);
+    *standardDeviation = sqrt(variance);
+}
+
+void GetMemoryUsage(MemoryUsage* usage)
+{
+    *usage = memoryUsage;
+    usage->indexBytes += DateIndexBytes() + RollupBytes() + DoseSketchBytes() + DoseMonitorBytes() +
+                         NameIndexBytes() + CuckooFilterBytes() + VersionLogBytes() +
+                         PatientNumberIndexBytes() + ChangeFeedBytes();
+    usage->totalBytes = totalMemory();
+}
+
+void SetMemoryBudget(size_t budgetBytes)
+{
+    memoryBudget = budgetBytes;
+    enforceMemoryBudget();
+}
+
+typedef struct {
+	uint32_t todayNumber;
+	uint16_t idleDays;
+} IdleSince;
+
+static bool isEncodable(const Patient* patient, const void* context)
+{
+	const IdleSince* idle = context;
+	return patient->representation != PATIENT_ENCODED &&
+	       patient->representation != PATIENT_EVICTED &&
+	       isIdle(patient, idle->todayNumber, idle->idleDays);
+}
+
+size_t EncodeInactivePatients(Date* today, uint16_t idleDays)
+{
+    IdleSince idle = {DateToDayNumber(today), idleDays};
+    size_t encodedPatients = 0;
+    TableScan scan;
+
+    scanTable(&scan, 0, HASHTABLE_SIZE, isEncodable, &idle);
+    for (size_t i = 0; i < HASHTABLE_SIZE; i++) {
+        for (Patient** link = &hashTable[i]; *link != NULL; link = &(*link)->next) {
+            Patient* patient = *link;
+            if (isScanCandidate(&scan, i, patient) && encodePatient(link) != patient) {
+                encodedPatients++;
+            }
+        }
+    }
+    endScan(&scan);
+    return encodedPatients;
+}
+
+int8_t PurgeDosesBefore(Date* horizon)
+{
+	if (!IsValidDate(horizon)) {
+		return -1; // Not a date of the supported range
+	}
+	if (dateValue(horizon) <= retentionValue) {
+		return 0; // The horizon only moves forward
+	}
+	retentionHorizon = *horizon;
+	retentionValue = dateValue(horizon);
+	ChangeFeedPurge(horizon);
+
+	// Whole months at once, the month of the horizon is left to the patients
+	DateIndexDropBefore(horizon);
+	DoseSketchDropBefore(horizon);
+	PeriodCacheClear();
+
+	// Every patient has to be looked at (again)
+	compactionPending = true;
+	sweepBucket = 0;
+	sweepFailed = false;
+	return 0; // Success
+}
+
+/**
+ * @brief Whether a patient may hold doses before the retention horizon. The history of
+ *        an evicted patient is on disk, expireDoses reads it on the calling thread.
+ */
+static bool mayHaveExpiredDoses(const Patient* patient, const void* context)
+{
+	DoseData scratch[MAX_DOSES_PER_PATIENT];
+	const DoseData* doses;
+
+	(void)context;
+	if (patient->representation == PATIENT_EVICTED) {
+		return true;
+	}
+	loadDoses(patient, scratch, &doses);
+	for (size_t i = 0; i < patient->doseCount; i++) {
+		if (dateValue(&doses[i].date) < retentionValue) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief The number of table entries from the sweep position that hold about 
+ *        nrOfPatients patients, so a small step does not scan the rest of the table.
+ */
+static size_t sweepEntries(size_t nrOfPatients)
+{
+	size_t remaining = HASHTABLE_SIZE - sweepBucket;
+	size_t total = patientCount();
+
+	if (nrOfPatients >= total) {
+		return remaining;
+	}
+	size_t entries = nrOfPatients * HASHTABLE_SIZE / total + 1;
+	return (entries < remaining) ? entries : remaining;
+}
+
+size_t CompactExpiredPatients(size_t maxNrOfPatients)
+{
+	size_t visited = 0;
+	size_t compacted = 0;
+	TableScan scan;
+
+	while (compactionPending && visited < maxNrOfPatients) {
+		size_t end = sweepBucket + sweepEntries(maxNrOfPatients - visited);
+		scanTable(&scan, sweepBucket, end, mayHaveExpiredDoses, NULL);
+		for (; sweepBucket < end && visited < maxNrOfPatients; sweepBucket++) {
+			for (Patient** link = &hashTable[sweepBucket]; *link != NULL; link = &(*link)->next) {
+				int8_t result = 0;
+				if (isScanCandidate(&scan, sweepBucket, *link)) {
+					result = expireDoses(link, NULL);
+				}
+				if (result > 0) {
+					compacted++;
+				}
+				else if (result < 0) {
+					sweepFailed = true;
+				}
+				visited++;
+			}
+		}
+		endScan(&scan);
+		if (sweepBucket == HASHTABLE_SIZE) {
+			// A full pass: done, unless a patient has to be tried again
+			compactionPending = sweepFailed;
+			sweepBucket = 0;
+			sweepFailed = false;
+		}
+	}
+	return compacted;
+}
+
+void EnableChangeFeed(void)
+{
+    ChangeFeedEnable();
+}
+
+void DisableChangeFeed(void)
+{
+    ChangeFeedDisable();
+}
+
+uint64_t GetChangeSequence(void)
+{
+    return ChangeFeedSequence();
+}
+
+int8_t ExportChangesSince(uint64_t sequence, uint8_t buffer[], size_t bufferSize,
+                          size_t* nrOfBytes, uint64_t* lastSequence)
+{
+    return ChangeFeedExport(sequence, buffer, bufferSize, nrOfBytes, lastSequence);
+}
+
+void TrimChangesBefore(uint64_t sequence)
+{
+    ChangeFeedTrim(sequence);
+}
+
+int8_t ReadPatientChange(const uint8_t** position, const uint8_t* end, PatientChange* change)
+{
+    return ChangeFeedRead(position, end, change) ? 0 : -1;
+}
+
+int8_t EnableColdTier(char filePath[MAX_FILEPATH_LEGTH])
+{
+    if (coldSegment != NULL) {
+        return -1; // Already enabled
+    }
+    coldSegment = fopen(filePath, "w+b");
+    if (coldSegment == NULL) {
+        return -1;
+    }
+    coldTierStats = (ColdTierStats){0};
+    return 0;
+}
+
+int8_t DisableColdTier(void)
+{
+    if (coldSegment == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < HASHTABLE_SIZE; i++) {
+        for (Patient** link = &hashTable[i]; *link != NULL; link = &(*link)->next) {
+            if (residentPatient(link) == NULL) {
+                return -1; // Keep the segment, some patients still live there
+            }
+        }
+    }
+    fclose(coldSegment);
+    coldSegment = NULL;
+    return 0;
+}
+
+static bool isEvictable(const Patient* patient, const void* context)
+{
+	const IdleSince* idle = context;
+	return patient->representation != PATIENT_EVICTED &&
+	       isIdle(patient, idle->todayNumber, idle->idleDays);
+}
+
+size_t EvictInactivePatients(Date* today, uint16_t idleDays)
+{
+    IdleSince idle = {DateToDayNumber(today), idleDays};
+    size_t evictedPatients = 0;
+    TableScan scan;
+
+    if (coldSegment == NULL) {
+        return 0;
+    }
+    scanTable(&scan, 0, HASHTABLE_SIZE, isEvictable, &idle);
+    for (size_t i = 0; i < HASHTABLE_SIZE; i++) {
+        for (Patient** link = &hashTable[i]; *link != NULL; link = &(*link)->next) {
+            if (isScanCandidate(&scan, i, *link) && evictPatient(link)) {
+                evictedPatients++;
+            }
+        }
+    }
+    endScan(&scan);
+    return evictedPatients;
+}
+
+void GetColdTierStats(ColdTierStats* stats)
+{
+    *stats = coldTierStats;
+}
+
+int8_t EnableSharedRegistry(char segmentName[MAX_FILEPATH_LEGTH], size_t maxNrOfPatients)
+{
+    if (SharedRegistryIsEnabled() || !SharedRegistryCreate(segmentName, maxNrOfPatients)) {
+        return -1;
+    }
+
+    // Publish the patients that are already present
+    for (int i = 0; i < HASHTABLE_SIZE; i++) {
+        for (Patient* patient = hashTable[i]; patient != NULL; patient = patient->next) {
+            DoseData scratch[MAX_DOSES_PER_PATIENT];
+            const DoseData* doses;
+            if (!loadDoses(patient, scratch, &doses)) {
+                SharedRegistryDestroy();
+                return -3; // Reading the cold patient back failed
+            }
+            if (!SharedRegistryAdd(NameHash(patient->patientName), patient->patientName, doses,
+                                   patient->doseCount)) {
+                SharedRegistryDestroy();
+                return -2; // Segment too small
+            }
+        }
+    }
+    return 0;
+}
+
+void DisableSharedRegistry(void)
+{
+    SharedRegistryDestroy();
+}
+
+int8_t OpenSharedRegistry(char segmentName[MAX_FILEPATH_LEGTH], SharedRegistryView* view)
+{
+    return SharedRegistryMap(segmentName, view) ? 0 : -1;
+}
+
+void CloseSharedRegistry(SharedRegistryView* view)
+{
+    SharedRegistryUnmap(view);
+}
+
+int8_t SharedPatientDoses(SharedRegistryView* view, char patientName[MAX_PATIENTNAME_SIZE],
+                          DoseData doses[MAX_DOSES_PER_PATIENT], size_t* nrOfDoses)
+{
+    uint8_t count = 0;
+
+    *nrOfDoses = 0;
+    NameKey key;
+	if (!MakeNameKey(patientName, &key)) {
+        return -2; // Name too long
+    }
+
+    int8_t result = SharedRegistryRead(view, key.hash, patientName, doses, &count);
+    *nrOfDoses = count;
+    return result;
+}
+
+int8_t SharedPatientDoseInPeriod(SharedRegistryView* view, char patientName[MAX_PATIENTNAME_SIZE],
+                                 Date* startDate, Date* endDate, uint32_t* totalDose)
+{
+    DoseData doses[MAX_DOSES_PER_PATIENT];
+    size_t nrOfDoses;
+
+    *totalDose = 0;
+    int8_t result = SharedPatientDoses(view, patientName, doses, &nrOfDoses);
+    for (size_t i = 0; i < nrOfDoses; i++) {
+        if (isDateInRange(&doses[i].date, startDate, endDate)) {
+            *totalDose += doses[i].dose;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Looks up the state a patient had when the snapshot was opened. live is the 
+ *        patient with that id in the table, NULL when it has been removed since.
+ * @return 0 when name, doses and nrOfDoses are filled in, -3 when the doses of an 
+ *         evicted patient could not be read
+ */
+static int8_t snapshotState(const RegistrySnapshot* snapshot, Patient* live, uint32_t patientId,
+                            DoseData scratch[MAX_DOSES_PER_PATIENT], const char** patientName,
+                            const DoseData** doses, size_t* nrOfDoses)
+{
+    const VersionRecord* record = VersionLogFind(patientId, snapshot->version);
+    const VersionRecord* copy = NULL;
+
+    if (record == NULL) {
+        // Unchanged since the snapshot was opened
+        *nrOfDoses = live->doseCount;
+    }
+    else {
+        // Doses were appended since, the snapshot sees the first ones only. When doses
+        // were dropped or the patient was removed, they are in the first copy made.
+        *nrOfDoses = record->doseCount;
+        copy = VersionLogFindCopy(patientId, snapshot->version);
+    }
+    *patientName = (live != NULL) ? live->patientName : VersionLogLatest(patientId)->name;
+
+    if (copy != NULL) {
+        *doses = copy->doses;
+        if (!copy->readable) {
+            return -3;
+        }
+    }
+    else if (!loadDoses(live, scratch, doses)) {
+        return -3;
+    }
+    // Doses that were expired already when it was opened
+    retainDoses(snapshot->horizon, scratch, doses, nrOfDoses);
+    return 0;
+}
+
+// Looks for the removal of a patient by name among the removals after a snapshot
 typedef struct {
-	uint16_t dose;
-	Date date;
-} DoseData;
+    const RegistrySnapshot* snapshot;
+    const char* patientName;
+    uint32_t patientId; // 0 while not found
+} RemovalSearch;
+
+static void matchRemoval(const VersionRecord* record, void* context)
+{
+    RemovalSearch* search = context;
+
+    if (record->patientId < search->snapshot->firstHiddenId &&
+        strcmp(record->name, search->patientName) == 0) {
+        search->patientId = record->patientId;
+    }
+}
+
+int8_t OpenSnapshot(RegistrySnapshot* snapshot)
+{
+    snapshot->firstHiddenId = nextPatientId;
+    snapshot->epoch = VersionLogEpoch();
+    snapshot->horizon = retentionValue;
+    if (!VersionLogPin(snapshot->firstHiddenId, &snapshot->version)) {
+        return -2; // Allocation of memory failed
+    }
+    return 0;
+}
+
+void ReleaseSnapshot(RegistrySnapshot* snapshot)
+{
+    if (snapshot->epoch == VersionLogEpoch()) {
+        VersionLogRelease(snapshot->version, snapshot->firstHiddenId);
+    }
+}
+
+int8_t SnapshotPatientDoseInPeriod(RegistrySnapshot* snapshot,
+                                   char patientName[MAX_PATIENTNAME_SIZE],
+                                   Date* startDate, Date* endDate, uint32_t* totalDose)
+{
+    DoseData scratch[MAX_DOSES_PER_PATIENT];
+    const char* name;
+    const DoseData* doses;
+    size_t nrOfDoses;
+    int8_t result;
+
+    *totalDose = 0; // Initialize output parameter
+
+    NameKey key;
+    if (!MakeNameKey(patientName, &key)) {
+        return -2; // Name too long
+    }
+    if (snapshot->epoch != VersionLogEpoch()) {
+        return -3; // The table was emptied
+    }
 
-// Represents a patient (dynamically allocated)
+    Patient* patient = findPatient(&key);
+    if (patient != NULL && patient->patientId < snapshot->firstHiddenId) {
+        result = snapshotState(snapshot, patient, patient->patientId, scratch, &name, &doses,
+                               &nrOfDoses);
+    }
+    else {
+        // Absent or registered again after the snapshot: removed since, if it was present
+        RemovalSearch search = {snapshot, patientName, 0};
+        VersionLogForEachRemoval(snapshot->version, matchRemoval, &search);
+        if (search.patientId == 0) {
+            return -1; // Patient unknown at the time of the snapshot
+        }
+        result = snapshotState(snapshot, NULL, search.patientId, scratch, &name, &doses,
+                               &nrOfDoses);
+    }
+    if (result != 0) {
+        return result;
+    }
+
+    for (size_t i = 0; i < nrOfDoses; i++) {
+        if (isDateInRange(&doses[i].date, startDate, endDate)) {
+            *totalDose += doses[i].dose;
+        }
+    }
+    return 0; // Success
+}
+
+void GetLookupFilterStats(LookupFilterStats* stats)
+{
+    size_t negatives = lookupFilterStats.rejectedLookups + lookupFilterStats.falsePositives;
+
+    *stats = lookupFilterStats;
+    stats->falsePositiveRate = (negatives > 0) ? (double)stats->falsePositives / negatives : 0.0;
+    stats->filterBytes = CuckooFilterBytes();
+}
+
+void GetPeriodCacheStats(PeriodCacheStats* stats)
+{
+    PeriodCacheGetStats(stats);
+}
+
+// Position of a patient in name order: the id and the table entry to find it in
 typedef struct {
-	char patientName[MAX_PATIENTNAME_SIZE];
-    DoseData doses[MAX_DOSES_PER_PATIENT];
-    size_t doseCount; // Tracks used dose spots
-} Patient;
+    uint32_t patientId;
+    uint8_t hash;
+} NameOrderEntry;
 
+static int compareByName(const void* a, const void* b)
+{
+    return strcmp((*(Patient* const*)a)->patientName, (*(Patient* const*)b)->patientName);
+}
 
-// --- The Hash Table ---
-// Sprint 2: An array of POINTERS to patients.
-// Max 1 patient per entry (NULL if empty).
-static Patient* hashTable[HASHTABLE_SIZE];
+/**
+ * @brief Collects all patients sorted by name. Only ids are kept, patient records may
+ *        be replaced (encoded, evicted, ...) while the cursor is open.
+ */
+static int8_t buildNameOrder(PatientCursor* cursor)
+{
+    size_t total = 0;
+    for (int i = 0; i < HASHTABLE_SIZE; i++) {
+        for (Patient* patient = hashTable[i]; patient != NULL; patient = patient->next) {
+            total++;
+        }
+    }
 
+    Patient** patients = malloc((total > 0 ? total : 1) * sizeof(Patient*));
+    NameOrderEntry* order = malloc((total > 0 ? total : 1) * sizeof(NameOrderEntry));
+    if (patients == NULL || order == NULL) {
+        free(patients);
+        free(order);
+        return -2;
+    }
+
+    size_t n = 0;
+    for (int i = 0; i < HASHTABLE_SIZE; i++) {
+        for (Patient* patient = hashTable[i]; patient != NULL; patient = patient->next) {
+            patients[n++] = patient;
+        }
+    }
+    qsort(patients, total, sizeof(Patient*), compareByName);
+    for (size_t i = 0; i < total; i++) {
+        order[i].patientId = patients[i]->patientId;
+        order[i].hash = hashFunction(patients[i]->patientName);
+    }
+    free(patients);
+
+    cursor->nameOrder = order;
+    cursor->nrOfEntries = total;
+    return 0;
+}
 
 /**
- * @brief Calculates the hash index (0-255) for a patient name.
- * @details Sums first 5 chars (uses 255 for missing chars) and takes modulo 256.
+ * @brief Returns the next patient in table order, or NULL at the end.
  */
-static uint8_t hashFunction(char patientName[MAX_PATIENTNAME_SIZE]){
-	unsigned long sum = 0;
-    size_t len = strlen(patientName);
+static Patient* nextUnordered(PatientCursor* cursor)
+{
+    while (cursor->bucket < HASHTABLE_SIZE) {
+        Patient* patient;
+        if (cursor->layoutVersion == layoutVersion) {
+            patient = (cursor->indexInBucket == 0) ? hashTable[cursor->bucket] : (Patient*)cursor->nextPatient;
+        }
+        else {
+            // Records were added, removed or replaced since the last step: walk again
+            patient = hashTable[cursor->bucket];
+            for (size_t i = 0; i < cursor->indexInBucket && patient != NULL; i++) {
+                patient = patient->next;
+            }
+        }
 
-    for (int i = 0; i < 5; i++) {
-        if (i < len) {
-            sum += (unsigned char)patientName[i];
-        } else {
-            sum += 255; // Value for missing characters
+        if (patient == NULL) {
+            cursor->bucket++;
+            cursor->indexInBucket = 0;
+            continue;
         }
+        cursor->indexInBucket++;
+        cursor->nextPatient = patient->next;
+        cursor->layoutVersion = layoutVersion;
+        return patient;
     }
-	return (uint8_t)(sum % HASHTABLE_SIZE);
+    return NULL;
+}
+
+/**
+ * @brief Returns the next patient in name order that is still present, or NULL.
+ */
+static Patient* nextByName(PatientCursor* cursor)
+{
+    const NameOrderEntry* order = cursor->nameOrder;
+
+    while (cursor->position < cursor->nrOfEntries) {
+        const NameOrderEntry* entry = &order[cursor->position++];
+        for (Patient* patient = hashTable[entry->hash]; patient != NULL; patient = patient->next) {
+            if (patient->patientId == entry->patientId) {
+                return patient;
+            }
+        }
+        // Removed since the cursor was opened
+    }
+    return NULL;
 }
 
+// A patient of a snapshot while its name order is built
+typedef struct {
+    const char* patientName;
+    uint32_t patientId;
+} SnapshotEntry;
 
-void CreateHashTable(void)
+// Collects the patients removed after a snapshot that were present when it was opened
+typedef struct {
+    const RegistrySnapshot* snapshot;
+    SnapshotEntry* entries; // NULL while counting
+    size_t count;
+} RemovalCollector;
+
+static void collectRemoval(const VersionRecord* record, void* context)
 {
-    // Initialize all pointers in the hash table to NULL.
-	for (int i = 0; i < HASHTABLE_SIZE; i++) {
-        hashTable[i] = NULL;
+    RemovalCollector* collector = context;
+
+    if (record->patientId >= collector->snapshot->firstHiddenId) {
+        return; // Registered and removed after the snapshot
     }
+    if (collector->entries != NULL) {
+        collector->entries[collector->count] = (SnapshotEntry){record->name, record->patientId};
+    }
+    collector->count++;
 }
- 
-void RemoveAllDataFromHashTable(void)
+
+static int compareSnapshotEntries(const void* a, const void* b)
 {
-	// Loop through the table and free any allocated patient data
+    return strcmp(((const SnapshotEntry*)a)->patientName, ((const SnapshotEntry*)b)->patientName);
+}
+
+/**
+ * @brief Collects the patients of a snapshot sorted by name: the ones in the table that
+ *        were registered before it, and the copies of the ones removed since.
+ */
+static int8_t buildSnapshotOrder(PatientCursor* cursor)
+{
+    const RegistrySnapshot* snapshot = cursor->snapshot;
+    RemovalCollector collector = {snapshot, NULL, 0};
+    VersionLogForEachRemoval(snapshot->version, collectRemoval, &collector);
+
+    size_t total = collector.count;
     for (int i = 0; i < HASHTABLE_SIZE; i++) {
-        if (hashTable[i] != NULL) {
-            free(hashTable[i]);
-            hashTable[i] = NULL;
+        for (Patient* patient = hashTable[i]; patient != NULL; patient = patient->next) {
+            total += (patient->patientId < snapshot->firstHiddenId) ? 1 : 0;
         }
     }
+
+    SnapshotEntry* entries = malloc((total > 0 ? total : 1) * sizeof(SnapshotEntry));
+    NameOrderEntry* order = malloc((total > 0 ? total : 1) * sizeof(NameOrderEntry));
+    if (entries == NULL || order == NULL) {
+        free(entries);
+        free(order);
+        return -2;
+    }
+
+    collector.entries = entries;
+    collector.count = 0;
+    VersionLogForEachRemoval(snapshot->version, collectRemoval, &collector);
+    size_t n = collector.count;
+    for (int i = 0; i < HASHTABLE_SIZE; i++) {
+        for (Patient* patient = hashTable[i]; patient != NULL; patient = patient->next) {
+            if (patient->patientId < snapshot->firstHiddenId) {
+                entries[n++] = (SnapshotEntry){patient->patientName, patient->patientId};
+            }
+        }
+    }
+    qsort(entries, total, sizeof(SnapshotEntry), compareSnapshotEntries);
+    for (size_t i = 0; i < total; i++) {
+        order[i].patientId = entries[i].patientId;
+        order[i].hash = hashFunction((char*)entries[i].patientName);
+    }
+    free(entries);
+
+    cursor->nameOrder = order;
+    cursor->nrOfEntries = total;
+    return 0;
 }
- 
-int8_t AddPatient(char patientName[MAX_PATIENTNAME_SIZE])
+
+/**
+ * @brief Fills in the next patient of a snapshot cursor, as it was in the snapshot.
+ */
+static int8_t nextInSnapshot(PatientCursor* cursor, const char** patientName,
+                             const DoseData** doses, size_t* nrOfDoses)
 {
-	if (strlen(patientName) >= MAX_PATIENTNAME_SIZE) {
-        return -3; // Name too long
+    const NameOrderEntry* order = cursor->nameOrder;
+
+    if (cursor->snapshot->epoch != VersionLogEpoch()) {
+        return -3; // The table was emptied
+    }
+    if (cursor->position == cursor->nrOfEntries) {
+        return -1; // No more patients
+    }
+
+    const NameOrderEntry* entry = &order[cursor->position++];
+    Patient* live = hashTable[entry->hash];
+    while (live != NULL && live->patientId != entry->patientId) {
+        live = live->next;
     }
+    return snapshotState(cursor->snapshot, live, entry->patientId, cursor->scratch, patientName,
+                         doses, nrOfDoses);
+}
+
+// Collects the (id, table entry) pairs of postings for PatientsExposedInPeriod
+typedef struct {
+    DatePosting* postings;
+    size_t count;
+    size_t capacity;
+    bool allocationFailed;
+} PostingCollector;
 
-    uint8_t hash = hashFunction(patientName);
+static void collectPosting(const DatePosting* posting, void* context)
+{
+    PostingCollector* collector = context;
 
-    if (hashTable[hash] != NULL) {
-        // Slot is full. Check if it's the *same* patient.
-        if (strcmp(hashTable[hash]->patientName, patientName) == 0) {
-            return -1; // Patient already present
+    if (collector->count == collector->capacity) {
+        size_t capacity = (collector->capacity == 0) ? 64 : 2 * collector->capacity;
+        DatePosting* postings = realloc(collector->postings, capacity * sizeof(DatePosting));
+        if (postings == NULL) {
+            collector->allocationFailed = true;
+            return;
         }
-        // Different patient, hash collision. Slot is full for Sprint 2.
-        return -2; // Allocation failed
+        collector->postings = postings;
+        collector->capacity = capacity;
     }
+    collector->postings[collector->count++] = *posting;
+}
 
-    // Allocate memory for the new patient
-    Patient* newPatient = (Patient*)malloc(sizeof(Patient));
-    if (newPatient == NULL) {
+static int compareByPatientId(const void* a, const void* b)
+{
+    uint32_t x = ((const DatePosting*)a)->patientId;
+    uint32_t y = ((const DatePosting*)b)->patientId;
+    return (x > y) - (x < y);
+}
+
+int8_t PatientsExposedInPeriod(Date* startDate, Date* endDate,
+                               char patientNames[][MAX_PATIENTNAME_SIZE],
+                               size_t maxNrOfPatients, size_t* nrOfPatients)
+{
+    PostingCollector collector = {NULL, 0, 0, false};
+
+    *nrOfPatients = 0;
+    startDate = retainedStart(startDate);
+    DateIndexForEach(DateToDayNumber(startDate), DateToDayNumber(endDate), collectPosting, &collector);
+    if (collector.allocationFailed) {
+        free(collector.postings);
         return -2; // Allocation of memory failed
     }
 
-    // Initialize the new patient
-    strncpy(newPatient->patientName, patientName, MAX_PATIENTNAME_SIZE);
-    newPatient->doseCount = 0;
-    
-    hashTable[hash] = newPatient;
-    
+    // A patient exposed several times in the period is reported once
+    if (collector.count > 0) {
+        qsort(collector.postings, collector.count, sizeof(DatePosting), compareByPatientId);
+    }
+    for (size_t i = 0; i < collector.count; i++) {
+        const DatePosting* posting = &collector.postings[i];
+        if (i > 0 && posting->patientId == collector.postings[i - 1].patientId) {
+            continue;
+        }
+        for (Patient* patient = hashTable[posting->hash]; patient != NULL; patient = patient->next) {
+            if (patient->patientId == posting->patientId) {
+                if (*nrOfPatients < maxNrOfPatients) {
+                    strcpy(patientNames[*nrOfPatients], patient->patientName);
+                }
+                (*nrOfPatients)++;
+                break;
+            }
+        }
+    }
+
+    free(collector.postings);
     return 0; // Success
 }
- 
-int8_t RemovePatient(char patientName[MAX_PATIENTNAME_SIZE])
+
+typedef struct {
+    Patient* patient;
+    const DoseData* doses;  // NULL until an edge month needs them
+    DoseData scratch[MAX_DOSES_PER_PATIENT];
+    bool failed;            // the history of the evicted patient could not be read
+} PatientEdge;
+
+static uint64_t sumPatientEdge(uint32_t startDay, uint32_t endDay, void* context)
 {
-	if (strlen(patientName) >= MAX_PATIENTNAME_SIZE) {
-        return -2; // Name too long
+    PatientEdge* edge = context;
+    uint64_t total = 0;
+
+    if (edge->doses == NULL && !loadDoses(edge->patient, edge->scratch, &edge->doses)) {
+        edge->failed = true;
+        return 0;
     }
+    for (size_t i = 0; i < edge->patient->doseCount; i++) {
+        uint32_t day = DateToDayNumber(&edge->doses[i].date);
+        if (day >= startDay && day <= endDay) {
+            total += edge->doses[i].dose;
+        }
+    }
+    return total;
+}
 
-    uint8_t hash = hashFunction(patientName);
-    Patient* patient = hashTable[hash];
+static void addPostingDose(const DatePosting* posting, void* context)
+{
+    *(uint64_t*)context += posting->dose;
+}
 
-    if (patient != NULL && strcmp(patient->patientName, patientName) == 0) {
-        free(patient); // Free the dynamically allocated memory
-        hashTable[hash] = NULL;
-        return 0; // Success
-    }
+static uint64_t sumRegistryEdge(uint32_t startDay, uint32_t endDay, void* context)
+{
+    uint64_t total = 0;
 
-	return -1; // Patient not present
+    (void)context;
+    DateIndexForEach(startDay, endDay, addPostingDose, &total);
+    return total;
 }
- 
-int8_t IsPatientPresent(char patientName[MAX_PATIENTNAME_SIZE])
+
+int8_t PatientDoseInCalendarPeriod(char patientName[MAX_PATIENTNAME_SIZE],
+                                   Date* startDate, Date* endDate, uint32_t* totalDose)
 {
-	if (strlen(patientName) >= MAX_PATIENTNAME_SIZE) {
+    *totalDose = 0; // Initialize output parameter
+
+    NameKey key;
+    if (!MakeNameKey(patientName, &key)) {
         return -2; // Name too long
     }
 
-    uint8_t hash = hashFunction(patientName);
-    Patient* patient = hashTable[hash];
+    Patient* patient = findPatient(&key);
+    if (patient == NULL) {
+        return -1; // Patient unknown
+    }
 
-    if (patient != NULL && strcmp(patient->patientName, patientName) == 0) {
-        return 0; // Patient is present
+    // The edges are read without rehydrating, like a cursor does
+    PatientEdge edge = {patient, NULL, {{0}}, false};
+    startDate = retainedStart(startDate);
+    uint64_t total = RollupSum(patient->patientId, startDate, endDate, sumPatientEdge, &edge);
+    if (edge.failed) {
+        return -3; // Reading the cold patient back failed
     }
 
-	return -1; // Patient not present
+    *totalDose = (uint32_t)total;
+    return 0; // Success
 }
 
-/**
- * @brief Helper function to check if a date is within a given period.
- */
-static bool isDateInRange(Date* date, Date* startDate, Date* endDate)
+void RegistryDoseInCalendarPeriod(Date* startDate, Date* endDate, uint64_t* totalDose)
+{
+    startDate = retainedStart(startDate);
+    *totalDose = RollupSum(ROLLUP_REGISTRY, startDate, endDate, sumRegistryEdge, NULL);
+}
+
+int8_t OpenPatientCursor(PatientCursor* cursor, CursorOrder order)
 {
-    // Convert dates to YYYYMMDD for simple integer comparison
-    uint32_t dateVal = date->year * 10000 + date->month * 100 + date->day;
-    uint32_t startVal = startDate->year * 10000 + startDate->month * 100 + startDate->day;
-    uint32_t endVal = endDate->year * 10000 + endDate->month * 100 + endDate->day;
+    cursor->order = order;
+    cursor->bucket = 0;
+    cursor->indexInBucket = 0;
+    cursor->nextPatient = NULL;
+    cursor->layoutVersion = layoutVersion;
+    cursor->position = 0;
+    cursor->nrOfEntries = 0;
+    cursor->nameOrder = NULL;
+    cursor->snapshot = NULL;
 
-    return (dateVal >= startVal) && (dateVal <= endVal);
+    if (order == CURSOR_BY_NAME) {
+        return buildNameOrder(cursor);
+    }
+    return 0;
 }
 
-int8_t AddPatientDose(char patientName[MAX_PATIENTNAME_SIZE], 
-			          Date* date, uint16_t dose)
+int8_t OpenSnapshotCursor(PatientCursor* cursor, RegistrySnapshot* snapshot)
 {
-	if (strlen(patientName) >= MAX_PATIENTNAME_SIZE) {
-        return -3; // Name too long
+    OpenPatientCursor(cursor, CURSOR_UNORDERED);
+    cursor->order = CURSOR_BY_NAME;
+    cursor->snapshot = snapshot;
+
+    if (snapshot->epoch != VersionLogEpoch()) {
+        return -3; // The table was emptied
     }
+    return buildSnapshotOrder(cursor);
+}
 
-    uint8_t hash = hashFunction(patientName);
-    Patient* patient = hashTable[hash];
+int8_t NextPatient(PatientCursor* cursor, const char** patientName,
+                   const DoseData** doses, size_t* nrOfDoses)
+{
+    if (cursor->snapshot != NULL) {
+        return nextInSnapshot(cursor, patientName, doses, nrOfDoses);
+    }
 
-    if (patient == NULL || strcmp(patient->patientName, patientName) != 0) {
-        return -1; // Patient unknown
+    Patient* patient = (cursor->order == CURSOR_BY_NAME) ? nextByName(cursor) : nextUnordered(cursor);
+    if (patient == NULL) {
+        return -1; // No more patients
     }
+    if (!loadDoses(patient, cursor->scratch, doses)) {
+        return -3; // Reading the cold patient failed
+    }
+    *patientName = patient->patientName;
+    *nrOfDoses = patient->doseCount;
+    if (compactionPending) {
+        // The cursor does not compact, it only leaves the expired doses out
+        retainDoses(retentionValue, cursor->scratch, doses, nrOfDoses);
+    }
+    return 0;
+}
 
-    if (patient->doseCount >= MAX_DOSES_PER_PATIENT) {
-        return -2; // Dose array is full
+void ClosePatientCursor(PatientCursor* cursor)
+{
+    free(cursor->nameOrder);
+    cursor->nameOrder = NULL;
+    cursor->nrOfEntries = 0;
+}
+
+int8_t WriteToFile(char filePath[MAX_FILEPATH_LEGTH])
+{
+    PatientCursor cursor;
+    const char* name;
+    const DoseData* doses;
+    size_t nrOfDoses;
+    int8_t result;
+
+    FILE* file = fopen(filePath, "w");
+    if (file == NULL) {
+        return -1;
     }
+    OpenPatientCursor(&cursor, CURSOR_UNORDERED);
 
-    // Add the dose
-    patient->doses[patient->doseCount].date = *date;
-    patient->doses[patient->doseCount].dose = dose;
-    patient->doseCount++;
+    // One line per patient: name, then a tab separated "dd-mm-yyyy dose" per dose,
+    // followed by " examType" when the examination type is known
+    while ((result = NextPatient(&cursor, &name, &doses, &nrOfDoses)) == 0) {
+        fputs(name, file);
+        for (size_t i = 0; i < nrOfDoses; i++) {
+            fprintf(file, "\t%02u-%02u-%04u %u", doses[i].date.day, doses[i].date.month,
+                    doses[i].date.year, doses[i].dose);
+            if (doses[i].examType != EXAM_TYPE_NONE) {
+                fprintf(file, " %u", doses[i].examType);
+            }
+        }
+        fputc('\n', file);
+    }
+    ClosePatientCursor(&cursor);
 
-	return 0; // Success
+    if (fclose(file) != 0 || result != -1) {
+        return -1;
+    }
+	return 0;
 }
- 
-int8_t PatientDoseInPeriod(char patientName[MAX_PATIENTNAME_SIZE], 
-                           Date* startDate, Date* endDate, uint32_t* totalDose)
+
+/**
+ * @brief Adds a parsed patient with its doses, looking the patient up only once.
+ * @return 0 on success, otherwise the failure value of ReadFromFile
+ */
+static int8_t insertLoadedPatient(LoadedPatient* loaded)
 {
-    *totalDose = 0; // Initialize output parameter
+    char* name = (char*)loaded->patientName;
+    NameKey key;
 
-	if (strlen(patientName) >= MAX_PATIENTNAME_SIZE) {
-        return -2; // Name too long
+    if (!MakeNameKey(name, &key)) {
+        return -1; // Name too long, the parser rejects these as malformed already
     }
+    int8_t result = AddPatient(name);
+    if (result == -1) {
+        return -3; // Listed twice
+    }
+    if (result != 0) {
+        return result; // Allocation of memory failed, or the shared segment is full
+    }
+    Patient** link = findPatientLink(&key);
+    for (size_t i = 0; i < loaded->nrOfDoses && result == 0; i++) {
+        DoseData* dose = &loaded->doses[i];
+        if (appendDose(link, key.bucket, key.hash, &dose->date, dose->dose,
+                       (EXAMINATION_TYPES)dose->examType) != 0) {
+            // The parser allows no more doses than fit and the table has no horizon yet
+            result = -2; // Allocation of memory failed
+        }
+    }
+    enforceMemoryBudget();
+    return result;
+}
 
-    uint8_t hash = hashFunction(patientName);
-    Patient* patient = hashTable[hash];
+int8_t ReadFromFile(char filePath[MAX_FILEPATH_LEGTH])
+{
+    LoadedPartition partitions[MAX_LOADER_THREADS];
+    size_t nrOfPartitions = 0;
 
-    if (patient == NULL || strcmp(patient->patientName, patientName) != 0) {
-        return -1; // Patient unknown
+    FILE* file = fopen(filePath, "rb");
+    if (file == NULL) {
+        return -1;
     }
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        size = ftell(file);
+        rewind(file);
+    }
+    // One byte extra, the parser terminates the last name in place
+    char* text = (size >= 0) ? malloc((size_t)size + 1) : NULL;
+    if (text == NULL || fread(text, 1, (size_t)size, file) != (size_t)size) {
+        free(text);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
 
-    // Iterate through the patient's doses
-    for (size_t i = 0; i < patient->doseCount; i++) {
-        if (isDateInRange(&patient->doses[i].date, startDate, endDate)) {
-            *totalDose += patient->doses[i].dose;
+    // Parse on all processors first, the table is only touched when the whole file is valid
+    int8_t result = -1;
+    if (ParseRegistryText(text, (size_t)size, ThreadPoolParallelism(), partitions, &nrOfPartitions)) {
+        RemoveAllDataFromHashTable();
+        result = 0;
+        for (size_t i = 0; i < nrOfPartitions && result == 0; i++) {
+            for (size_t j = 0; j < partitions[i].count && result == 0; j++) {
+                result = insertLoadedPatient(&partitions[i].patients[j]);
+            }
+        }
+        if (result != 0) {
+            RemoveAllDataFromHashTable(); // No half loaded registry
         }
     }
-	 
-	return 0; // Success
+
+    FreeLoadedPartitions(partitions, nrOfPartitions);
+    free(text);
+    return result;
 }
 
-int8_t GetNumberOfMeasurements(char patientName[MAX_PATIENTNAME_SIZE], 
-                               size_t * nrOfMeasurements)
+int8_t WriteArchive(char filePath[MAX_FILEPATH_LEGTH])
 {
-	if (strlen(patientName) >= MAX_PATIENTNAME_SIZE) {
-        return -2; // Name too long
+    PatientCursor cursor;
+    ArchiveWriter writer;
+    const char* name;
+    const DoseData* doses;
+    size_t nrOfDoses;
+    int8_t result;
+
+    // The archive is searched by name, so it is written in name order
+    if (OpenPatientCursor(&cursor, CURSOR_BY_NAME) != 0) {
+        return -2;
+    }
+    if (!ArchiveWriterOpen(&writer, filePath)) {
+        ClosePatientCursor(&cursor);
+        return -1;
     }
+    while ((result = NextPatient(&cursor, &name, &doses, &nrOfDoses)) == 0) {
+        ArchiveWriterAdd(&writer, name, doses, nrOfDoses);
+    }
+    ClosePatientCursor(&cursor);
 
-    uint8_t hash = hashFunction(patientName);
-    Patient* patient = hashTable[hash];
+    if (!ArchiveWriterClose(&writer) || result != -1) {
+        return -1;
+    }
+    return 0;
+}
 
-    if (patient == NULL || strcmp(patient->patientName, patientName) != 0) {
-        return -1; // Patient not present
+int8_t OpenArchive(char filePath[MAX_FILEPATH_LEGTH], PatientArchive* archive)
+{
+    return ArchiveOpen(filePath, archive);
+}
+
+void CloseArchive(PatientArchive* archive)
+{
+    ArchiveClose(archive);
+}
+
+int8_t ArchivePatientDoses(PatientArchive* archive, char patientName[MAX_PATIENTNAME_SIZE],
+                           DoseData doses[MAX_DOSES_PER_PATIENT], size_t* nrOfDoses)
+{
+    NameKey key;
+
+    *nrOfDoses = 0;
+	if (!MakeNameKey(patientName, &key)) {
+        return -2; // Name too long
     }
+    return ArchiveFind(archive, patientName, doses, nrOfDoses);
+}
 
-    *nrOfMeasurements = patient->doseCount;
-	return 0; // Success
+int8_t ArchiveIsPatientPresent(PatientArchive* archive, char patientName[MAX_PATIENTNAME_SIZE])
+{
+    DoseData doses[MAX_DOSES_PER_PATIENT];
+    size_t nrOfDoses;
+
+    return ArchivePatientDoses(archive, patientName, doses, &nrOfDoses);
 }
 
-void GetHashPerformance(size_t *totalNumberOfPatients, double *averageNumberOfPatients,
-                        double *standardDeviation)
+int8_t ArchivePatientDoseInPeriod(PatientArchive* archive, char patientName[MAX_PATIENTNAME_SIZE],
+                                  Date* startDate, Date* endDate, uint32_t* totalDose)
 {
-    size_t totalPatients = 0;
-    double sumOfSquares = 0.0; // Sum of (entries_in_slot)^2
+    DoseData doses[MAX_DOSES_PER_PATIENT];
+    size_t nrOfDoses;
 
-    for (int i = 0; i < HASHTABLE_SIZE; i++) {
-        if (hashTable[i] != NULL) {
-            totalPatients++;
-            sumOfSquares += 1.0; // (1 patient)^2 is 1
+    *totalDose = 0;
+    int8_t result = ArchivePatientDoses(archive, patientName, doses, &nrOfDoses);
+    for (size_t i = 0; i < nrOfDoses; i++) {
+        if (isDateInRange(&doses[i].date, startDate, endDate)) {
+            *totalDose += doses[i].dose;
         }
     }
+    return result;
+}
 
-    *totalNumberOfPatients = totalPatients;
-    *averageNumberOfPatients = (double)totalPatients / HASHTABLE_SIZE;
+// Patient of the previous CSV row, valid for layoutVersion
+typedef struct {
+    char      patientName[MAX_PATIENTNAME_SIZE];
+    Patient** link;
+    uint32_t  layoutVersion;
+    uint8_t   bucket;    // of the NameKey of patientName
+    uint64_t  nameHash;
+} ImportCache;
 
-    // Calculate variance and standard deviation
-    double meanOfSquares = sumOfSquares / HASHTABLE_SIZE;
-    double variance = meanOfSquares - (*averageNumberOfPatients * *averageNumberOfPatients);
-    *standardDeviation = sqrt(variance);
+/**
+ * @brief Adds the dose of a CSV row, adding the patient when it is not present.
+ * @return the values of AddPatientExamDose, except -1
+ */
+static int8_t importRow(const CsvRow* row, ImportCache* cache, CsvImportStats* stats)
+{
+    Patient** link = cache->link;
+
+    if (link == NULL || cache->layoutVersion != layoutVersion ||
+        strcmp(cache->patientName, row->patientName) != 0) {
+        NameKey key;
+        if (!MakeNameKey(row->patientName, &key)) {
+            return -3; // Name too long
+        }
+        link = findPatientLink(&key);
+        if (link == NULL) {
+            int8_t result = AddPatient(row->patientName);
+            if (result != 0) {
+                return result;
+            }
+            stats->addedPatients++;
+            link = findPatientLink(&key);
+        }
+        memcpy(cache->patientName, row->patientName, row->nameLength + 1);
+        cache->bucket = key.bucket;
+        cache->nameHash = key.hash;
+    }
+
+    DoseData dose = row->dose;
+    int8_t result = appendDose(link, cache->bucket, cache->nameHash, &dose.date, dose.dose,
+                               (EXAMINATION_TYPES)dose.examType);
+    // Replacing the patient changes *link, not where link points
+    cache->link = link;
+    cache->layoutVersion = layoutVersion;
+    enforceMemoryBudget(); // Compacting changes the layout version when it moves records
+    return result;
 }
-				
-int8_t WriteToFile(char filePath[MAX_FILEPATH_LEGTH])
+
+int8_t ImportCsvFile(char filePath[MAX_FILEPATH_LEGTH], CsvImportStats* stats,
+                     CsvRowError errors[], size_t maxNrOfErrors)
 {
-     (void)filePath; // Not implemented in Sprint 2
-	 return -1;
+    CsvReader reader;
+    CsvRow row;
+    CsvResult read;
+    ImportCache cache = {"", NULL, 0, 0, 0};
+
+    *stats = (CsvImportStats){0};
+    int8_t result = CsvReaderOpen(&reader, filePath);
+    if (result != 0) {
+        return result;
+    }
+
+    while ((read = CsvReaderNext(&reader, &row)) != CSV_END) {
+        int8_t rowResult = (read == CSV_ROW) ? importRow(&row, &cache, stats) : -1;
+        stats->rows++;
+        if (rowResult == 0) {
+            stats->importedRows++;
+            continue;
+        }
+        if (stats->failedRows < maxNrOfErrors) {
+            errors[stats->failedRows] = (CsvRowError){row.line, rowResult};
+        }
+        stats->failedRows++;
+    }
+
+    return CsvReaderClose(&reader) ? 0 : -1;
 }
 
-int8_t ReadFromFile(char filePath[MAX_FILEPATH_LEGTH])
+// Files of ExportColumns, the names come last
+enum { COLUMN_PATIENT, COLUMN_DAY, COLUMN_DOSE, COLUMN_EXAM_TYPE, COLUMN_NAMES, NR_OF_COLUMNS };
+
+int8_t ExportColumns(char filePrefix[MAX_FILEPATH_LEGTH])
 {
-	 (void)filePath; // Not implemented in Sprint 2
-	 return -1;
+    static const struct {
+        const char* suffix;
+        const char* descr;
+        size_t      itemSize;
+    } columns[NR_OF_COLUMNS] = {
+        {"patient.npy",  "<u4", sizeof(uint32_t)},
+        {"day.npy",      "<u4", sizeof(uint32_t)},
+        {"dose.npy",     "<u2", sizeof(uint16_t)},
+        {"examType.npy", "|u1", sizeof(uint8_t)},
+        {"names.npy",    "|S79", MAX_PATIENTNAME_SIZE - 1}, // Without the terminator
+    };
+    char filePath[MAX_FILEPATH_LEGTH + 16];
+    PatientCursor cursor;
+    const char* name;
+    const DoseData* doses;
+    size_t nrOfDoses;
+    int8_t result = 0;
+
+    NpyWriter* writers = malloc(NR_OF_COLUMNS * sizeof(NpyWriter));
+    if (writers == NULL) {
+        return -2;
+    }
+    size_t opened = 0;
+    while (opened < NR_OF_COLUMNS) {
+        snprintf(filePath, sizeof(filePath), "%s%s", filePrefix, columns[opened].suffix);
+        if (!NpyWriterOpen(&writers[opened], filePath, columns[opened].descr,
+                           columns[opened].itemSize)) {
+            result = -1;
+            break;
+        }
+        opened++;
+    }
+
+    if (result == 0) {
+        uint32_t row = 0;
+        OpenPatientCursor(&cursor, CURSOR_UNORDERED);
+        while ((result = NextPatient(&cursor, &name, &doses, &nrOfDoses)) == 0) {
+            char item[MAX_PATIENTNAME_SIZE];
+            // Zero padded, the names of the table always fit
+            memset(item, 0, sizeof(item));
+            memcpy(item, name, strlen(name));
+            NpyWriterAppendBytes(&writers[COLUMN_NAMES], item);
+            for (size_t i = 0; i < nrOfDoses; i++) {
+                NpyWriterAppend(&writers[COLUMN_PATIENT], row);
+                NpyWriterAppend(&writers[COLUMN_DAY], DateToDayNumber(&doses[i].date));
+                NpyWriterAppend(&writers[COLUMN_DOSE], doses[i].dose);
+                NpyWriterAppend(&writers[COLUMN_EXAM_TYPE], doses[i].examType);
+            }
+            row++;
+        }
+        ClosePatientCursor(&cursor);
+        result = (result == -1) ? 0 : -1;
+    }
+
+    for (size_t i = 0; i < opened; i++) {
+        if (!NpyWriterClose(&writers[i])) {
+            result = -1;
+        }
+    }
+    free(writers);
+    return result;
 }
@@ -2,10 +2,13 @@
 #define DOSEADMIN_H
 #include <stdint.h>
 #include <stddef.h>
+#include "Protocol_PatientAdmin_CentralAcq.h"
 
 
 #define MAX_PATIENTNAME_SIZE	(80)
 #define HASHTABLE_SIZE			(256)
+#define MAX_DOSES_PER_PATIENT	(10) // Sprint 2: Still a fixed array of 10
+#define NR_OF_EXAM_TYPES		(EXAM_TYPE_NONE + 1)
 
 
 /*************************************************************************************** 
@@ -41,6 +44,13 @@ typedef struct {
 	uint16_t  year;   // value in range [1900, 2500]
 } Date;
 
+// Represents a single dose measurement
+typedef struct {
+	uint16_t dose;
+	Date date;
+	uint8_t examType; // EXAMINATION_TYPES, EXAM_TYPE_NONE when added without a type
+} DoseData;
+
 /***************************************************************************************
  * Adds the dose a patient received during an examination at a particular date in 
  * the hash table
@@ -48,6 +58,9 @@ typedef struct {
  * Returns -1 when the passed patientName is unknown
  * Returns -2 when allocation of memory failed
  * Returns -3 when string length of patientName exceeds MAX_PATIENTNAME_SIZE
+ * Returns -4 when date is before the retention horizon (see PurgeDosesBefore)
+ * Returns -5 when date is not a valid calendar date in range [1900, 2500]
+ * Returns -6 when examType is not a valid EXAMINATION_TYPES value (AddPatientExamDose)
  * Returns  0 when the data is successfully copied into the hash table
  * 
  * It is a precondition that patientName is not NULL and is \0 terminated
@@ -58,11 +71,22 @@ int8_t AddPatientDose(char patientName[MAX_PATIENTNAME_SIZE], Date* date,
                       uint16_t dose);
 
 
+/***************************************************************************************
+ * Adds a dose like AddPatientDose, recording the type of the examination with it. 
+ * AddPatientDose records EXAM_TYPE_NONE.
+ * 
+ * Returns the same values as AddPatientDose
+ */
+int8_t AddPatientExamDose(char patientName[MAX_PATIENTNAME_SIZE], Date* date, 
+                          uint16_t dose, EXAMINATION_TYPES examType);
+
+
 /***************************************************************************************
  * Returns the total dose a patient received in passed period.
  * 
  * Returns -1 when the passed patientName is unknown
  * Returns -2 when string length of patientName exceeds MAX_PATIENTNAME_SIZE
+ * Returns -3 when the patient was evicted and could not be read back from disk
  * Returns  0 when the totalDose is  updated successfully
  * 
  * It is a precondition that patientName is not NULL and is \0 terminated
@@ -72,11 +96,187 @@ int8_t PatientDoseInPeriod(char patientName[MAX_PATIENTNAME_SIZE],
                            Date* startDate, Date* endDate, uint32_t* totalDose);
 
 
+/***************************************************************************************
+ * Returns the total dose a patient received in passed period in examinations of the 
+ * passed type only.
+ * 
+ * Returns the same values as PatientDoseInPeriod
+ */
+int8_t PatientExamDoseInPeriod(char patientName[MAX_PATIENTNAME_SIZE], EXAMINATION_TYPES examType,
+                               Date* startDate, Date* endDate, uint32_t* totalDose);
+
+
+/***************************************************************************************
+ * Returns the all-time total dose of a patient per examination type, indexed by 
+ * EXAMINATION_TYPES. The totals are maintained on every AddPatientDose, so this call 
+ * does not read the dose history.
+ * 
+ * Returns -1 when the passed patientName is unknown
+ * Returns -2 when string length of patientName exceeds MAX_PATIENTNAME_SIZE
+ * Returns  0 when totalDose is filled
+ */
+int8_t GetPatientDosePerExamType(char patientName[MAX_PATIENTNAME_SIZE],
+                                 uint32_t totalDose[NR_OF_EXAM_TYPES]);
+
+
+/***************************************************************************************
+ * Returns the total dose of all patients in the registry per examination type, 
+ * indexed by EXAMINATION_TYPES
+ */
+void GetRegistryDosePerExamType(uint64_t totalDose[NR_OF_EXAM_TYPES]);
+
+
+/***************************************************************************************
+ * Returns dose percentiles of one examination type over all patients, for dose 
+ * reference level audits. quantiles[i] (e.g. 0.5, 0.75, 0.95) is answered in doses[i].
+ * 
+ * A dose distribution is maintained per examination type and calendar month, the 
+ * months from startDate up to and including the month of endDate are merged. Each 
+ * returned dose is within 1% of a dose that was actually recorded at that rank.
+ * 
+ * Returns -1 when no doses of examType were recorded in those months
+ * Returns -2 when examType is not a valid EXAMINATION_TYPES value or a quantile is not
+ *            in [0, 1]
+ * Returns  0 when doses is filled
+ * 
+ * It is a precondition that both dates are not NULL
+ */
+int8_t ExamDoseQuantiles(EXAMINATION_TYPES examType, Date* startDate, Date* endDate,
+                         const double quantiles[], size_t nrOfQuantiles, uint16_t doses[]);
+
+
+#define MAX_DOSE_WINDOWS      (4)
+#define DOSE_ALERT_QUEUE_SIZE (16)
+
+typedef struct {
+	uint16_t days;       // the window covers the newest dose day and the days before it
+	uint32_t threshold;  // cumulative dose in the window that raises an alert
+} DoseWindow;
+
+typedef struct {
+	char       patientName[MAX_PATIENTNAME_SIZE];
+	Date       date;            // date of the dose that crossed the threshold
+	DoseWindow window;
+	uint32_t   cumulativeDose;  // dose in the window, including that dose
+} DoseAlert;
+
+/***************************************************************************************
+ * Sets the rolling windows in which the cumulative dose of every patient is watched, 
+ * replacing the previous ones. Pass 0 windows to stop watching.
+ * 
+ * The dose in each window is kept per patient and updated by AddPatientDose at a 
+ * constant cost per dose. When a dose brings the cumulative dose of a window from 
+ * below its threshold to at least its threshold, an alert is queued for PollDoseAlert.
+ * A window ends at the newest dose of the patient, so an older dose arriving late is 
+ * counted only in the windows that still cover its date.
+ * 
+ * Returns -1 when more than MAX_DOSE_WINDOWS windows are passed or a window has 0 days
+ * Returns  0 on success
+ */
+int8_t SetDoseWindows(const DoseWindow windows[], size_t nrOfWindows);
+
+
+/***************************************************************************************
+ * Takes the oldest queued alert. At most DOSE_ALERT_QUEUE_SIZE alerts are queued; 
+ * when more are raised before they are polled, the oldest ones are dropped.
+ * 
+ * Returns -1 when no alert is queued
+ * Returns  0 when alert is filled
+ */
+int8_t PollDoseAlert(DoseAlert* alert);
+
+
+typedef struct {
+	size_t hits;           // PatientDoseInPeriod calls answered from the cache
+	size_t misses;         // calls that had to walk the dose history
+	size_t invalidations;  // cached windows dropped because a dose was added inside them
+} PeriodCacheStats;
+
+/***************************************************************************************
+ * Returns the counters of the PatientDoseInPeriod cache. 
+ * 
+ * Results are cached per patient and period; a cached period is only dropped when 
+ * AddPatientDose adds a dose inside it, or when the patient is removed.
+ */
+void GetPeriodCacheStats(PeriodCacheStats* stats);
+
+
+typedef struct {
+	size_t rejectedLookups;    // lookups of absent names answered by the filter alone
+	size_t falsePositives;     // lookups of absent names the filter let through
+	double falsePositiveRate;  // falsePositives / all lookups of absent names
+	size_t rebuilds;           // times the filter was full and refilled at twice the size
+	size_t filterBytes;
+} LookupFilterStats;
+
+/***************************************************************************************
+ * Returns the counters of the filter that every lookup by name passes first. 
+ * 
+ * The filter is a cuckoo filter of 16-bit fingerprints of the names in the table; 
+ * AddPatient adds to it and RemovePatient removes from it. It never rejects a present
+ * name and lets at most about 1 in 8000 absent names through to the table.
+ */
+void GetLookupFilterStats(LookupFilterStats* stats);
+
+
+/***************************************************************************************
+ * Returns the patients that received a dose between startDate and endDate (inclusive).
+ * Uses an index of exposure dates, so the cost is proportional to the number of doses 
+ * in the period rather than to the size of the registry.
+ * 
+ * Up to maxNrOfPatients names are copied to patientNames, each patient once. 
+ * nrOfPatients is set to the total number of such patients, which can be larger.
+ * 
+ * Returns -2 when allocation of memory failed
+ * Returns  0 on success
+ * 
+ * It is a precondition that both dates are not NULL and are valid calendar dates
+ */
+int8_t PatientsExposedInPeriod(Date* startDate, Date* endDate,
+                               char patientNames[][MAX_PATIENTNAME_SIZE],
+                               size_t maxNrOfPatients, size_t* nrOfPatients);
+
+
+/***************************************************************************************
+ * Returns the total dose a patient received in passed period, like PatientDoseInPeriod, 
+ * for reports by calendar month or year.
+ * 
+ * Monthly and yearly totals are maintained on every AddPatientDose, so whole months 
+ * and years of the period are read from those totals. Only the doses in a partially 
+ * covered first or last month are summed individually; a period of whole months does 
+ * not need the dose history, not even of an evicted patient.
+ * 
+ * Returns -1 when the passed patientName is unknown
+ * Returns -2 when string length of patientName exceeds MAX_PATIENTNAME_SIZE
+ * Returns -3 when the patient was evicted and could not be read back from disk
+ * Returns  0 when the totalDose is updated successfully
+ * 
+ * It is a precondition that patientName is not NULL and is \0 terminated
+ * It is also a precondition that both dates and totalDose are not NULL and are valid 
+ * calendar dates
+ */
+int8_t PatientDoseInCalendarPeriod(char patientName[MAX_PATIENTNAME_SIZE],
+                                   Date* startDate, Date* endDate, uint32_t* totalDose);
+
+
+/***************************************************************************************
+ * Returns the total dose of all patients in the registry in passed period, using the
+ * monthly and yearly totals. Doses in a partially covered first or last month are 
+ * found through the index of exposure dates.
+ * 
+ * It is a precondition that both dates and totalDose are not NULL and are valid 
+ * calendar dates
+ */
+void RegistryDoseInCalendarPeriod(Date* startDate, Date* endDate, uint64_t* totalDose);
+
+
 /***************************************************************************************
  * Removes the patient from the hash table
  * 
  * Returns -1 when the passed patientName is not present 
  * Returns -2 when string length of patientName exceeds MAX_PATIENTNAME_SIZE
+ * Returns -3 when an open snapshot needs a copy of the patient and allocation of 
+ *            memory for it failed, the patient is not removed
  * Returns  0 when the patient data is successfully removed from the hash table
  * 
  * It is a precondition that patientName is not NULL and is \0 terminated
@@ -84,6 +284,31 @@ int8_t PatientDoseInPeriod(char patientName[MAX_PATIENTNAME_SIZE],
 int8_t RemovePatient(char patientName[MAX_PATIENTNAME_SIZE]);
 
 
+/***************************************************************************************
+ * Removes many patients in one call, e.g. when a department is closed. Names that are
+ * too long or not present are skipped. The patients are gone from the table and all 
+ * queries right away; their records are only freed by ReclaimRemovedPatients, so the
+ * removal itself does not wait for the allocator. Until then they count in 
+ * GetMemoryUsage.
+ * 
+ * nrOfRemoved is set to the number of patients removed
+ * 
+ * Returns -3 when an open snapshot needs a copy of a patient and allocation of memory 
+ *            for it failed, that patient is not removed
+ * Returns  0 otherwise
+ */
+int8_t RemovePatients(char patientNames[][MAX_PATIENTNAME_SIZE], size_t nrOfPatients,
+                      size_t* nrOfRemoved);
+
+
+/***************************************************************************************
+ * Frees the records of the patients removed by RemovePatients
+ * 
+ * Returns the number of records freed
+ */
+size_t ReclaimRemovedPatients(void);
+
+
 /***************************************************************************************
  * Checks if the passed patientName is present in the hash table
  * 
@@ -96,6 +321,25 @@ int8_t RemovePatient(char patientName[MAX_PATIENTNAME_SIZE]);
 int8_t IsPatientPresent(char patientName[MAX_PATIENTNAME_SIZE]);
 
 
+/***************************************************************************************
+ * Searches the patients whose name starts with prefix, e.g. while an operator types.
+ * The names are kept sorted in an index that AddPatient and RemovePatient update, so 
+ * the cost depends on the number of matches returned, not on the size of the registry.
+ * 
+ * The first maxNrOfPatients matching names in alphabetical order are copied to 
+ * patientNames; nrOfPatients is set to the number of names copied. An empty prefix 
+ * matches all patients.
+ * 
+ * Returns -2 when string length of prefix exceeds MAX_PATIENTNAME_SIZE
+ * Returns  0 on success
+ * 
+ * It is a precondition that prefix is not NULL and is \0 terminated
+ */
+int8_t FindPatientsByPrefix(char prefix[MAX_PATIENTNAME_SIZE],
+                            char patientNames[][MAX_PATIENTNAME_SIZE],
+                            size_t maxNrOfPatients, size_t* nrOfPatients);
+
+
 /***************************************************************************************
  * Returns the number of dose measurements done for a given patient
  *
@@ -109,6 +353,47 @@ int8_t GetNumberOfMeasurements(char patientName[MAX_PATIENTNAME_SIZE],
                                size_t * nrOfMeasurements);
 
 
+/***************************************************************************************
+ * Adds a patient like AddPatient, together with the number other systems know the 
+ * patient by (e.g. a medical record number). Afterwards the patient can be addressed by
+ * name and by number. The ...ByNumber functions look the number up in an integer hash 
+ * table, without hashing or comparing the name.
+ * 
+ * Returns -1 when the passed patientName or patientNumber is already present, or 
+ *            patientNumber is 0
+ * Returns -2 when allocation of memory failed
+ * Returns -3 when string length of patientName exceeds MAX_PATIENTNAME_SIZE
+ * Returns  0 when the patient is successfully added
+ * 
+ * It is a precondition that patientName is not NULL and is \0 terminated
+ */
+int8_t AddPatientWithNumber(char patientName[MAX_PATIENTNAME_SIZE], uint64_t patientNumber);
+
+
+/***************************************************************************************
+ * Same as IsPatientPresent, AddPatientDose, AddPatientExamDose, PatientDoseInPeriod, 
+ * GetNumberOfMeasurements and RemovePatient, for a patient added with 
+ * AddPatientWithNumber. They return the same values, except that there is no name that
+ * can be too long.
+ * 
+ * A patient removed by name loses its number as well, RemoveAllDataFromHashTable and
+ * ReadFromFile drop all numbers.
+ */
+int8_t IsPatientNumberPresent(uint64_t patientNumber);
+
+int8_t AddPatientDoseByNumber(uint64_t patientNumber, Date* date, uint16_t dose);
+
+int8_t AddPatientExamDoseByNumber(uint64_t patientNumber, Date* date, uint16_t dose,
+                                  EXAMINATION_TYPES examType);
+
+int8_t PatientDoseInPeriodByNumber(uint64_t patientNumber, Date* startDate, Date* endDate,
+                                   uint32_t* totalDose);
+
+int8_t GetNumberOfMeasurementsByNumber(uint64_t patientNumber, size_t* nrOfMeasurements);
+
+int8_t RemovePatientByNumber(uint64_t patientNumber);
+
+
 /***************************************************************************************
  * Returns the total number of patients in the table, the average number of patients in 
  * a table entry and standard deviation of an table entry. 
@@ -118,27 +403,531 @@ int8_t GetNumberOfMeasurements(char patientName[MAX_PATIENTNAME_SIZE],
  */
 void GetHashPerformance(size_t *totalNumberOfPatients, double *averageNumberOfPatients,
                         double *standardDeviation);
+
+
+/***************************************************************************************
+ * Sets the number of threads for the passes over the whole table. EncodeInactivePatients,
+ * EvictInactivePatients and CompactExpiredPatients look for the patients to change on
+ * all threads, per range of table entries, and change them on the calling thread. 
+ * GetHashPerformance counts and ReadFromFile parses on all threads. Small tables are 
+ * always done on the calling thread.
+ * 
+ * nrOfThreads: the number of threads, the calling one included. 0 (the default) uses
+ *              one per processor, 1 does every pass on the calling thread only
+ */
+void SetMaintenanceThreads(size_t nrOfThreads);
+
+
+
+typedef struct {
+	size_t recordBytes;  // patient records and names
+	size_t doseBytes;    // dose storage, including reserved but unused dose slots
+	size_t indexBytes;   // hash table entries and chain links
+	size_t slackBytes;   // estimated allocator overhead (chunk headers and rounding)
+	size_t totalBytes;   // sum of all of the above
+} MemoryUsage;
+
+/***************************************************************************************
+ * Returns the memory used by the hash table and all patient data, split per category.
+ * The figures are maintained on every change, so this call does not walk the table.
+ * 
+ */
+void GetMemoryUsage(MemoryUsage* usage);
+
+
+/***************************************************************************************
+ * Sets the memory budget in bytes for the whole registry. Pass 0 for no budget.
+ * 
+ * Patients normally reserve a full name buffer and room for all their doses. Once the
+ * total of GetMemoryUsage exceeds the budget, patients are converted to a compact 
+ * representation (exact-length name, exact-size dose array) after adding patients or
+ * doses. New patients, and encoded patients that get a dose again, are created compact
+ * when an expanded record would not fit. The behaviour of all other functions does not
+ * change.
+ */
+void SetMemoryBudget(size_t budgetBytes);
+
+
+/***************************************************************************************
+ * Re-encodes the dose history of every patient whose most recent dose is at least 
+ * idleDays before today (and of patients without any dose). The history is stored as
+ * varint day number deltas and varint doses behind the exact-length name, in a single
+ * allocation, typically a quarter of the expanded size.
+ * 
+ * PatientDoseInPeriod and GetNumberOfMeasurements work directly on the encoded form.
+ * The next AddPatientDose for such a patient expands the history again.
+ * 
+ * Returns the number of patients that were encoded by this call
+ * 
+ * It is a precondition that today is not NULL and that all dates are valid calendar dates
+ */
+size_t EncodeInactivePatients(Date* today, uint16_t idleDays);
+
+
+/***************************************************************************************
+ * Purges all doses before horizon, for the retention period of dose records. The 
+ * registry wide indexes keep their doses per calendar month, whole months before the 
+ * horizon are dropped at once. The patients are compacted lazily: a patient loses its
+ * expired doses the next time it is used, or when CompactExpiredPatients reaches it.
+ * Queries never see expired doses, except GetRegistryDosePerExamType and, for the month
+ * of the horizon, ExamDoseQuantiles: they still count them for the patients that were
+ * not compacted yet.
+ * 
+ * The horizon only moves forward, an earlier horizon is ignored. It stays in effect 
+ * until RemoveAllDataFromHashTable. Doses before it can not be added anymore.
+ * 
+ * Returns -1 when horizon is not a valid calendar date in range [1900, 2500], nothing
+ *            is purged
+ * Returns  0 otherwise
+ * 
+ * It is a precondition that horizon is not NULL
+ */
+int8_t PurgeDosesBefore(Date* horizon);
+
+
+/***************************************************************************************
+ * Compacts the patients of the next table entries, until at least maxNrOfPatients 
+ * patients were looked at, so the work after PurgeDosesBefore can be spread in time.
+ * Once every patient was looked at, the other functions stop checking for expired doses.
+ * 
+ * Returns the number of patients that lost doses by this call
+ */
+size_t CompactExpiredPatients(size_t maxNrOfPatients);
+
+
+typedef enum {
+	CHANGE_ADD_PATIENT,
+	CHANGE_ADD_DOSE,
+	CHANGE_REMOVE_PATIENT,
+	CHANGE_PURGE_DOSES,
+	CHANGE_REMOVE_ALL
+} ChangeType;
+
+// A change as decoded by ReadPatientChange
+typedef struct {
+	uint8_t  type;                              // ChangeType
+	char     patientName[MAX_PATIENTNAME_SIZE]; // empty for purges and remove all
+	DoseData dose;                              // added dose; for a purge date is the horizon
+} PatientChange;
+
+#define MAX_CHANGE_SIZE (96) // bytes of the largest change in an export
+
+/***************************************************************************************
+ * Starts logging the changes to the registry, so other systems can follow it with
+ * ExportChangesSince instead of reading it all. Every patient or dose added, patient
+ * removed, purge and RemoveAllDataFromHashTable gets the next sequence number.
+ * Compaction, encoding and eviction change nothing a follower sees and are not logged.
+ *
+ * Changes made before the log was enabled are not in it: a follower starts from a full
+ * copy taken after GetChangeSequence.
+ */
+void EnableChangeFeed(void);
+
+
+/***************************************************************************************
+ * Stops logging and frees the log
+ */
+void DisableChangeFeed(void);
+
+
+/***************************************************************************************
+ * Returns the sequence number of the newest change
+ */
+uint64_t GetChangeSequence(void);
+
+
+/***************************************************************************************
+ * Copies the changes after sequence to buffer, oldest first, as long as they fit. The
+ * cost depends on the number of changes copied, not on the size of the registry or of
+ * the log. Decode them with ReadPatientChange.
+ *
+ * nrOfBytes is set to the bytes written, lastSequence to the sequence number of the
+ * last change written (to sequence when there were none). Call again with lastSequence
+ * until it equals GetChangeSequence.
+ *
+ * Returns  0 on success
+ * Returns -1 when sequence is newer than GetChangeSequence
+ * Returns -2 when the log is not enabled or changes after sequence are not in the log
+ *            (anymore): the follower has to start over from a full copy
+ * Returns -3 when bufferSize is smaller than the next change, at most MAX_CHANGE_SIZE
+ */
+int8_t ExportChangesSince(uint64_t sequence, uint8_t buffer[], size_t bufferSize,
+                          size_t* nrOfBytes, uint64_t* lastSequence);
+
+
+/***************************************************************************************
+ * Frees the log up to sequence, once every follower has exported it. The log is freed
+ * in blocks, so some older changes may remain.
+ */
+void TrimChangesBefore(uint64_t sequence);
+
+
+/***************************************************************************************
+ * Decodes the change at *position of an export and moves *position behind it
+ *
+ * Returns  0 when change is filled in
+ * Returns -1 at end, or when the bytes up to end are not a complete change
+ */
+int8_t ReadPatientChange(const uint8_t** position, const uint8_t* end, PatientChange* change);
+
 				
 				
 
 #define MAX_FILEPATH_LEGTH (250)
 
+
+typedef struct {
+	size_t evictedPatients;  // patients of which only the index entry is in memory
+	size_t rehydrations;     // patients read back from the segment so far
+	size_t segmentBytes;     // bytes written to the segment file
+	size_t deadBytes;        // segment bytes of removed or rehydrated patients
+} ColdTierStats;
+
 /***************************************************************************************
- * Writes all patient data to a text file in the table
+ * Enables the cold tier: inactive patients can be evicted to a segment file that is 
+ * created (or truncated) at filePath. 
  * 
  * Returns 0 on success
- * Returns -1 on faillure
+ * Returns -1 when the cold tier is already enabled or the file cannot be created
  */
-int8_t WriteToFile(char filePath[MAX_FILEPATH_LEGTH]);
+int8_t EnableColdTier(char filePath[MAX_FILEPATH_LEGTH]);
+
+
+/***************************************************************************************
+ * Reads all evicted patients back into memory and closes the segment file
+ * 
+ * Returns 0 on success
+ * Returns -1 when a patient could not be read back, the cold tier stays enabled then
+ */
+int8_t DisableColdTier(void);
+
+
+/***************************************************************************************
+ * Evicts every patient whose most recent dose is at least idleDays before today (and 
+ * patients without any dose) to the cold tier segment. Only a small index entry with
+ * the name, the number of doses and the position in the segment stays in memory.
+ * 
+ * IsPatientPresent, GetNumberOfMeasurements and RemovePatient are answered from the 
+ * index entry. AddPatientDose and PatientDoseInPeriod read the patient back first,
+ * after which it is resident (encoded, see EncodeInactivePatients) again.
+ * 
+ * Returns the number of patients evicted by this call, 0 when the tier is not enabled
+ * 
+ * It is a precondition that today is not NULL and that all dates are valid calendar dates
+ */
+size_t EvictInactivePatients(Date* today, uint16_t idleDays);
+
+
+/***************************************************************************************
+ * Returns counters of the cold tier
+ */
+void GetColdTierStats(ColdTierStats* stats);
+
+
+// Read-only mapping of a shared registry segment in a reading process
+typedef struct {
+	const void* base;
+	size_t      size;
+} SharedRegistryView;
+
+/***************************************************************************************
+ * Publishes the registry in a named POSIX shared memory segment (e.g. "/doseAdmin"), so
+ * other processes can read it live with OpenSharedRegistry. From now on every change 
+ * made by this process is also made in the segment. The segment has room for 
+ * maxNrOfPatients patients with all their doses; when it is full, AddPatient returns -2.
+ * 
+ * Readers never block this process: the segment carries a sequence number that is odd
+ * while a change is being made, and a reader retries when it changed during its read.
+ * 
+ * Returns  0 on success
+ * Returns -1 when a segment is already published or it cannot be created
+ * Returns -2 when more than maxNrOfPatients patients are present already
+ * Returns -3 when an evicted patient could not be read back from disk
+ */
+int8_t EnableSharedRegistry(char segmentName[MAX_FILEPATH_LEGTH], size_t maxNrOfPatients);
+
+
+/***************************************************************************************
+ * Stops publishing and removes the segment. Readers get -3 from then on.
+ */
+void DisableSharedRegistry(void);
+
+
+/***************************************************************************************
+ * Maps a segment published by another (or this) process for reading
+ * 
+ * Returns  0 on success
+ * Returns -1 when the segment does not exist or is not a registry segment
+ */
+int8_t OpenSharedRegistry(char segmentName[MAX_FILEPATH_LEGTH], SharedRegistryView* view);
+
+
+void CloseSharedRegistry(SharedRegistryView* view);
 
 
+/***************************************************************************************
+ * Copies the doses of a patient from a shared registry segment
+ * 
+ * Returns  0 when doses and nrOfDoses are filled
+ * Returns -1 when the passed patientName is not present
+ * Returns -2 when string length of patientName exceeds MAX_PATIENTNAME_SIZE
+ * Returns -3 when the publishing process removed the segment
+ * Returns -4 when the segment is damaged, e.g. the publishing process died during a 
+ *            change
+ */
+int8_t SharedPatientDoses(SharedRegistryView* view, char patientName[MAX_PATIENTNAME_SIZE],
+                          DoseData doses[MAX_DOSES_PER_PATIENT], size_t* nrOfDoses);
+
 
 /***************************************************************************************
- * Reads all patient data from a text file, and put the data in an empty table.
+ * PatientDoseInPeriod for a patient in a shared registry segment
+ * 
+ * Returns the same values as SharedPatientDoses
+ */
+int8_t SharedPatientDoseInPeriod(SharedRegistryView* view, char patientName[MAX_PATIENTNAME_SIZE],
+                                 Date* startDate, Date* endDate, uint32_t* totalDose);
+
+
+// A consistent view of the registry as it was when the snapshot was opened
+typedef struct {
+	uint32_t version;        // changes up to this version are visible
+	uint32_t firstHiddenId;  // patients registered later are not
+	uint32_t epoch;          // emptying the table ends all snapshots
+	uint32_t horizon;        // retention horizon (YYYYMMDD) when it was opened, 0: none
+} RegistrySnapshot;
+
+/***************************************************************************************
+ * Opens a snapshot of the registry, for reports that must see one consistent state 
+ * while doses keep coming in. Opening is O(1) and copies nothing: doses are only ever 
+ * appended, so for a patient that changes afterwards only its old dose count is kept, 
+ * and a patient that is removed (or loses expired doses) afterwards is copied before 
+ * that. Nothing is kept while no snapshot is open.
+ * 
+ * RemoveAllDataFromHashTable and CreateHashTable end all open snapshots.
+ * 
+ * Returns  0 on success, the snapshot must be released with ReleaseSnapshot
+ * Returns -2 when allocation of memory failed
+ */
+int8_t OpenSnapshot(RegistrySnapshot* snapshot);
+
+
+/***************************************************************************************
+ * Releases a snapshot. What was kept only for this snapshot is freed.
+ */
+void ReleaseSnapshot(RegistrySnapshot* snapshot);
+
+
+/***************************************************************************************
+ * PatientDoseInPeriod as of the moment the snapshot was opened
+ * 
+ * Returns  0 on success
+ * Returns -1 when the patient was not present when the snapshot was opened
+ * Returns -2 when string length of patientName exceeds MAX_PATIENTNAME_SIZE
+ * Returns -3 when the snapshot has ended or an evicted patient could not be read
+ */
+int8_t SnapshotPatientDoseInPeriod(RegistrySnapshot* snapshot,
+                                   char patientName[MAX_PATIENTNAME_SIZE],
+                                   Date* startDate, Date* endDate, uint32_t* totalDose);
+
+
+typedef enum {
+	CURSOR_UNORDERED, // table order, fastest
+	CURSOR_BY_NAME    // ascending strcmp order of the names
+} CursorOrder;
+
+typedef struct {
+	CursorOrder order;
+	uint16_t    bucket;         // unordered: current table entry
+	size_t      indexInBucket;  // unordered: number of patients passed in that entry
+	const void* nextPatient;    // unordered: cached successor, valid for layoutVersion
+	uint32_t    layoutVersion;
+	size_t      position;       // by name: next entry of nameOrder
+	size_t      nrOfEntries;
+	void*       nameOrder;      // by name: patient ids sorted by name
+	const RegistrySnapshot* snapshot; // snapshot cursor: the state to show, else NULL
+	DoseData    scratch[MAX_DOSES_PER_PATIENT]; // doses of encoded or evicted patients
+} PatientCursor;
+
+/***************************************************************************************
+ * Opens a cursor over all patients in the table, in table order or in name order.
+ * 
+ * Adding doses while the cursor is open is allowed: every patient is still returned 
+ * exactly once. In name order, patients removed meanwhile are skipped and patients 
+ * added meanwhile are not returned. In table order, adding or removing patients may 
+ * make the cursor skip or repeat a patient of the same table entry.
+ * 
+ * Returns -2 when allocation of memory failed (name order only)
+ * Returns  0 on success, the cursor must be closed with ClosePatientCursor
+ */
+int8_t OpenPatientCursor(PatientCursor* cursor, CursorOrder order);
+
+
+/***************************************************************************************
+ * Opens a cursor over the patients of a snapshot, in name order. Every patient present
+ * when the snapshot was opened is returned once with the doses it had then, whatever 
+ * is added or removed while the cursor is open.
+ * 
+ * Returns -2 when allocation of memory failed
+ * Returns -3 when the snapshot has ended
+ * Returns  0 on success, the cursor must be closed with ClosePatientCursor before the 
+ *            snapshot is released
+ */
+int8_t OpenSnapshotCursor(PatientCursor* cursor, RegistrySnapshot* snapshot);
+
+
+/***************************************************************************************
+ * Returns the next patient of the cursor without copying: patientName and doses point 
+ * into the table (or into the cursor for encoded and evicted patients). They stay 
+ * valid until the next doseAdmin call that changes this patient or the registry layout.
+ * 
+ * Returns -1 when there are no more patients
+ * Returns -3 when an evicted patient could not be read from disk, or the snapshot of 
+ *            a snapshot cursor has ended
+ * Returns  0 when patientName, doses and nrOfDoses are filled in
+ */
+int8_t NextPatient(PatientCursor* cursor, const char** patientName,
+                   const DoseData** doses, size_t* nrOfDoses);
+
+
+/***************************************************************************************
+ * Releases the resources of a cursor
+ */
+void ClosePatientCursor(PatientCursor* cursor);
+
+
+/***************************************************************************************
+ * Writes all patient data to a text file in the table, in a single pass over the table.
+ * Each line holds a name followed by a tab and "dd-mm-yyyy dose" for every dose.
  * 
  * Returns 0 on success
  * Returns -1 on faillure
  */
+int8_t WriteToFile(char filePath[MAX_FILEPATH_LEGTH]);
+
+
+
+/***************************************************************************************
+ * Reads all patient data from a text file as written by WriteToFile, and put the data 
+ * in an empty table: the table is emptied first. 
+ * 
+ * The file is split at line boundaries and the parts are parsed in parallel, one 
+ * thread per processor; the patients are then added in file order. The table is only 
+ * touched when the whole file could be parsed.
+ * 
+ * Returns  0 on success
+ * Returns -1 when the file cannot be read or is malformed, e.g. a name is too long 
+ *            (the table is not touched)
+ * Returns -2 when allocation of memory failed or the shared registry segment is full
+ * Returns -3 when a patient is listed twice
+ * The table is left empty after -2 and -3.
+ */
 int8_t ReadFromFile(char filePath[MAX_FILEPATH_LEGTH]);
 
+
+// An archive file opened for lookups
+typedef struct {
+	void*    file;         // FILE* of the archive
+	void*    blocks;       // first name, position and size of every block
+	uint32_t nrOfBlocks;
+	uint32_t cachedBlock;  // block held in buffer, nrOfBlocks when none
+	uint8_t* buffer;       // the block read last
+} PatientArchive;
+
+/***************************************************************************************
+ * Writes all patients to an archive file, for lookups of single patients without 
+ * loading the registry (see OpenArchive). The patients are stored in name order in 
+ * blocks of a few KB; names are front coded and doses are varint encoded, which makes
+ * the file about a third of the size WriteToFile writes. A footer lists the first 
+ * name of every block.
+ * 
+ * Returns  0 on success
+ * Returns -1 when the file cannot be written, or an evicted patient could not be read
+ * Returns -2 when allocation of memory failed
+ */
+int8_t WriteArchive(char filePath[MAX_FILEPATH_LEGTH]);
+
+
+/***************************************************************************************
+ * Opens an archive written by WriteArchive. Only the block index is read into memory; 
+ * every lookup reads and decodes the one block that holds the patient, the block read 
+ * last is kept. The archive does not depend on the table.
+ * 
+ * Returns  0 on success, the archive must be closed with CloseArchive
+ * Returns -1 when the file cannot be read or is not an archive
+ * Returns -2 when allocation of memory failed
+ */
+int8_t OpenArchive(char filePath[MAX_FILEPATH_LEGTH], PatientArchive* archive);
+
+
+void CloseArchive(PatientArchive* archive);
+
+
+/***************************************************************************************
+ * IsPatientPresent, PatientDoseInPeriod and the doses of a patient, answered from an 
+ * archive. They return the same values as those functions, except
+ * 
+ * Returns -3 when the block of the patient cannot be read or is damaged
+ */
+int8_t ArchiveIsPatientPresent(PatientArchive* archive, char patientName[MAX_PATIENTNAME_SIZE]);
+
+int8_t ArchivePatientDoseInPeriod(PatientArchive* archive, char patientName[MAX_PATIENTNAME_SIZE],
+                                  Date* startDate, Date* endDate, uint32_t* totalDose);
+
+int8_t ArchivePatientDoses(PatientArchive* archive, char patientName[MAX_PATIENTNAME_SIZE],
+                           DoseData doses[MAX_DOSES_PER_PATIENT], size_t* nrOfDoses);
+
+
+typedef struct {
+	size_t rows;           // rows read, not counting empty lines and a header
+	size_t importedRows;   // doses added
+	size_t addedPatients;  // patients that were not present yet
+	size_t failedRows;     // rows that were skipped
+} CsvImportStats;
+
+typedef struct {
+	size_t line;    // line number in the file, from 1
+	int8_t result;  // -1: the row is malformed, else the value AddPatientExamDose returned
+} CsvRowError;
+
+/***************************************************************************************
+ * Imports the doses of a CSV file with one dose per row: "name,date,dose" or 
+ * "name,date,dose,examType", e.g. "Doe, John",2024-03-01,120. A name with a comma or 
+ * a quote is quoted, with "" for a quote. A date is yyyy-mm-dd or dd-mm-yyyy. A first
+ * line whose date field does not start with a digit is a header and is skipped.
+ * 
+ * Patients that are not present are added. The file is read through one fixed size 
+ * buffer, so files of any size can be imported. Rows of the same patient that follow 
+ * each other (as in most dumps) look the patient up once.
+ * 
+ * A row that fails is skipped and the import goes on. stats counts all rows; the first
+ * maxNrOfErrors failed rows are described in errors.
+ * 
+ * Returns  0 when the whole file was read, even when rows failed
+ * Returns -1 when the file cannot be opened or reading it failed
+ * Returns -2 when allocation of memory failed
+ */
+int8_t ImportCsvFile(char filePath[MAX_FILEPATH_LEGTH], CsvImportStats* stats,
+                     CsvRowError errors[], size_t maxNrOfErrors);
+
+
+/***************************************************************************************
+ * Writes all doses as columns, for analysis in other tools: one NumPy .npy file per 
+ * column, each a contiguous little endian array that can be mapped or loaded with 
+ * numpy.load without parsing. Row i of the four dose columns is one dose:
+ * 
+ *   <filePrefix>patient.npy   uint32  row of the patient in names.npy
+ *   <filePrefix>day.npy       uint32  date as days since 1 January 1900
+ *   <filePrefix>dose.npy      uint16
+ *   <filePrefix>examType.npy  uint8   EXAMINATION_TYPES
+ *   <filePrefix>names.npy     one name per patient, \0 padded to MAX_PATIENTNAME_SIZE - 1
+ * 
+ * The table is walked once and the files are written through fixed size buffers, so 
+ * the memory used does not depend on the size of the registry.
+ * 
+ * Returns  0 on success
+ * Returns -1 when a file cannot be written, or an evicted patient could not be read
+ * Returns -2 when allocation of memory failed
+ */
+int8_t ExportColumns(char filePrefix[MAX_FILEPATH_LEGTH]);
+
 #endif
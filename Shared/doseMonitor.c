@@ -0,0 +1,267 @@
+#include "doseMonitor.h"
+#include <stdlib.h>
+#include <string.h>
+#include "calendar.h"
+
+#define INITIAL_CAPACITY (64)
+
+typedef struct {
+	uint32_t patientId;                 // 0: empty slot, patient ids start at 1
+	uint32_t lastDay;                   // day number of the newest dose
+	uint32_t sum[MAX_DOSE_WINDOWS];     // dose in the window ending at lastDay
+	uint8_t  front[MAX_DOSE_WINDOWS];   // index of the oldest dose inside the window
+	bool     ordered;                   // doses arrived in date order so far
+} WindowSums;
+
+static DoseWindow windows[MAX_DOSE_WINDOWS];
+static size_t nrOfWindows = 0;
+
+// Sums per patient: open addressing with linear probing, capacity is a power of two
+static WindowSums* entries = NULL;
+static size_t capacity = 0;
+static size_t count = 0;
+
+// Ring buffer of alerts that were not polled yet, the oldest is dropped when full
+static DoseAlert alerts[DOSE_ALERT_QUEUE_SIZE];
+static size_t firstAlert = 0;
+static size_t nrOfAlerts = 0;
+
+
+static size_t slotOf(uint32_t patientId)
+{
+	return (size_t)((patientId * 2654435769u) >> 8) & (capacity - 1);
+}
+
+static WindowSums* findEntry(uint32_t patientId)
+{
+	if (capacity == 0) {
+		return NULL;
+	}
+	for (size_t slot = slotOf(patientId); entries[slot].patientId != 0;
+	     slot = (slot + 1) & (capacity - 1)) {
+		if (entries[slot].patientId == patientId) {
+			return &entries[slot];
+		}
+	}
+	return NULL;
+}
+
+static WindowSums* insertEntry(uint32_t patientId)
+{
+	size_t slot = slotOf(patientId);
+
+	while (entries[slot].patientId != 0) {
+		slot = (slot + 1) & (capacity - 1);
+	}
+	entries[slot].patientId = patientId;
+	count++;
+	return &entries[slot];
+}
+
+/**
+ * @brief Creates the (empty) sums of a patient, growing the table below load 3/4.
+ * @return NULL when memory allocation failed
+ */
+static WindowSums* createEntry(uint32_t patientId)
+{
+	if ((count + 1) * 4 >= capacity * 3) {
+		size_t oldCapacity = capacity;
+		WindowSums* oldEntries = entries;
+		size_t newCapacity = (capacity == 0) ? INITIAL_CAPACITY : 2 * capacity;
+		WindowSums* newEntries = calloc(newCapacity, sizeof(WindowSums));
+		if (newEntries == NULL) {
+			return NULL;
+		}
+		entries = newEntries;
+		capacity = newCapacity;
+		count = 0;
+		for (size_t i = 0; i < oldCapacity; i++) {
+			if (oldEntries[i].patientId != 0) {
+				*insertEntry(oldEntries[i].patientId) = oldEntries[i];
+			}
+		}
+		free(oldEntries);
+	}
+	return insertEntry(patientId);
+}
+
+static void clearEntries(void)
+{
+	free(entries);
+	entries = NULL;
+	capacity = 0;
+	count = 0;
+}
+
+/**
+ * @brief Sums the doses in every window ending at endDay from scratch. The doses 
+ *        before each window are counted in front, which is only meaningful when the 
+ *        doses are in date order.
+ */
+static void recompute(WindowSums* sums, const DoseData* doses, uint8_t doseCount, uint32_t endDay)
+{
+	memset(sums->sum, 0, sizeof(sums->sum));
+	memset(sums->front, 0, sizeof(sums->front));
+	sums->lastDay = endDay;
+	for (uint8_t i = 0; i < doseCount; i++) {
+		uint32_t day = DateToDayNumber(&doses[i].date);
+		for (size_t w = 0; w < nrOfWindows; w++) {
+			if (day + windows[w].days <= endDay) {
+				sums->front[w]++;
+			}
+			else if (day <= endDay) {
+				sums->sum[w] += doses[i].dose;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Drops the doses that fell out of the windows when the newest day moves 
+ *        forward to endDay. Only valid for doses in date order.
+ */
+static void advance(WindowSums* sums, const DoseData* doses, uint8_t doseCount, uint32_t endDay)
+{
+	for (size_t w = 0; w < nrOfWindows; w++) {
+		while (sums->front[w] < doseCount &&
+		       DateToDayNumber(&doses[sums->front[w]].date) + windows[w].days <= endDay) {
+			sums->sum[w] -= doses[sums->front[w]].dose;
+			sums->front[w]++;
+		}
+	}
+	sums->lastDay = endDay;
+}
+
+/**
+ * @brief Sets up the sums of a patient that was not seen since the windows were set.
+ */
+static void startFromHistory(WindowSums* sums, const DoseData* doses, uint8_t doseCount)
+{
+	uint32_t lastDay = 0;
+
+	sums->ordered = true;
+	for (uint8_t i = 0; i < doseCount; i++) {
+		uint32_t day = DateToDayNumber(&doses[i].date);
+		if (day < lastDay) {
+			sums->ordered = false;
+		}
+		else {
+			lastDay = day;
+		}
+	}
+	recompute(sums, doses, doseCount, lastDay);
+}
+
+static void queueAlert(const char* patientName, const Date* date, size_t window, uint32_t dose)
+{
+	if (nrOfAlerts == DOSE_ALERT_QUEUE_SIZE) {
+		firstAlert = (firstAlert + 1) % DOSE_ALERT_QUEUE_SIZE;
+		nrOfAlerts--;
+	}
+
+	DoseAlert* alert = &alerts[(firstAlert + nrOfAlerts++) % DOSE_ALERT_QUEUE_SIZE];
+	strncpy(alert->patientName, patientName, MAX_PATIENTNAME_SIZE - 1);
+	alert->patientName[MAX_PATIENTNAME_SIZE - 1] = '\0';
+	alert->date = *date;
+	alert->window = windows[window];
+	alert->cumulativeDose = dose;
+}
+
+void DoseMonitorConfigure(const DoseWindow newWindows[], size_t nrOfNewWindows)
+{
+	for (size_t i = 0; i < nrOfNewWindows; i++) {
+		windows[i] = newWindows[i];
+	}
+	nrOfWindows = nrOfNewWindows;
+	DoseMonitorClear();
+}
+
+void DoseMonitorAdd(uint32_t patientId, const char* patientName, const DoseData* doses,
+                    uint8_t doseCount, const Date* date, uint16_t dose)
+{
+	if (nrOfWindows == 0) {
+		return;
+	}
+
+	WindowSums scratch;
+	WindowSums* sums = findEntry(patientId);
+	if (sums == NULL) {
+		sums = createEntry(patientId);
+		if (sums == NULL) {
+			sums = &scratch; // not kept: the next dose starts from the history again
+		}
+		startFromHistory(sums, doses, doseCount);
+	}
+
+	uint32_t day = DateToDayNumber(date);
+	if (sums->ordered && day >= sums->lastDay) {
+		advance(sums, doses, doseCount, day);
+	}
+	else {
+		// Doses from the past: the front of the windows is unknown, sum them again
+		sums->ordered = false;
+		recompute(sums, doses, doseCount, (day > sums->lastDay) ? day : sums->lastDay);
+	}
+
+	for (size_t w = 0; w < nrOfWindows; w++) {
+		if (day + windows[w].days <= sums->lastDay) {
+			continue; // too old for this window
+		}
+		uint32_t before = sums->sum[w];
+		sums->sum[w] += dose;
+		if (before < windows[w].threshold && sums->sum[w] >= windows[w].threshold) {
+			queueAlert(patientName, date, w, sums->sum[w]);
+		}
+	}
+}
+
+void DoseMonitorForget(uint32_t patientId)
+{
+	WindowSums* sums = findEntry(patientId);
+	if (sums == NULL) {
+		return;
+	}
+
+	// Backward shift deletion, so lookups never need tombstones
+	size_t hole = (size_t)(sums - entries);
+	size_t slot = hole;
+	for (;;) {
+		slot = (slot + 1) & (capacity - 1);
+		if (entries[slot].patientId == 0) {
+			break;
+		}
+		size_t home = slotOf(entries[slot].patientId);
+		if (((slot - home) & (capacity - 1)) >= ((slot - hole) & (capacity - 1))) {
+			entries[hole] = entries[slot];
+			hole = slot;
+		}
+	}
+	entries[hole].patientId = 0;
+
+	if (--count == 0) {
+		clearEntries();
+	}
+}
+
+void DoseMonitorClear(void)
+{
+	clearEntries();
+	firstAlert = 0;
+	nrOfAlerts = 0;
+}
+
+bool DoseMonitorPoll(DoseAlert* alert)
+{
+	if (nrOfAlerts == 0) {
+		return false;
+	}
+	*alert = alerts[firstAlert];
+	firstAlert = (firstAlert + 1) % DOSE_ALERT_QUEUE_SIZE;
+	nrOfAlerts--;
+	return true;
+}
+
+size_t DoseMonitorBytes(void)
+{
+	return capacity * sizeof(WindowSums);
+}
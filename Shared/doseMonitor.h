@@ -0,0 +1,53 @@
+#ifndef DOSEMONITOR_H
+#define DOSEMONITOR_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "doseAdmin.h"
+
+// Internal to the Shared module: cumulative dose per patient over the configured 
+// rolling windows. A window covers the days up to the newest dose of the patient. 
+// The sum of each window is kept per patient and moved forward as doses arrive, so a
+// dose costs (amortized) constant time when doses arrive in date order.
+
+
+/***************************************************************************************
+ * Replaces the monitored windows and forgets all sums and queued alerts
+ */
+void DoseMonitorConfigure(const DoseWindow windows[], size_t nrOfWindows);
+
+
+/***************************************************************************************
+ * Moves the windows of a patient forward for a new dose, before it is appended to the
+ * patient's doseCount doses, and queues an alert for every threshold it crosses
+ */
+void DoseMonitorAdd(uint32_t patientId, const char* patientName, const DoseData* doses,
+                    uint8_t doseCount, const Date* date, uint16_t dose);
+
+
+/***************************************************************************************
+ * Forgets the sums of a removed patient
+ */
+void DoseMonitorForget(uint32_t patientId);
+
+
+/***************************************************************************************
+ * Forgets all sums and queued alerts, the windows are kept
+ */
+void DoseMonitorClear(void);
+
+
+/***************************************************************************************
+ * Takes the oldest queued alert
+ * 
+ * Returns false when no alert is queued
+ */
+bool DoseMonitorPoll(DoseAlert* alert);
+
+
+/***************************************************************************************
+ * Returns the bytes allocated for the sums
+ */
+size_t DoseMonitorBytes(void);
+
+#endif
@@ -0,0 +1,285 @@
+#include "doseRollup.h"
+#include <stdlib.h>
+#include <string.h>
+#include "calendar.h"
+
+#define FIRST_YEAR       (1900)
+#define LAST_YEAR        (2500)
+#define NR_OF_YEARS      (LAST_YEAR - FIRST_YEAR + 1)
+#define NR_OF_MONTHS     (NR_OF_YEARS * 12)
+#define INITIAL_CAPACITY (64)
+#define YEAR_FLAG        (0x80000000u) // distinguishes year keys from month keys
+#define EXAM_TYPE_FLAG   (0x40000000u) // and examination type keys from both
+
+typedef struct {
+	uint64_t key;        // patient id << 32 | period, 0: empty slot
+	uint32_t totalDose;  // at most MAX_DOSES_PER_PATIENT doses, fits easily
+} RollupEntry;
+
+// Registry totals, one counter per month and per year of the supported date range
+static uint64_t registryMonths[NR_OF_MONTHS];
+static uint64_t registryYears[NR_OF_YEARS];
+static uint64_t registryExamTypes[NR_OF_EXAM_TYPES];
+
+// Patient totals: open addressing with linear probing, capacity is a power of two
+static RollupEntry* entries = NULL;
+static size_t capacity = 0;
+static size_t count = 0;
+
+
+static uint32_t monthIndex(uint16_t year, uint8_t month)
+{
+	return (uint32_t)(year - FIRST_YEAR) * 12 + (month - 1);
+}
+
+/**
+ * @brief Checks that the totals of a dose are inside the directories. The callers only
+ *        pass validated doses, this keeps a bad one from writing outside them.
+ */
+static bool isInRange(const Date* date, uint8_t examType)
+{
+	return date->year >= FIRST_YEAR && date->year <= LAST_YEAR && date->month >= 1 &&
+	       date->month <= 12 && examType < NR_OF_EXAM_TYPES;
+}
+
+static uint64_t makeKey(uint32_t patientId, uint32_t period)
+{
+	return ((uint64_t)patientId << 32) | period;
+}
+
+static size_t slotOf(uint64_t key)
+{
+	// Fibonacci hashing spreads the consecutive ids and months over the table
+	return (size_t)((key * 11400714819323198485ULL) >> 32) & (capacity - 1);
+}
+
+static RollupEntry* findEntry(uint64_t key)
+{
+	if (capacity == 0) {
+		return NULL;
+	}
+	for (size_t slot = slotOf(key); entries[slot].key != 0; slot = (slot + 1) & (capacity - 1)) {
+		if (entries[slot].key == key) {
+			return &entries[slot];
+		}
+	}
+	return NULL;
+}
+
+static RollupEntry* insertEntry(uint64_t key)
+{
+	size_t slot = slotOf(key);
+
+	while (entries[slot].key != 0 && entries[slot].key != key) {
+		slot = (slot + 1) & (capacity - 1);
+	}
+	if (entries[slot].key == 0) {
+		entries[slot].key = key;
+		entries[slot].totalDose = 0;
+		count++;
+	}
+	return &entries[slot];
+}
+
+/**
+ * @brief Makes room for extra entries, keeping the load factor below 3/4.
+ */
+static bool reserve(size_t extra)
+{
+	if ((count + extra) * 4 < capacity * 3) {
+		return true;
+	}
+
+	size_t oldCapacity = capacity;
+	RollupEntry* oldEntries = entries;
+	size_t newCapacity = (capacity == 0) ? INITIAL_CAPACITY : 2 * capacity;
+	RollupEntry* newEntries = calloc(newCapacity, sizeof(RollupEntry));
+	if (newEntries == NULL) {
+		return false;
+	}
+
+	entries = newEntries;
+	capacity = newCapacity;
+	count = 0;
+	for (size_t i = 0; i < oldCapacity; i++) {
+		if (oldEntries[i].key != 0) {
+			insertEntry(oldEntries[i].key)->totalDose = oldEntries[i].totalDose;
+		}
+	}
+	free(oldEntries);
+	return true;
+}
+
+/**
+ * @brief Empties a slot and shifts later entries of the probe sequence back into it,
+ *        so lookups never need tombstones.
+ */
+static void deleteEntry(RollupEntry* entry)
+{
+	size_t hole = (size_t)(entry - entries);
+	size_t slot = hole;
+
+	for (;;) {
+		slot = (slot + 1) & (capacity - 1);
+		if (entries[slot].key == 0) {
+			break;
+		}
+		size_t home = slotOf(entries[slot].key);
+		// Move the entry when its home slot is not between the hole and its position
+		if (((slot - home) & (capacity - 1)) >= ((slot - hole) & (capacity - 1))) {
+			entries[hole] = entries[slot];
+			hole = slot;
+		}
+	}
+	entries[hole].key = 0;
+
+	if (--count == 0) {
+		free(entries);
+		entries = NULL;
+		capacity = 0;
+	}
+}
+
+static void subtract(uint64_t key, uint16_t dose)
+{
+	RollupEntry* entry = findEntry(key);
+
+	if (entry != NULL) {
+		entry->totalDose -= dose;
+		if (entry->totalDose == 0) {
+			deleteEntry(entry);
+		}
+	}
+}
+
+bool RollupAdd(uint32_t patientId, const Date* date, uint16_t dose, uint8_t examType)
+{
+	uint32_t month = monthIndex(date->year, date->month);
+	uint32_t year = date->year - FIRST_YEAR;
+
+	if (!isInRange(date, examType) || !reserve(3)) {
+		return false;
+	}
+	insertEntry(makeKey(patientId, month))->totalDose += dose;
+	insertEntry(makeKey(patientId, YEAR_FLAG | year))->totalDose += dose;
+	insertEntry(makeKey(patientId, EXAM_TYPE_FLAG | examType))->totalDose += dose;
+	registryMonths[month] += dose;
+	registryYears[year] += dose;
+	registryExamTypes[examType] += dose;
+	return true;
+}
+
+void RollupRemove(uint32_t patientId, const Date* date, uint16_t dose, uint8_t examType)
+{
+	uint32_t month = monthIndex(date->year, date->month);
+	uint32_t year = date->year - FIRST_YEAR;
+
+	if (!isInRange(date, examType)) {
+		return;
+	}
+	subtract(makeKey(patientId, month), dose);
+	subtract(makeKey(patientId, YEAR_FLAG | year), dose);
+	subtract(makeKey(patientId, EXAM_TYPE_FLAG | examType), dose);
+	registryMonths[month] -= dose;
+	registryYears[year] -= dose;
+	registryExamTypes[examType] -= dose;
+}
+
+void RollupClear(void)
+{
+	free(entries);
+	entries = NULL;
+	capacity = 0;
+	count = 0;
+	memset(registryMonths, 0, sizeof(registryMonths));
+	memset(registryYears, 0, sizeof(registryYears));
+	memset(registryExamTypes, 0, sizeof(registryExamTypes));
+}
+
+static uint64_t monthTotal(uint32_t patientId, uint32_t month)
+{
+	if (patientId == ROLLUP_REGISTRY) {
+		return registryMonths[month];
+	}
+	RollupEntry* entry = findEntry(makeKey(patientId, month));
+	return (entry != NULL) ? entry->totalDose : 0;
+}
+
+static uint64_t yearTotal(uint32_t patientId, uint32_t year)
+{
+	if (patientId == ROLLUP_REGISTRY) {
+		return registryYears[year];
+	}
+	RollupEntry* entry = findEntry(makeKey(patientId, YEAR_FLAG | year));
+	return (entry != NULL) ? entry->totalDose : 0;
+}
+
+uint64_t RollupExamTypeTotal(uint32_t patientId, uint8_t examType)
+{
+	if (patientId == ROLLUP_REGISTRY) {
+		return registryExamTypes[examType];
+	}
+	RollupEntry* entry = findEntry(makeKey(patientId, EXAM_TYPE_FLAG | examType));
+	return (entry != NULL) ? entry->totalDose : 0;
+}
+
+static uint32_t firstDayOfMonth(uint32_t month)
+{
+	Date date = {1, (uint8_t)(month % 12 + 1), (uint16_t)(FIRST_YEAR + month / 12)};
+	return DateToDayNumber(&date);
+}
+
+uint64_t RollupSum(uint32_t patientId, const Date* startDate, const Date* endDate,
+                   RollupEdgeSum edgeSum, void* context)
+{
+	// No doses exist outside the supported range, clip the period to it
+	Date first = {1, 1, FIRST_YEAR};
+	Date last = {31, 12, LAST_YEAR};
+	const Date* start = (startDate->year < FIRST_YEAR) ? &first : startDate;
+	const Date* end = (endDate->year > LAST_YEAR) ? &last : endDate;
+	if (start->year > LAST_YEAR || end->year < FIRST_YEAR) {
+		return 0;
+	}
+
+	uint32_t startDay = DateToDayNumber(start);
+	uint32_t endDay = DateToDayNumber(end);
+	if (startDay > endDay) {
+		return 0;
+	}
+
+	uint32_t startMonth = monthIndex(start->year, start->month);
+	uint32_t endMonth = monthIndex(end->year, end->month);
+	// Whole months covered by the period: [fullStart, fullEnd)
+	uint32_t fullStart = (start->day == 1) ? startMonth : startMonth + 1;
+	uint32_t fullEnd = (end->day == DaysInMonth(end->month, end->year)) ? endMonth + 1 : endMonth;
+	uint64_t total = 0;
+
+	if (fullStart >= fullEnd) {
+		// Within one month, or two partial neighbouring months
+		return edgeSum(startDay, endDay, context);
+	}
+	if (fullStart != startMonth) {
+		total += edgeSum(startDay, firstDayOfMonth(fullStart) - 1, context);
+	}
+	if (fullEnd != endMonth + 1) {
+		total += edgeSum(firstDayOfMonth(endMonth), endDay, context);
+	}
+
+	for (uint32_t month = fullStart; month < fullEnd; ) {
+		if (month % 12 == 0 && month + 12 <= fullEnd) {
+			total += yearTotal(patientId, month / 12);
+			month += 12;
+		}
+		else {
+			total += monthTotal(patientId, month);
+			month++;
+		}
+	}
+	return total;
+}
+
+size_t RollupBytes(void)
+{
+	return sizeof(registryMonths) + sizeof(registryYears) + sizeof(registryExamTypes) +
+	       capacity * sizeof(RollupEntry);
+}
@@ -0,0 +1,61 @@
+#ifndef DOSEROLLUP_H
+#define DOSEROLLUP_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "doseAdmin.h"
+
+// Internal to the Shared module: dose totals per calendar month and per year, for every
+// patient and for the registry as a whole. Patient totals live in one hash map keyed
+// by (patient id, period), registry totals in a directory of the supported date range.
+// Next to the calendar totals, an all-time total is kept per examination type.
+#define ROLLUP_REGISTRY (0) // patient ids start at 1, id 0 addresses the registry totals
+
+// Sums the raw doses with a day number in [startDay, endDay], for the partial months
+// at the edges of a query
+typedef uint64_t (*RollupEdgeSum)(uint32_t startDay, uint32_t endDay, void* context);
+
+
+/***************************************************************************************
+ * Adds a dose to the month, year and examination type totals of the patient and of 
+ * the registry
+ * 
+ * Returns false when allocation of memory failed, or the date or examType is outside
+ * the supported range; nothing is changed in that case
+ */
+bool RollupAdd(uint32_t patientId, const Date* date, uint16_t dose, uint8_t examType);
+
+
+/***************************************************************************************
+ * Subtracts a dose that was added with RollupAdd
+ */
+void RollupRemove(uint32_t patientId, const Date* date, uint16_t dose, uint8_t examType);
+
+
+/***************************************************************************************
+ * Forgets all totals
+ */
+void RollupClear(void);
+
+
+/***************************************************************************************
+ * Returns the total dose of the patient (or ROLLUP_REGISTRY) in [startDate, endDate].
+ * Whole years and whole months are taken from the totals, edgeSum is only called for 
+ * the part of the first and last month that the period does not cover completely.
+ */
+uint64_t RollupSum(uint32_t patientId, const Date* startDate, const Date* endDate,
+                   RollupEdgeSum edgeSum, void* context);
+
+
+/***************************************************************************************
+ * Returns the total dose of one examination type of the patient (or ROLLUP_REGISTRY)
+ */
+uint64_t RollupExamTypeTotal(uint32_t patientId, uint8_t examType);
+
+
+/***************************************************************************************
+ * Returns the bytes allocated for the totals
+ */
+size_t RollupBytes(void);
+
+#endif
@@ -0,0 +1,220 @@
+#include "doseSketch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define FIRST_YEAR   (1900)
+#define LAST_YEAR    (2500)
+#define NR_OF_MONTHS ((LAST_YEAR - FIRST_YEAR + 1) * 12)
+// Bucket i holds doses in (GAMMA^(i-1), GAMMA^i], GAMMA = (1 + accuracy) / (1 - accuracy)
+#define GAMMA        ((1.0 + DOSE_SKETCH_ACCURACY) / (1.0 - DOSE_SKETCH_ACCURACY))
+// ceil(log(UINT16_MAX) / log(GAMMA)) + 1 for accuracy 0.01
+#define NR_OF_BUCKETS (556)
+
+typedef struct {
+	uint32_t count;
+	uint32_t buckets[NR_OF_BUCKETS];
+} DoseSketch;
+
+typedef struct {
+	DoseSketch* perType[NR_OF_EXAM_TYPES]; // allocated on the first dose of the type
+} MonthSketches;
+
+// Directory of all months in the supported date range, like the date index
+static MonthSketches* months[NR_OF_MONTHS];
+static size_t allocatedBytes = 0;
+// Months before this one were dropped, so the next drop starts here
+static size_t firstKeptMonth = 0;
+
+
+static size_t monthIndex(const Date* date)
+{
+	return (size_t)(date->year - FIRST_YEAR) * 12 + (date->month - 1);
+}
+
+/**
+ * @brief Checks that a dose is inside the directory. The callers only pass validated 
+ *        doses, this keeps a bad one from writing outside it.
+ */
+static bool isInRange(const Date* date, uint8_t examType)
+{
+	return date->year >= FIRST_YEAR && date->year <= LAST_YEAR && date->month >= 1 &&
+	       date->month <= 12 && examType < NR_OF_EXAM_TYPES;
+}
+
+/**
+ * @brief Returns the number of months of the directory before the month of date, 0 for
+ *        a date before the range and all of them for a date after it.
+ */
+static size_t monthsBefore(const Date* date)
+{
+	if (date->year < FIRST_YEAR) {
+		return 0;
+	}
+	if (date->year > LAST_YEAR) {
+		return NR_OF_MONTHS;
+	}
+	uint8_t month = (date->month < 1) ? 1 : (date->month > 12) ? 12 : date->month;
+	return (size_t)(date->year - FIRST_YEAR) * 12 + (month - 1);
+}
+
+static size_t bucketOf(uint16_t dose)
+{
+	if (dose <= 1) {
+		return 0; // a dose of 0 is not expected, it shares the bucket of 1
+	}
+	size_t bucket = (size_t)ceil(log((double)dose) / log(GAMMA));
+	return (bucket < NR_OF_BUCKETS) ? bucket : NR_OF_BUCKETS - 1;
+}
+
+/**
+ * @brief Returns the value in the middle (relatively) of a bucket, the dose with the 
+ *        smallest worst case relative error for all doses in it.
+ */
+static uint16_t bucketValue(size_t bucket)
+{
+	double value = 2.0 * pow(GAMMA, (double)bucket) / (GAMMA + 1.0);
+	return (value >= UINT16_MAX) ? UINT16_MAX : (uint16_t)(value + 0.5);
+}
+
+bool DoseSketchAdd(const Date* date, uint8_t examType, uint16_t dose)
+{
+	if (!isInRange(date, examType)) {
+		return false;
+	}
+	size_t index = monthIndex(date);
+	MonthSketches* month = months[index];
+
+	if (month == NULL) {
+		month = calloc(1, sizeof(MonthSketches));
+		if (month == NULL) {
+			return false;
+		}
+		months[index] = month;
+		allocatedBytes += sizeof(MonthSketches);
+	}
+
+	DoseSketch* sketch = month->perType[examType];
+	if (sketch == NULL) {
+		sketch = calloc(1, sizeof(DoseSketch));
+		if (sketch == NULL) {
+			return false;
+		}
+		month->perType[examType] = sketch;
+		allocatedBytes += sizeof(DoseSketch);
+	}
+
+	sketch->buckets[bucketOf(dose)]++;
+	sketch->count++;
+	return true;
+}
+
+void DoseSketchRemove(const Date* date, uint8_t examType, uint16_t dose)
+{
+	if (!isInRange(date, examType)) {
+		return;
+	}
+	size_t index = monthIndex(date);
+	MonthSketches* month = months[index];
+	DoseSketch* sketch = (month != NULL) ? month->perType[examType] : NULL;
+	size_t bucket = bucketOf(dose);
+
+	if (sketch == NULL || sketch->buckets[bucket] == 0) {
+		return;
+	}
+	sketch->buckets[bucket]--;
+	if (--sketch->count > 0) {
+		return;
+	}
+
+	// Free what became empty, so the memory follows the registry
+	free(sketch);
+	month->perType[examType] = NULL;
+	allocatedBytes -= sizeof(DoseSketch);
+	for (int type = 0; type < NR_OF_EXAM_TYPES; type++) {
+		if (month->perType[type] != NULL) {
+			return;
+		}
+	}
+	free(month);
+	months[index] = NULL;
+	allocatedBytes -= sizeof(MonthSketches);
+}
+
+static void freeMonth(size_t index)
+{
+	if (months[index] != NULL) {
+		for (int type = 0; type < NR_OF_EXAM_TYPES; type++) {
+			if (months[index]->perType[type] != NULL) {
+				free(months[index]->perType[type]);
+				allocatedBytes -= sizeof(DoseSketch);
+			}
+		}
+		free(months[index]);
+		months[index] = NULL;
+		allocatedBytes -= sizeof(MonthSketches);
+	}
+}
+
+void DoseSketchClear(void)
+{
+	for (size_t i = 0; i < NR_OF_MONTHS; i++) {
+		freeMonth(i);
+	}
+	allocatedBytes = 0;
+	firstKeptMonth = 0;
+}
+
+void DoseSketchDropBefore(const Date* horizon)
+{
+	size_t end = monthsBefore(horizon);
+
+	for (; firstKeptMonth < end; firstKeptMonth++) {
+		freeMonth(firstKeptMonth);
+	}
+}
+
+size_t DoseSketchQuantiles(uint8_t examType, const Date* startDate, const Date* endDate,
+                           const double quantiles[], size_t nrOfQuantiles, uint16_t doses[])
+{
+	if (examType >= NR_OF_EXAM_TYPES) {
+		return 0;
+	}
+	// No doses exist outside the supported range, clip the period to it
+	size_t first = monthsBefore(startDate);
+	size_t end = (endDate->year > LAST_YEAR) ? NR_OF_MONTHS :
+	             (endDate->year < FIRST_YEAR) ? 0 : monthsBefore(endDate) + 1;
+	DoseSketch merged;
+
+	memset(&merged, 0, sizeof(merged));
+	for (size_t index = first; index < end; index++) {
+		if (months[index] == NULL || months[index]->perType[examType] == NULL) {
+			continue;
+		}
+		const DoseSketch* sketch = months[index]->perType[examType];
+		for (size_t bucket = 0; bucket < NR_OF_BUCKETS; bucket++) {
+			merged.buckets[bucket] += sketch->buckets[bucket];
+		}
+		merged.count += sketch->count;
+	}
+	if (merged.count == 0) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < nrOfQuantiles; i++) {
+		// The dose at this rank (0 based) in the sorted doses is the quantile
+		uint32_t rank = (uint32_t)(quantiles[i] * (merged.count - 1) + 0.5);
+		uint32_t seen = 0;
+		size_t bucket = 0;
+		while (bucket < NR_OF_BUCKETS - 1 && seen + merged.buckets[bucket] <= rank) {
+			seen += merged.buckets[bucket++];
+		}
+		doses[i] = bucketValue(bucket);
+	}
+	return merged.count;
+}
+
+size_t DoseSketchBytes(void)
+{
+	return sizeof(months) + allocatedBytes;
+}
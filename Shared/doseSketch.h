@@ -0,0 +1,58 @@
+#ifndef DOSESKETCH_H
+#define DOSESKETCH_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "doseAdmin.h"
+
+// Internal to the Shared module: dose distributions per examination type and month.
+// Each distribution is a histogram over logarithmically sized buckets: every dose in a
+// bucket lies within DOSE_SKETCH_ACCURACY of the bucket's representative value, so a 
+// quantile has a bounded relative error. Histograms merge by adding counts.
+#define DOSE_SKETCH_ACCURACY (0.01)
+
+
+/***************************************************************************************
+ * Counts a dose in the distribution of its examination type and month
+ * 
+ * Returns false when allocation of memory failed, or the date or examType is outside 
+ * the supported range
+ */
+bool DoseSketchAdd(const Date* date, uint8_t examType, uint16_t dose);
+
+
+/***************************************************************************************
+ * Removes a dose that was counted with DoseSketchAdd
+ */
+void DoseSketchRemove(const Date* date, uint8_t examType, uint16_t dose);
+
+
+/***************************************************************************************
+ * Forgets all distributions
+ */
+void DoseSketchClear(void);
+
+
+/***************************************************************************************
+ * Forgets the distributions of all months before the month of horizon, of all months
+ * for a horizon after the supported range
+ */
+void DoseSketchDropBefore(const Date* horizon);
+
+
+/***************************************************************************************
+ * Merges the distributions of examType for the months from startDate up to and 
+ * including the month of endDate, and fills doses[i] with quantile quantiles[i].
+ * 
+ * Returns the number of doses in the merged distribution, doses is not filled when 0
+ */
+size_t DoseSketchQuantiles(uint8_t examType, const Date* startDate, const Date* endDate,
+                           const double quantiles[], size_t nrOfQuantiles, uint16_t doses[]);
+
+
+/***************************************************************************************
+ * Returns the bytes allocated for the distributions
+ */
+size_t DoseSketchBytes(void);
+
+#endif
@@ -0,0 +1,98 @@
+#include "nameHash.h"
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define FNV_OFFSET_BASIS (14695981039346656037ULL)
+#define FNV_PRIME        (1099511628211ULL)
+// Characters summed for the table entry, as hashFunction in doseAdmin.c does
+#define BUCKET_CHARACTERS (5)
+#define MISSING_CHARACTER (255)
+
+uint64_t NameHash(const char* name)
+{
+	uint64_t hash = FNV_OFFSET_BASIS;
+
+	for (const unsigned char* c = (const unsigned char*)name; *c != '\0'; c++) {
+		hash = (hash ^ *c) * FNV_PRIME;
+	}
+	return hash;
+}
+
+size_t NameSlotSize(size_t length)
+{
+	return ((length + NAME_SLOT_CHUNK) / NAME_SLOT_CHUNK) * NAME_SLOT_CHUNK;
+}
+
+#ifdef __SSE2__
+
+static uint8_t slotBucket(const char* slot)
+{
+	// Zeros behind the name become 255, then the first five bytes are summed
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i firstFive = _mm_set_epi32(0, 0, 0xFF, -1);
+	__m128i bytes = _mm_loadu_si128((const __m128i*)slot);
+	bytes = _mm_or_si128(bytes, _mm_cmpeq_epi8(bytes, zero));
+	__m128i sums = _mm_sad_epu8(_mm_and_si128(bytes, firstFive), zero);
+	return (uint8_t)(_mm_cvtsi128_si32(sums) % HASHTABLE_SIZE);
+}
+
+bool NameKeyEquals(const NameKey* key, const char* slot)
+{
+	size_t last = key->length - key->length % NAME_SLOT_CHUNK;
+
+	// A stored name that is shorter differs at the latest in its last (zero padded)
+	// chunk, so no chunk behind its slot is read
+	for (size_t offset = 0;; offset += NAME_SLOT_CHUNK) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(key->slot + offset));
+		__m128i b = _mm_loadu_si128((const __m128i*)(slot + offset));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF) {
+			return false;
+		}
+		if (offset == last) {
+			return true;
+		}
+	}
+}
+
+#else
+
+static uint8_t slotBucket(const char* slot)
+{
+	unsigned long sum = 0;
+	for (size_t i = 0; i < BUCKET_CHARACTERS; i++) {
+		sum += (slot[i] != '\0') ? (unsigned char)slot[i] : MISSING_CHARACTER;
+	}
+	return (uint8_t)(sum % HASHTABLE_SIZE);
+}
+
+bool NameKeyEquals(const NameKey* key, const char* slot)
+{
+	return memcmp(key->slot, slot, NameSlotSize(key->length)) == 0;
+}
+
+#endif
+
+bool MakeNameKey(const char* name, NameKey* key)
+{
+	uint64_t hash = FNV_OFFSET_BASIS;
+	size_t length = 0;
+
+	// Hashed while the terminator is searched; no byte behind it is read, the caller's
+	// string may end right there
+	while (length < MAX_PATIENTNAME_SIZE && name[length] != '\0') {
+		hash = (hash ^ (unsigned char)name[length]) * FNV_PRIME;
+		length++;
+	}
+	if (length >= MAX_PATIENTNAME_SIZE) {
+		return false;
+	}
+
+	memset(key->slot, 0, NAME_KEY_SIZE);
+	memcpy(key->slot, name, length);
+	key->length = length;
+	key->bucket = slotBucket(key->slot);
+	key->hash = hash;
+	return true;
+}
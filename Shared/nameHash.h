@@ -0,0 +1,55 @@
+#ifndef NAMEHASH_H
+#define NAMEHASH_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "doseAdmin.h"
+
+// Internal to the Shared module: hash of a whole patient name, for the structures that
+// need more than the 8-bit hash of the table (lookup filter, shared registry), and the
+// lookup key every entry point makes of the name it is passed.
+//
+// Names are kept in slots: the name zero padded to a multiple of NAME_SLOT_CHUNK bytes.
+// Two slots are compared a chunk at a time (SSE2 when available) without looking for
+// the terminator, the padding makes a shorter name differ within its own slot.
+#define NAME_SLOT_CHUNK (16)
+#define NAME_KEY_SIZE   (((MAX_PATIENTNAME_SIZE + NAME_SLOT_CHUNK - 1) / NAME_SLOT_CHUNK) * NAME_SLOT_CHUNK)
+
+typedef struct {
+	size_t   length;               // strlen of the name
+	uint64_t hash;                 // NameHash of the name
+	uint8_t  bucket;               // hash table entry, hashFunction of the name
+	char     slot[NAME_KEY_SIZE];  // the name, zero padded
+} NameKey;
+
+
+/***************************************************************************************
+ * Returns the 64-bit FNV-1a hash of a \0 terminated name
+ */
+uint64_t NameHash(const char* name);
+
+
+/***************************************************************************************
+ * Makes the lookup key of a name: the name is hashed while its terminator is searched,
+ * then copied into the zeroed slot, the table entry is computed from the slot. No byte 
+ * behind the terminator is read.
+ *
+ * Returns false when the name does not fit in MAX_PATIENTNAME_SIZE
+ */
+bool MakeNameKey(const char* name, NameKey* key);
+
+
+/***************************************************************************************
+ * Returns the size of the slot for a name of length characters: the name, its
+ * terminator and zero padding up to a multiple of NAME_SLOT_CHUNK
+ */
+size_t NameSlotSize(size_t length);
+
+
+/***************************************************************************************
+ * Compares a key with a name stored in a slot (zero padded to NameSlotSize of its
+ * length, or longer)
+ */
+bool NameKeyEquals(const NameKey* key, const char* slot);
+
+#endif
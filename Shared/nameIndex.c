@@ -0,0 +1,288 @@
+#include "nameIndex.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	uint16_t count;     // names in the block
+	uint16_t size;      // bytes of data
+	uint16_t capacity;  // bytes allocated for data
+	uint8_t  data[];    // per name: shared prefix length, suffix length, suffix
+} NameBlock;
+
+// Blocks in name order: every name in a block sorts before the first of the next
+static NameBlock** blocks = NULL;
+static size_t nrOfBlocks = 0;
+static size_t blockCapacity = 0;
+static size_t allocatedBytes = 0;
+
+
+/**
+ * @brief Decodes the next name of a block into name, which holds the previous name.
+ * @return the number of bytes read
+ */
+static size_t decodeName(const uint8_t* data, char name[MAX_PATIENTNAME_SIZE])
+{
+	uint8_t shared = data[0];
+	uint8_t suffix = data[1];
+
+	memcpy(name + shared, data + 2, suffix);
+	name[shared + suffix] = '\0';
+	return 2 + (size_t)suffix;
+}
+
+static size_t decodeBlock(const NameBlock* block, char names[][MAX_PATIENTNAME_SIZE])
+{
+	const uint8_t* data = block->data;
+
+	for (uint16_t i = 0; i < block->count; i++) {
+		if (i > 0) {
+			memcpy(names[i], names[i - 1], MAX_PATIENTNAME_SIZE);
+		}
+		data += decodeName(data, names[i]);
+	}
+	return block->count;
+}
+
+/**
+ * @brief Front codes names into data.
+ * @return the number of bytes written
+ */
+static size_t encodeNames(char names[][MAX_PATIENTNAME_SIZE], size_t count, uint8_t* data)
+{
+	size_t size = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		size_t shared = 0;
+		if (i > 0) {
+			while (names[i][shared] != '\0' && names[i][shared] == names[i - 1][shared]) {
+				shared++;
+			}
+		}
+		size_t suffix = strlen(names[i] + shared);
+		data[size++] = (uint8_t)shared;
+		data[size++] = (uint8_t)suffix;
+		memcpy(data + size, names[i] + shared, suffix);
+		size += suffix;
+	}
+	return size;
+}
+
+/**
+ * @brief Front codes names into a new block.
+ * @return NULL when memory allocation failed
+ */
+static NameBlock* encodeBlock(char names[][MAX_PATIENTNAME_SIZE], size_t count)
+{
+	uint8_t data[NAME_BLOCK_SIZE * (2 + MAX_PATIENTNAME_SIZE)];
+	size_t size = encodeNames(names, count, data);
+
+	NameBlock* block = malloc(sizeof(NameBlock) + size);
+	if (block == NULL) {
+		return NULL;
+	}
+	block->count = (uint16_t)count;
+	block->size = (uint16_t)size;
+	block->capacity = (uint16_t)size;
+	memcpy(block->data, data, size);
+	return block;
+}
+
+static void freeBlock(NameBlock* block)
+{
+	allocatedBytes -= sizeof(NameBlock) + block->capacity;
+	free(block);
+}
+
+static void useBlock(size_t index, NameBlock* block)
+{
+	allocatedBytes += sizeof(NameBlock) + block->capacity;
+	blocks[index] = block;
+}
+
+/**
+ * @brief Compares name with the first name of a block, which is stored unshared.
+ */
+static int compareFirst(const char* name, const NameBlock* block)
+{
+	size_t length = block->data[1];
+	int result = strncmp(name, (const char*)block->data + 2, length);
+	if (result != 0) {
+		return result;
+	}
+	return (name[length] != '\0') ? 1 : 0;
+}
+
+/**
+ * @brief Returns the block name belongs in: the last block whose first name is not 
+ *        greater than name, or block 0.
+ */
+static size_t findBlock(const char* name)
+{
+	size_t low = 0;
+	size_t high = nrOfBlocks;
+
+	while (high - low > 1) {
+		size_t mid = low + (high - low) / 2;
+		if (compareFirst(name, blocks[mid]) < 0) {
+			high = mid;
+		}
+		else {
+			low = mid;
+		}
+	}
+	return low;
+}
+
+static bool insertBlocks(size_t index, size_t nrOfNewBlocks)
+{
+	if (nrOfBlocks + nrOfNewBlocks > blockCapacity) {
+		size_t capacity = (blockCapacity == 0) ? 16 : 2 * blockCapacity;
+		NameBlock** grown = realloc(blocks, capacity * sizeof(NameBlock*));
+		if (grown == NULL) {
+			return false;
+		}
+		allocatedBytes += (capacity - blockCapacity) * sizeof(NameBlock*);
+		blocks = grown;
+		blockCapacity = capacity;
+	}
+	memmove(&blocks[index + nrOfNewBlocks], &blocks[index],
+	        (nrOfBlocks - index) * sizeof(NameBlock*));
+	nrOfBlocks += nrOfNewBlocks;
+	return true;
+}
+
+bool NameIndexAdd(const char* name)
+{
+	char names[NAME_BLOCK_SIZE + 1][MAX_PATIENTNAME_SIZE];
+
+	if (nrOfBlocks == 0) {
+		strcpy(names[0], name);
+		NameBlock* block = encodeBlock(names, 1);
+		if (block == NULL || !insertBlocks(0, 1)) {
+			free(block);
+			return false;
+		}
+		useBlock(0, block);
+		return true;
+	}
+
+	size_t index = findBlock(name);
+	size_t count = decodeBlock(blocks[index], names);
+	size_t position = 0;
+	while (position < count && strcmp(names[position], name) < 0) {
+		position++;
+	}
+	memmove(names[position + 1], names[position], (count - position) * MAX_PATIENTNAME_SIZE);
+	strcpy(names[position], name);
+	count++;
+
+	if (count <= NAME_BLOCK_SIZE) {
+		NameBlock* block = encodeBlock(names, count);
+		if (block == NULL) {
+			return false;
+		}
+		freeBlock(blocks[index]);
+		useBlock(index, block);
+		return true;
+	}
+
+	// A full block is split in two halves
+	size_t half = count / 2;
+	NameBlock* low = encodeBlock(names, half);
+	NameBlock* high = encodeBlock(names + half, count - half);
+	if (low == NULL || high == NULL || !insertBlocks(index + 1, 1)) {
+		free(low);
+		free(high);
+		return false;
+	}
+	freeBlock(blocks[index]);
+	useBlock(index, low);
+	useBlock(index + 1, high);
+	return true;
+}
+
+void NameIndexRemove(const char* name)
+{
+	char names[NAME_BLOCK_SIZE][MAX_PATIENTNAME_SIZE];
+
+	if (nrOfBlocks == 0) {
+		return;
+	}
+	size_t index = findBlock(name);
+	size_t count = decodeBlock(blocks[index], names);
+	size_t position = 0;
+	while (position < count && strcmp(names[position], name) != 0) {
+		position++;
+	}
+	if (position == count) {
+		return;
+	}
+	memmove(names[position], names[position + 1], (count - position - 1) * MAX_PATIENTNAME_SIZE);
+	count--;
+
+	NameBlock* block = blocks[index];
+	if (count > 0) {
+		// Without the name the block never grows: the prefix the next name loses is 
+		// at most the suffix stored for the removed name. So it is rewritten in place.
+		uint8_t data[NAME_BLOCK_SIZE * (2 + MAX_PATIENTNAME_SIZE)];
+		block->size = (uint16_t)encodeNames(names, count, data);
+		block->count = (uint16_t)count;
+		memcpy(block->data, data, block->size);
+
+		NameBlock* shrunk = realloc(block, sizeof(NameBlock) + block->size);
+		if (shrunk != NULL) {
+			allocatedBytes -= shrunk->capacity - shrunk->size;
+			shrunk->capacity = shrunk->size;
+			blocks[index] = shrunk;
+		}
+		return;
+	}
+
+	freeBlock(block);
+	memmove(&blocks[index], &blocks[index + 1], (nrOfBlocks - index - 1) * sizeof(NameBlock*));
+	if (--nrOfBlocks == 0) {
+		NameIndexClear();
+	}
+}
+
+void NameIndexClear(void)
+{
+	for (size_t i = 0; i < nrOfBlocks; i++) {
+		free(blocks[i]);
+	}
+	free(blocks);
+	blocks = NULL;
+	nrOfBlocks = 0;
+	blockCapacity = 0;
+	allocatedBytes = 0;
+}
+
+size_t NameIndexFind(const char* prefix, char names[][MAX_PATIENTNAME_SIZE], size_t maxNrOfNames)
+{
+	size_t prefixLength = strlen(prefix);
+	size_t found = 0;
+	char name[MAX_PATIENTNAME_SIZE];
+
+	if (nrOfBlocks == 0) {
+		return 0;
+	}
+	for (size_t index = findBlock(prefix); index < nrOfBlocks && found < maxNrOfNames; index++) {
+		const uint8_t* data = blocks[index]->data;
+		for (uint16_t i = 0; i < blocks[index]->count && found < maxNrOfNames; i++) {
+			data += decodeName(data, name);
+			int order = strncmp(name, prefix, prefixLength);
+			if (order > 0) {
+				return found; // past all names with the prefix
+			}
+			if (order == 0) {
+				strcpy(names[found++], name);
+			}
+		}
+	}
+	return found;
+}
+
+size_t NameIndexBytes(void)
+{
+	return allocatedBytes;
+}
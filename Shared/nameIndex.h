@@ -0,0 +1,48 @@
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "doseAdmin.h"
+
+// Internal to the Shared module: all patient names in sorted order, for prefix search.
+// Names are kept in blocks of up to NAME_BLOCK_SIZE names. Within a block every name 
+// is stored as the length of the prefix it shares with the previous name and the rest
+// of the name (front coding); a sorted directory of the blocks is binary searched.
+#define NAME_BLOCK_SIZE (32)
+
+
+/***************************************************************************************
+ * Adds a name to the index
+ * 
+ * Returns false when allocation of memory failed, the index is unchanged in that case
+ */
+bool NameIndexAdd(const char* name);
+
+
+/***************************************************************************************
+ * Removes a name from the index, if present
+ */
+void NameIndexRemove(const char* name);
+
+
+/***************************************************************************************
+ * Frees all names
+ */
+void NameIndexClear(void);
+
+
+/***************************************************************************************
+ * Copies the first (in name order) maxNrOfNames names that start with prefix to names
+ * 
+ * Returns the number of names copied
+ */
+size_t NameIndexFind(const char* prefix, char names[][MAX_PATIENTNAME_SIZE], size_t maxNrOfNames);
+
+
+/***************************************************************************************
+ * Returns the bytes allocated by the index
+ */
+size_t NameIndexBytes(void);
+
+#endif
@@ -0,0 +1,378 @@
+#include "patientArchive.h"
+#include <stdlib.h>
+#include <string.h>
+#include "calendar.h"
+#include "varint.h"
+
+#define ARCHIVE_MAGIC      "DOSEARC1"
+#define MAGIC_SIZE         (8)
+#define TRAILER_SIZE       (8 + 4 + MAGIC_SIZE) // footer offset, number of blocks, magic
+#define EXAM_TYPE_BITS     (3)
+#define EXAM_TYPE_MASK     ((1u << EXAM_TYPE_BITS) - 1)
+// Prefix and suffix length, suffix, number of doses, doses
+#define MAX_RECORD_SIZE    (3 * MAX_VARINT_SIZE + MAX_PATIENTNAME_SIZE + \
+                            MAX_DOSES_PER_PATIENT * 2 * MAX_VARINT_SIZE)
+#define INITIAL_FOOTER_SIZE (1024)
+
+// Entry of the block index, read from the footer
+typedef struct {
+	uint64_t offset;
+	uint32_t size;
+	char     firstName[MAX_PATIENTNAME_SIZE];
+} ArchiveBlock;
+
+
+static void putUint64(uint8_t* out, uint64_t value)
+{
+	for (int i = 0; i < 8; i++) {
+		out[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+static uint64_t getUint64(const uint8_t* in)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < 8; i++) {
+		value |= (uint64_t)in[i] << (8 * i);
+	}
+	return value;
+}
+
+static size_t commonPrefix(const char* a, const char* b)
+{
+	size_t length = 0;
+	while (a[length] != '\0' && a[length] == b[length]) {
+		length++;
+	}
+	return length;
+}
+
+/**
+ * @brief Encodes a patient against the previous name of the block, returns the size.
+ */
+static size_t encodeRecord(const char* previousName, const char* name, const DoseData doses[],
+                           size_t nrOfDoses, uint8_t* out)
+{
+	size_t prefix = commonPrefix(name, previousName);
+	size_t suffix = strlen(name) - prefix;
+	size_t size = 0;
+	uint32_t previousDay = 0;
+
+	size += EncodeVarint((uint32_t)prefix, out + size);
+	size += EncodeVarint((uint32_t)suffix, out + size);
+	memcpy(out + size, name + prefix, suffix);
+	size += suffix;
+	size += EncodeVarint((uint32_t)nrOfDoses, out + size);
+	for (size_t i = 0; i < nrOfDoses; i++) {
+		uint32_t day = DateToDayNumber(&doses[i].date);
+		size += EncodeVarint(ZigZagEncode((int32_t)(day - previousDay)), out + size);
+		size += EncodeVarint(((uint32_t)doses[i].dose << EXAM_TYPE_BITS) | doses[i].examType,
+		                     out + size);
+		previousDay = day;
+	}
+	return size;
+}
+
+static bool appendFooter(ArchiveWriter* writer, const uint8_t* bytes, size_t size)
+{
+	if (writer->footerSize + size > writer->footerCapacity) {
+		size_t capacity = (writer->footerCapacity == 0) ? INITIAL_FOOTER_SIZE
+		                                                : 2 * writer->footerCapacity;
+		uint8_t* footer = realloc(writer->footer, capacity);
+		if (footer == NULL) {
+			return false;
+		}
+		writer->footer = footer;
+		writer->footerCapacity = capacity;
+	}
+	memcpy(writer->footer + writer->footerSize, bytes, size);
+	writer->footerSize += size;
+	return true;
+}
+
+/**
+ * @brief Writes the current block and adds it to the footer.
+ */
+static void flushBlock(ArchiveWriter* writer)
+{
+	uint8_t entry[2 * MAX_VARINT_SIZE + MAX_PATIENTNAME_SIZE];
+
+	if (writer->used == 0) {
+		return;
+	}
+	size_t length = strlen(writer->firstName);
+	size_t size = EncodeVarint((uint32_t)length, entry);
+	memcpy(entry + size, writer->firstName, length);
+	size += length;
+	size += EncodeVarint((uint32_t)writer->used, entry + size);
+	if (fwrite(writer->block, 1, writer->used, writer->file) != writer->used ||
+	    !appendFooter(writer, entry, size)) {
+		writer->failed = true;
+	}
+	writer->offset += writer->used;
+	writer->nrOfBlocks++;
+	writer->used = 0;
+	writer->previousName[0] = '\0';
+}
+
+bool ArchiveWriterOpen(ArchiveWriter* writer, const char* filePath)
+{
+	memset(writer, 0, sizeof(*writer));
+	writer->file = fopen(filePath, "wb");
+	if (writer->file == NULL) {
+		return false;
+	}
+	writer->failed = fwrite(ARCHIVE_MAGIC, 1, MAGIC_SIZE, writer->file) != MAGIC_SIZE;
+	writer->offset = MAGIC_SIZE;
+	return true;
+}
+
+void ArchiveWriterAdd(ArchiveWriter* writer, const char* name, const DoseData doses[],
+                      size_t nrOfDoses)
+{
+	uint8_t record[MAX_RECORD_SIZE];
+	size_t size = encodeRecord(writer->previousName, name, doses, nrOfDoses, record);
+
+	if (writer->used + size > ARCHIVE_BLOCK_SIZE) {
+		// A block starts with a complete name
+		flushBlock(writer);
+		size = encodeRecord(writer->previousName, name, doses, nrOfDoses, record);
+	}
+	if (writer->used == 0) {
+		strcpy(writer->firstName, name);
+	}
+	memcpy(writer->block + writer->used, record, size);
+	writer->used += size;
+	strcpy(writer->previousName, name);
+}
+
+bool ArchiveWriterClose(ArchiveWriter* writer)
+{
+	uint8_t trailer[TRAILER_SIZE];
+
+	flushBlock(writer);
+	putUint64(trailer, writer->offset);
+	for (int i = 0; i < 4; i++) {
+		trailer[8 + i] = (uint8_t)(writer->nrOfBlocks >> (8 * i));
+	}
+	memcpy(trailer + 12, ARCHIVE_MAGIC, MAGIC_SIZE);
+	if (fwrite(writer->footer, 1, writer->footerSize, writer->file) != writer->footerSize ||
+	    fwrite(trailer, 1, TRAILER_SIZE, writer->file) != TRAILER_SIZE) {
+		writer->failed = true;
+	}
+	if (fclose(writer->file) != 0) {
+		writer->failed = true;
+	}
+	free(writer->footer);
+	writer->footer = NULL;
+	return !writer->failed;
+}
+
+/**
+ * @brief Reads the block index from the footer. Returns the values of ArchiveOpen.
+ */
+static int8_t readIndex(FILE* file, long fileSize, PatientArchive* archive)
+{
+	uint8_t trailer[TRAILER_SIZE];
+
+	if (fseek(file, fileSize - TRAILER_SIZE, SEEK_SET) != 0 ||
+	    fread(trailer, 1, TRAILER_SIZE, file) != TRAILER_SIZE ||
+	    memcmp(trailer + 12, ARCHIVE_MAGIC, MAGIC_SIZE) != 0) {
+		return -1;
+	}
+	uint64_t footerOffset = getUint64(trailer);
+	uint32_t nrOfBlocks = 0;
+	for (int i = 0; i < 4; i++) {
+		nrOfBlocks |= (uint32_t)trailer[8 + i] << (8 * i);
+	}
+	if (footerOffset < MAGIC_SIZE || footerOffset > (uint64_t)(fileSize - TRAILER_SIZE)) {
+		return -1;
+	}
+	size_t footerSize = (size_t)((uint64_t)(fileSize - TRAILER_SIZE) - footerOffset);
+	if (nrOfBlocks > footerSize / 2) {
+		return -1; // An entry takes at least two bytes
+	}
+
+	uint8_t* footer = malloc(footerSize + 1);
+	ArchiveBlock* blocks = malloc((nrOfBlocks + 1) * sizeof(ArchiveBlock));
+	if (footer == NULL || blocks == NULL) {
+		free(footer);
+		free(blocks);
+		return -2;
+	}
+	bool valid = fseek(file, (long)footerOffset, SEEK_SET) == 0 &&
+	             fread(footer, 1, footerSize, file) == footerSize;
+
+	const uint8_t* p = footer;
+	const uint8_t* end = footer + footerSize;
+	uint64_t offset = MAGIC_SIZE;
+	for (uint32_t i = 0; valid && i < nrOfBlocks; i++) {
+		uint32_t length, size;
+		size_t read = DecodeVarintBounded(p, end, &length);
+		valid = read > 0 && length < MAX_PATIENTNAME_SIZE && (size_t)(end - p - read) >= length;
+		if (valid) {
+			memcpy(blocks[i].firstName, p + read, length);
+			blocks[i].firstName[length] = '\0';
+			p += read + length;
+			read = DecodeVarintBounded(p, end, &size);
+			p += read;
+			valid = read > 0 && size > 0 && size <= ARCHIVE_BLOCK_SIZE &&
+			        offset + size <= footerOffset;
+		}
+		if (valid) {
+			blocks[i].offset = offset;
+			blocks[i].size = size;
+			offset += size;
+		}
+	}
+	free(footer);
+	if (!valid) {
+		free(blocks);
+		return -1;
+	}
+	archive->blocks = blocks;
+	archive->nrOfBlocks = nrOfBlocks;
+	return 0;
+}
+
+int8_t ArchiveOpen(const char* filePath, PatientArchive* archive)
+{
+	uint8_t magic[MAGIC_SIZE];
+
+	memset(archive, 0, sizeof(*archive));
+	FILE* file = fopen(filePath, "rb");
+	if (file == NULL) {
+		return -1;
+	}
+	long fileSize = -1;
+	if (fseek(file, 0, SEEK_END) == 0) {
+		fileSize = ftell(file);
+	}
+	if (fileSize < MAGIC_SIZE + TRAILER_SIZE || fseek(file, 0, SEEK_SET) != 0 ||
+	    fread(magic, 1, MAGIC_SIZE, file) != MAGIC_SIZE ||
+	    memcmp(magic, ARCHIVE_MAGIC, MAGIC_SIZE) != 0) {
+		fclose(file);
+		return -1; // Not an archive
+	}
+	int8_t result = readIndex(file, fileSize, archive);
+	if (result != 0) {
+		fclose(file);
+		return result;
+	}
+
+	archive->buffer = malloc(ARCHIVE_BLOCK_SIZE);
+	if (archive->buffer == NULL) {
+		free(archive->blocks);
+		archive->blocks = NULL;
+		fclose(file);
+		return -2;
+	}
+	archive->file = file;
+	archive->cachedBlock = archive->nrOfBlocks;
+	return 0;
+}
+
+void ArchiveClose(PatientArchive* archive)
+{
+	if (archive->file != NULL) {
+		fclose(archive->file);
+	}
+	free(archive->blocks);
+	free(archive->buffer);
+	memset(archive, 0, sizeof(*archive));
+}
+
+/**
+ * @brief Reads a block into the buffer, unless it is there already.
+ */
+static bool loadBlock(PatientArchive* archive, uint32_t block)
+{
+	const ArchiveBlock* entry = &((const ArchiveBlock*)archive->blocks)[block];
+
+	if (archive->cachedBlock == block) {
+		return true;
+	}
+	archive->cachedBlock = archive->nrOfBlocks;
+	if (fseek(archive->file, (long)entry->offset, SEEK_SET) != 0 ||
+	    fread(archive->buffer, 1, entry->size, archive->file) != entry->size) {
+		return false;
+	}
+	archive->cachedBlock = block;
+	return true;
+}
+
+int8_t ArchiveFind(PatientArchive* archive, const char* name,
+                   DoseData doses[MAX_DOSES_PER_PATIENT], size_t* nrOfDoses)
+{
+	const ArchiveBlock* blocks = archive->blocks;
+
+	*nrOfDoses = 0;
+	// The last block whose first name is not after name
+	uint32_t low = 0;
+	uint32_t high = archive->nrOfBlocks;
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		if (strcmp(blocks[middle].firstName, name) <= 0) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	if (low == 0) {
+		return -1; // Before the first name of the archive
+	}
+	uint32_t block = low - 1;
+	if (!loadBlock(archive, block)) {
+		return -3;
+	}
+
+	const uint8_t* p = archive->buffer;
+	const uint8_t* end = p + blocks[block].size;
+	char current[MAX_PATIENTNAME_SIZE] = "";
+	size_t length = 0;
+	while (p < end) {
+		uint32_t prefix, suffix, count, delta, value;
+		size_t read = DecodeVarintBounded(p, end, &prefix);
+		size_t read2 = (read > 0) ? DecodeVarintBounded(p + read, end, &suffix) : 0;
+		if (read2 == 0 || prefix > length || prefix + suffix >= MAX_PATIENTNAME_SIZE ||
+		    (size_t)(end - p - read - read2) < suffix) {
+			return -3; // Damaged block
+		}
+		p += read + read2;
+		memcpy(current + prefix, p, suffix);
+		p += suffix;
+		length = prefix + suffix;
+		current[length] = '\0';
+
+		int order = strcmp(current, name);
+		if (order > 0) {
+			return -1; // Names are sorted, it would have been here
+		}
+		read = DecodeVarintBounded(p, end, &count);
+		if (read == 0 || count > MAX_DOSES_PER_PATIENT) {
+			return -3;
+		}
+		p += read;
+		uint32_t day = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			read = DecodeVarintBounded(p, end, &delta);
+			read2 = (read > 0) ? DecodeVarintBounded(p + read, end, &value) : 0;
+			if (read2 == 0) {
+				return -3;
+			}
+			p += read + read2;
+			if (order == 0) {
+				day += (uint32_t)ZigZagDecode(delta);
+				DayNumberToDate(day, &doses[i].date);
+				doses[i].dose = (uint16_t)(value >> EXAM_TYPE_BITS);
+				doses[i].examType = (uint8_t)(value & EXAM_TYPE_MASK);
+			}
+		}
+		if (order == 0) {
+			*nrOfDoses = count;
+			return 0;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,78 @@
+#ifndef PATIENTARCHIVE_H
+#define PATIENTARCHIVE_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "doseAdmin.h"
+
+// Internal to the Shared module: archive file of patients in name order, from which a
+// single patient is read without loading the registry. The patients are stored in
+// blocks of at most ARCHIVE_BLOCK_SIZE bytes. Within a block every name is front coded
+// against the name before it and the doses are encoded as for encoded patients (zigzag
+// varint day number deltas, varint doses with the examination type in the low bits).
+// The footer lists the first name and the size of every block, so a lookup reads and
+// decodes exactly one block.
+//
+// File: magic, blocks, footer, trailer (footer offset, number of blocks, magic). All
+// numbers are little endian.
+#define ARCHIVE_BLOCK_SIZE (4096)
+
+
+typedef struct {
+	FILE*    file;
+	uint8_t  block[ARCHIVE_BLOCK_SIZE];
+	size_t   used;                               // bytes of block in use
+	char     firstName[MAX_PATIENTNAME_SIZE];    // first name in block
+	char     previousName[MAX_PATIENTNAME_SIZE]; // name the next one is coded against
+	uint8_t* footer;
+	size_t   footerSize;
+	size_t   footerCapacity;
+	uint64_t offset;                             // file position of block
+	uint32_t nrOfBlocks;
+	bool     failed;
+} ArchiveWriter;
+
+
+/***************************************************************************************
+ * Creates (or truncates) the archive file
+ *
+ * Returns false when the file cannot be created
+ */
+bool ArchiveWriterOpen(ArchiveWriter* writer, const char* filePath);
+
+
+/***************************************************************************************
+ * Adds a patient. The names must come in ascending strcmp order.
+ */
+void ArchiveWriterAdd(ArchiveWriter* writer, const char* name, const DoseData doses[],
+                      size_t nrOfDoses);
+
+
+/***************************************************************************************
+ * Writes the last block and the footer and closes the file
+ *
+ * Returns false when writing or allocation of memory failed at any point
+ */
+bool ArchiveWriterClose(ArchiveWriter* writer);
+
+
+/***************************************************************************************
+ * Reader side, see OpenArchive and CloseArchive
+ */
+int8_t ArchiveOpen(const char* filePath, PatientArchive* archive);
+
+void ArchiveClose(PatientArchive* archive);
+
+
+/***************************************************************************************
+ * Copies the doses of a patient
+ *
+ * Returns  0 when doses and nrOfDoses are filled
+ * Returns -1 when the patient is not in the archive
+ * Returns -3 when the block cannot be read or is damaged
+ */
+int8_t ArchiveFind(PatientArchive* archive, const char* name,
+                   DoseData doses[MAX_DOSES_PER_PATIENT], size_t* nrOfDoses);
+
+#endif
@@ -0,0 +1,177 @@
+#include "patientNumberIndex.h"
+#include <stdlib.h>
+
+#define INITIAL_CAPACITY (64)
+#define FIBONACCI_FACTOR (11400714819323198485ULL)
+
+// Number of a patient by its id, 0 as patient id marks an empty slot
+typedef struct {
+	uint32_t patientId;
+	uint64_t patientNumber;
+} IdEntry;
+
+// Both tables use linear probing and have the same power of two capacity
+static PatientNumberEntry* numbers = NULL;
+static IdEntry* ids = NULL;
+static size_t capacity = 0;
+static size_t count = 0;
+
+
+static size_t numberSlot(uint64_t patientNumber)
+{
+	// Fibonacci hashing: numbers handed out in sequence spread over the table
+	return (size_t)((patientNumber * FIBONACCI_FACTOR) >> 32) & (capacity - 1);
+}
+
+static size_t idSlot(uint32_t patientId)
+{
+	return (size_t)(((uint64_t)patientId * FIBONACCI_FACTOR) >> 32) & (capacity - 1);
+}
+
+static void insertEntry(const PatientNumberEntry* entry)
+{
+	size_t slot = numberSlot(entry->patientNumber);
+	while (numbers[slot].patientNumber != 0) {
+		slot = (slot + 1) & (capacity - 1);
+	}
+	numbers[slot] = *entry;
+
+	slot = idSlot(entry->patientId);
+	while (ids[slot].patientId != 0) {
+		slot = (slot + 1) & (capacity - 1);
+	}
+	ids[slot] = (IdEntry){entry->patientId, entry->patientNumber};
+	count++;
+}
+
+static IdEntry* findId(uint32_t patientId)
+{
+	if (capacity == 0) {
+		return NULL;
+	}
+	for (size_t slot = idSlot(patientId); ids[slot].patientId != 0;
+	     slot = (slot + 1) & (capacity - 1)) {
+		if (ids[slot].patientId == patientId) {
+			return &ids[slot];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Empties a slot of the number table and shifts later entries of the probe
+ *        sequence back into it.
+ */
+static void deleteNumber(size_t hole)
+{
+	for (size_t slot = hole;;) {
+		slot = (slot + 1) & (capacity - 1);
+		if (numbers[slot].patientNumber == 0) {
+			break;
+		}
+		size_t home = numberSlot(numbers[slot].patientNumber);
+		if (((slot - home) & (capacity - 1)) >= ((slot - hole) & (capacity - 1))) {
+			numbers[hole] = numbers[slot];
+			hole = slot;
+		}
+	}
+	numbers[hole].patientNumber = 0;
+}
+
+/**
+ * @brief Same as deleteNumber, for the id table.
+ */
+static void deleteId(size_t hole)
+{
+	for (size_t slot = hole;;) {
+		slot = (slot + 1) & (capacity - 1);
+		if (ids[slot].patientId == 0) {
+			break;
+		}
+		size_t home = idSlot(ids[slot].patientId);
+		if (((slot - home) & (capacity - 1)) >= ((slot - hole) & (capacity - 1))) {
+			ids[hole] = ids[slot];
+			hole = slot;
+		}
+	}
+	ids[hole].patientId = 0;
+}
+
+bool PatientNumberIndexReserve(void)
+{
+	// Keep the load factor below 3/4
+	if ((count + 1) * 4 < capacity * 3) {
+		return true;
+	}
+
+	size_t newCapacity = (capacity == 0) ? INITIAL_CAPACITY : 2 * capacity;
+	PatientNumberEntry* newNumbers = calloc(newCapacity, sizeof(PatientNumberEntry));
+	IdEntry* newIds = calloc(newCapacity, sizeof(IdEntry));
+	if (newNumbers == NULL || newIds == NULL) {
+		free(newNumbers);
+		free(newIds);
+		return false;
+	}
+
+	PatientNumberEntry* oldNumbers = numbers;
+	size_t oldCapacity = capacity;
+	free(ids);
+	numbers = newNumbers;
+	ids = newIds;
+	capacity = newCapacity;
+	count = 0;
+	for (size_t i = 0; i < oldCapacity; i++) {
+		if (oldNumbers[i].patientNumber != 0) {
+			insertEntry(&oldNumbers[i]);
+		}
+	}
+	free(oldNumbers);
+	return true;
+}
+
+void PatientNumberIndexAdd(uint64_t patientNumber, uint32_t patientId, uint8_t bucket)
+{
+	PatientNumberEntry entry = {patientNumber, patientId, 0, NULL, bucket};
+	insertEntry(&entry);
+}
+
+PatientNumberEntry* PatientNumberIndexFind(uint64_t patientNumber)
+{
+	if (capacity == 0 || patientNumber == 0) {
+		return NULL;
+	}
+	for (size_t slot = numberSlot(patientNumber); numbers[slot].patientNumber != 0;
+	     slot = (slot + 1) & (capacity - 1)) {
+		if (numbers[slot].patientNumber == patientNumber) {
+			return &numbers[slot];
+		}
+	}
+	return NULL;
+}
+
+void PatientNumberIndexForget(uint32_t patientId)
+{
+	IdEntry* id = findId(patientId);
+	if (id == NULL) {
+		return;
+	}
+	PatientNumberEntry* entry = PatientNumberIndexFind(id->patientNumber);
+	deleteNumber((size_t)(entry - numbers));
+	deleteId((size_t)(id - ids));
+	count--;
+}
+
+void PatientNumberIndexClear(void)
+{
+	free(numbers);
+	free(ids);
+	numbers = NULL;
+	ids = NULL;
+	capacity = 0;
+	count = 0;
+}
+
+size_t PatientNumberIndexBytes(void)
+{
+	return capacity * (sizeof(PatientNumberEntry) + sizeof(IdEntry));
+}
@@ -0,0 +1,54 @@
+#ifndef PATIENTNUMBERINDEX_H
+#define PATIENTNUMBERINDEX_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Internal to the Shared module: patient number -> patient, for the systems that address
+// patients by a number instead of a name. Open addressing on the 64-bit number, with a
+// second table patient id -> number so removal by name can drop the number too. The
+// entry holds the table entry of the patient and caches the link to it, so a lookup
+// never hashes or compares a name.
+typedef struct {
+	uint64_t patientNumber;  // 0 marks an empty slot
+	uint32_t patientId;
+	uint32_t layoutVersion;  // layout for which link is valid
+	void*    link;           // cached Patient** in the table, NULL when not known
+	uint8_t  bucket;         // hash table entry of the patient
+} PatientNumberEntry;
+
+
+/***************************************************************************************
+ * Makes room for one more patient number, so the next PatientNumberIndexAdd can not fail
+ *
+ * Returns false when allocation of memory failed
+ */
+bool PatientNumberIndexReserve(void);
+
+
+/***************************************************************************************
+ * Adds a number for a patient. Room must have been reserved, the number must not be
+ * present and not be 0.
+ */
+void PatientNumberIndexAdd(uint64_t patientNumber, uint32_t patientId, uint8_t bucket);
+
+
+/***************************************************************************************
+ * Returns the entry of a number, NULL when it is not present. The entry stays valid
+ * until the next add or removal.
+ */
+PatientNumberEntry* PatientNumberIndexFind(uint64_t patientNumber);
+
+
+/***************************************************************************************
+ * Removes the number of a patient, if it has one
+ */
+void PatientNumberIndexForget(uint32_t patientId);
+
+
+void PatientNumberIndexClear(void);
+
+
+size_t PatientNumberIndexBytes(void);
+
+#endif
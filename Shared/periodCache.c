@@ -0,0 +1,98 @@
+#include "periodCache.h"
+#include <string.h>
+
+typedef struct {
+	uint32_t patientId;  // 0: empty entry, patient ids start at 1
+	uint32_t startValue;
+	uint32_t endValue;
+	uint32_t totalDose;
+} PeriodCacheEntry;
+
+typedef struct {
+	PeriodCacheEntry ways[PERIOD_CACHE_WAYS];
+	uint8_t nextVictim;  // round robin replacement
+} PeriodCacheSet;
+
+static PeriodCacheSet cacheSets[PERIOD_CACHE_SETS];
+static PeriodCacheStats cacheStats;
+
+
+static PeriodCacheSet* setOf(uint32_t patientId)
+{
+	return &cacheSets[patientId % PERIOD_CACHE_SETS];
+}
+
+void PeriodCacheClear(void)
+{
+	memset(cacheSets, 0, sizeof(cacheSets));
+}
+
+bool PeriodCacheLookup(uint32_t patientId, uint32_t startValue, uint32_t endValue,
+                       uint32_t* totalDose)
+{
+	PeriodCacheSet* set = setOf(patientId);
+
+	for (int i = 0; i < PERIOD_CACHE_WAYS; i++) {
+		PeriodCacheEntry* entry = &set->ways[i];
+		if (entry->patientId == patientId && entry->startValue == startValue &&
+		    entry->endValue == endValue) {
+			*totalDose = entry->totalDose;
+			cacheStats.hits++;
+			return true;
+		}
+	}
+	cacheStats.misses++;
+	return false;
+}
+
+void PeriodCacheStore(uint32_t patientId, uint32_t startValue, uint32_t endValue,
+                      uint32_t totalDose)
+{
+	PeriodCacheSet* set = setOf(patientId);
+	PeriodCacheEntry* victim = NULL;
+
+	// Prefer an empty entry, otherwise replace round robin
+	for (int i = 0; i < PERIOD_CACHE_WAYS && victim == NULL; i++) {
+		if (set->ways[i].patientId == 0) {
+			victim = &set->ways[i];
+		}
+	}
+	if (victim == NULL) {
+		victim = &set->ways[set->nextVictim];
+		set->nextVictim = (uint8_t)((set->nextVictim + 1) % PERIOD_CACHE_WAYS);
+	}
+	victim->patientId = patientId;
+	victim->startValue = startValue;
+	victim->endValue = endValue;
+	victim->totalDose = totalDose;
+}
+
+void PeriodCacheInvalidateDate(uint32_t patientId, uint32_t dateValue)
+{
+	PeriodCacheSet* set = setOf(patientId);
+
+	for (int i = 0; i < PERIOD_CACHE_WAYS; i++) {
+		PeriodCacheEntry* entry = &set->ways[i];
+		if (entry->patientId == patientId && dateValue >= entry->startValue &&
+		    dateValue <= entry->endValue) {
+			entry->patientId = 0;
+			cacheStats.invalidations++;
+		}
+	}
+}
+
+void PeriodCacheInvalidatePatient(uint32_t patientId)
+{
+	PeriodCacheSet* set = setOf(patientId);
+
+	for (int i = 0; i < PERIOD_CACHE_WAYS; i++) {
+		if (set->ways[i].patientId == patientId) {
+			set->ways[i].patientId = 0;
+		}
+	}
+}
+
+void PeriodCacheGetStats(PeriodCacheStats* stats)
+{
+	*stats = cacheStats;
+}
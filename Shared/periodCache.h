@@ -0,0 +1,51 @@
+#ifndef PERIODCACHE_H
+#define PERIODCACHE_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "doseAdmin.h"
+
+// Internal to the Shared module: memoizes PatientDoseInPeriod results.
+// All windows of one patient share one small set, so invalidating a patient only
+// touches PERIOD_CACHE_WAYS entries.
+#define PERIOD_CACHE_SETS  (HASHTABLE_SIZE)
+#define PERIOD_CACHE_WAYS  (4)
+
+
+/***************************************************************************************
+ * Forgets all cached windows, the counters are kept
+ */
+void PeriodCacheClear(void);
+
+
+/***************************************************************************************
+ * Looks up the total of window [startValue, endValue] (dates as YYYYMMDD) of a patient.
+ * Counts a hit or a miss.
+ * 
+ * Returns true and fills totalDose on a hit
+ */
+bool PeriodCacheLookup(uint32_t patientId, uint32_t startValue, uint32_t endValue,
+                       uint32_t* totalDose);
+
+
+/***************************************************************************************
+ * Remembers the total of a window, replacing the oldest window of the patient's set
+ */
+void PeriodCacheStore(uint32_t patientId, uint32_t startValue, uint32_t endValue,
+                      uint32_t totalDose);
+
+
+/***************************************************************************************
+ * Drops the cached windows of the patient that contain dateValue (a new dose date)
+ */
+void PeriodCacheInvalidateDate(uint32_t patientId, uint32_t dateValue);
+
+
+/***************************************************************************************
+ * Drops all cached windows of the patient
+ */
+void PeriodCacheInvalidatePatient(uint32_t patientId);
+
+
+void PeriodCacheGetStats(PeriodCacheStats* stats);
+
+#endif
@@ -0,0 +1,218 @@
+#include "registryLoader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "calendar.h"
+
+#define FIRST_YEAR         (1900)
+#define LAST_YEAR          (2500)
+// Below this many bytes per part, starting a thread costs more than it saves
+#define MIN_PART_SIZE      (64 * 1024)
+#define INITIAL_PATIENTS   (256)
+
+typedef struct {
+	char*            text;  // first byte of the part
+	char*            end;   // one past the last byte, right after a '\n' or the text end
+	LoadedPartition* partition;
+} ParseJob;
+
+
+/**
+ * @brief Reads a decimal number of at most maxDigits digits.
+ * @return false when there is no digit at *position
+ */
+static bool parseNumber(const char** position, const char* end, int maxDigits, uint32_t* value)
+{
+	const char* p = *position;
+	int digits = 0;
+
+	*value = 0;
+	while (p < end && *p >= '0' && *p <= '9' && digits < maxDigits) {
+		*value = *value * 10 + (uint32_t)(*p - '0');
+		p++;
+		digits++;
+	}
+	*position = p;
+	return digits > 0;
+}
+
+static bool expect(const char** position, const char* end, char c)
+{
+	if (*position < end && **position == c) {
+		(*position)++;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Parses one "dd-mm-yyyy dose[ type]" field up to a tab or the end of the line.
+ */
+static bool parseDose(const char** position, const char* end, DoseData* dose)
+{
+	uint32_t day, month, year, value, type = EXAM_TYPE_NONE;
+
+	if (!parseNumber(position, end, 2, &day) || !expect(position, end, '-') ||
+	    !parseNumber(position, end, 2, &month) || !expect(position, end, '-') ||
+	    !parseNumber(position, end, 4, &year) || !expect(position, end, ' ') ||
+	    !parseNumber(position, end, 5, &value)) {
+		return false;
+	}
+	if (expect(position, end, ' ') && !parseNumber(position, end, 1, &type)) {
+		return false;
+	}
+
+	if (year < FIRST_YEAR || year > LAST_YEAR || month < 1 || month > 12 || day < 1 ||
+	    day > DaysInMonth((uint8_t)month, (uint16_t)year) || value > UINT16_MAX ||
+	    type > EXAM_TYPE_NONE) {
+		return false;
+	}
+	dose->date.day = (uint8_t)day;
+	dose->date.month = (uint8_t)month;
+	dose->date.year = (uint16_t)year;
+	dose->dose = (uint16_t)value;
+	dose->examType = (uint8_t)type;
+	return true;
+}
+
+static LoadedPatient* newPatient(LoadedPartition* partition)
+{
+	if (partition->count == partition->capacity) {
+		size_t capacity = (partition->capacity == 0) ? INITIAL_PATIENTS : 2 * partition->capacity;
+		LoadedPatient* patients = realloc(partition->patients, capacity * sizeof(LoadedPatient));
+		if (patients == NULL) {
+			return NULL;
+		}
+		partition->patients = patients;
+		partition->capacity = capacity;
+	}
+	return &partition->patients[partition->count++];
+}
+
+/**
+ * @brief Parses one line: a name, then a tab separated dose field per dose.
+ */
+static bool parseLine(char* line, const char* end, LoadedPartition* partition)
+{
+	char* nameEnd = line;
+	while (nameEnd < end && *nameEnd != '\t') {
+		nameEnd++;
+	}
+	if (nameEnd == line || nameEnd - line >= MAX_PATIENTNAME_SIZE) {
+		return false; // No name, or too long
+	}
+
+	LoadedPatient* patient = newPatient(partition);
+	if (patient == NULL) {
+		return false;
+	}
+	patient->patientName = line;
+	patient->nrOfDoses = 0;
+
+	const char* position = nameEnd;
+	while (position < end) {
+		position++; // The tab
+		if (patient->nrOfDoses == MAX_DOSES_PER_PATIENT ||
+		    !parseDose(&position, end, &patient->doses[patient->nrOfDoses])) {
+			return false;
+		}
+		patient->nrOfDoses++;
+		if (position < end && *position != '\t') {
+			return false; // Trailing characters after a dose
+		}
+	}
+	*nameEnd = '\0';
+	return true;
+}
+
+static void* parsePart(void* argument)
+{
+	ParseJob* job = argument;
+	char* line = job->text;
+
+	while (line < job->end && !job->partition->failed) {
+		char* newline = memchr(line, '\n', (size_t)(job->end - line));
+		char* lineEnd = (newline != NULL) ? newline : job->end;
+		char* next = (newline != NULL) ? newline + 1 : job->end;
+
+		if (lineEnd > line && lineEnd[-1] == '\r') {
+			lineEnd--;
+		}
+		if (lineEnd > line && !parseLine(line, lineEnd, job->partition)) {
+			job->partition->failed = true;
+		}
+		line = next;
+	}
+	return NULL;
+}
+
+bool ParseRegistryText(char* text, size_t size, size_t nrOfThreads,
+                       LoadedPartition partitions[MAX_LOADER_THREADS], size_t* nrOfPartitions)
+{
+	ParseJob jobs[MAX_LOADER_THREADS];
+	pthread_t threads[MAX_LOADER_THREADS];
+	bool started[MAX_LOADER_THREADS];
+
+	size_t parts = size / MIN_PART_SIZE + 1;
+	if (parts > nrOfThreads) {
+		parts = nrOfThreads;
+	}
+	if (parts > MAX_LOADER_THREADS) {
+		parts = MAX_LOADER_THREADS;
+	}
+	if (parts == 0) {
+		parts = 1;
+	}
+
+	// Cut at the first line end after every 1/parts of the text
+	char* end = text + size;
+	char* start = text;
+	size_t n = 0;
+	for (size_t i = 0; i < parts && start < end; i++) {
+		char* cut = (i == parts - 1) ? end : text + (size / parts) * (i + 1);
+		if (cut < start) {
+			cut = start;
+		}
+		char* newline = (cut < end) ? memchr(cut, '\n', (size_t)(end - cut)) : NULL;
+		char* partEnd = (newline != NULL) ? newline + 1 : end;
+
+		partitions[n] = (LoadedPartition){NULL, 0, 0, false};
+		jobs[n] = (ParseJob){start, partEnd, &partitions[n]};
+		start = partEnd;
+		n++;
+	}
+	*nrOfPartitions = n;
+
+	// The calling thread takes the first part itself
+	for (size_t i = 1; i < n; i++) {
+		started[i] = (pthread_create(&threads[i], NULL, parsePart, &jobs[i]) == 0);
+	}
+	if (n > 0) {
+		parsePart(&jobs[0]);
+	}
+	for (size_t i = 1; i < n; i++) {
+		if (started[i]) {
+			pthread_join(threads[i], NULL);
+		}
+		else {
+			parsePart(&jobs[i]); // No thread available, parse it here
+		}
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		if (partitions[i].failed) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void FreeLoadedPartitions(LoadedPartition partitions[], size_t nrOfPartitions)
+{
+	for (size_t i = 0; i < nrOfPartitions; i++) {
+		free(partitions[i].patients);
+		partitions[i].patients = NULL;
+		partitions[i].count = 0;
+		partitions[i].capacity = 0;
+	}
+}
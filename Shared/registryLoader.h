@@ -0,0 +1,42 @@
+#ifndef REGISTRYLOADER_H
+#define REGISTRYLOADER_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "doseAdmin.h"
+
+// Internal to the Shared module: parses the text written by WriteToFile. The text is
+// split at line boundaries into one part per thread and the parts are parsed in
+// parallel, each into its own partition. Inserting into the table is left to the
+// caller, which walks the partitions in order so the file order is kept.
+#define MAX_LOADER_THREADS (16)
+
+typedef struct {
+	const char* patientName;  // points into the text, \0 terminated by the parser
+	uint8_t     nrOfDoses;
+	DoseData    doses[MAX_DOSES_PER_PATIENT];
+} LoadedPatient;
+
+typedef struct {
+	LoadedPatient* patients;
+	size_t         count;
+	size_t         capacity;
+	bool           failed;    // a malformed line, or allocation of memory failed
+} LoadedPartition;
+
+
+/***************************************************************************************
+ * Parses text of size bytes into at most MAX_LOADER_THREADS partitions, using up to
+ * nrOfThreads threads. Names are \0 terminated in place, so the text is changed and 
+ * needs one writable byte behind the last one.
+ *
+ * Returns false when a line is malformed or allocation of memory failed. The
+ * partitions must be freed with FreeLoadedPartitions in either case.
+ */
+bool ParseRegistryText(char* text, size_t size, size_t nrOfThreads,
+                       LoadedPartition partitions[MAX_LOADER_THREADS], size_t* nrOfPartitions);
+
+
+void FreeLoadedPartitions(LoadedPartition partitions[], size_t nrOfPartitions);
+
+#endif
@@ -0,0 +1,381 @@
+#define _POSIX_C_SOURCE 200112L // For shm_open, ftruncate
+#include "sharedRegistry.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SEGMENT_MAGIC (0x444f5345u) // "DOSE"
+#define NO_RECORD     (0)           // slots and links hold record number + 1
+#define MAX_READ_ATTEMPTS (1u << 16) // a writer that stays busy this long has died
+
+typedef struct {
+	uint32_t magic;
+	uint32_t sequence;     // seqlock: odd while the writer is changing the segment
+	uint32_t closed;       // set when the writer removed the segment
+	uint32_t nrOfSlots;    // power of two
+	uint32_t nrOfRecords;
+	uint32_t nrOfPatients;
+	uint32_t freeRecords;  // first free record, linked through nextFree
+	uint32_t slotsOffset;  // bytes from the start of the segment
+	uint64_t recordsOffset;
+} SegmentHeader;
+
+typedef struct {
+	uint64_t hash;
+	uint32_t nextFree;
+	uint8_t  nrOfDoses;
+	char     name[MAX_PATIENTNAME_SIZE];
+	DoseData doses[MAX_DOSES_PER_PATIENT];
+} SharedRecord;
+
+// Where the table and records are in a reader's mapping, checked against its size
+typedef struct {
+	const uint32_t*     slots;
+	const SharedRecord* records;
+	uint32_t            mask;
+	uint32_t            nrOfRecords;
+} SegmentLayout;
+
+// The writer's mapping
+static SegmentHeader* segment = NULL;
+static size_t segmentSize = 0;
+static char segmentPath[MAX_FILEPATH_LEGTH];
+
+
+static uint32_t* slotsOf(const SegmentHeader* header)
+{
+	return (uint32_t*)((uint8_t*)header + header->slotsOffset);
+}
+
+static SharedRecord* recordsOf(const SegmentHeader* header)
+{
+	return (SharedRecord*)((uint8_t*)header + header->recordsOffset);
+}
+
+static uint32_t homeSlot(uint32_t mask, uint64_t hash)
+{
+	return (uint32_t)(hash >> 32) & mask;
+}
+
+static void writeBegin(void)
+{
+	uint32_t sequence = __atomic_load_n(&segment->sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&segment->sequence, sequence + 1, __ATOMIC_RELAXED);
+	// Readers that see any of the following stores also see the odd sequence number
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void writeEnd(void)
+{
+	uint32_t sequence = __atomic_load_n(&segment->sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&segment->sequence, sequence + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Returns the slot that holds the patient, or the empty slot that ends its 
+ *        probe sequence when the patient is not present.
+ */
+static uint32_t findSlot(uint64_t hash, const char* name)
+{
+	uint32_t* slots = slotsOf(segment);
+	SharedRecord* records = recordsOf(segment);
+	uint32_t slot = homeSlot(segment->nrOfSlots - 1, hash);
+
+	while (slots[slot] != NO_RECORD) {
+		const SharedRecord* record = &records[slots[slot] - 1];
+		if (record->hash == hash && strcmp(record->name, name) == 0) {
+			break;
+		}
+		slot = (slot + 1) & (segment->nrOfSlots - 1);
+	}
+	return slot;
+}
+
+bool SharedRegistryCreate(const char* segmentName, size_t maxNrOfPatients)
+{
+	uint32_t nrOfSlots = 16;
+	while (nrOfSlots < 2 * maxNrOfPatients) {
+		nrOfSlots *= 2; // at most half full, so probe sequences stay short
+	}
+	size_t slotsOffset = sizeof(SegmentHeader);
+	size_t recordsOffset = slotsOffset + nrOfSlots * sizeof(uint32_t);
+	recordsOffset = (recordsOffset + 7) & ~(size_t)7;
+	size_t size = recordsOffset + maxNrOfPatients * sizeof(SharedRecord);
+
+	// A segment left behind by a crashed writer is replaced
+	shm_unlink(segmentName);
+	int fd = shm_open(segmentName, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	if (ftruncate(fd, (off_t)size) != 0) {
+		close(fd);
+		shm_unlink(segmentName);
+		return false;
+	}
+	void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		shm_unlink(segmentName);
+		return false;
+	}
+
+	// ftruncate zero fills: all slots are empty
+	segment = base;
+	segmentSize = size;
+	strncpy(segmentPath, segmentName, MAX_FILEPATH_LEGTH - 1);
+	segmentPath[MAX_FILEPATH_LEGTH - 1] = '\0';
+	segment->nrOfSlots = nrOfSlots;
+	segment->nrOfRecords = (uint32_t)maxNrOfPatients;
+	segment->slotsOffset = (uint32_t)slotsOffset;
+	segment->recordsOffset = recordsOffset;
+	SharedRegistryClear();
+	__atomic_store_n(&segment->magic, SEGMENT_MAGIC, __ATOMIC_RELEASE);
+	return true;
+}
+
+void SharedRegistryDestroy(void)
+{
+	if (segment == NULL) {
+		return;
+	}
+	__atomic_store_n(&segment->closed, 1, __ATOMIC_RELEASE);
+	munmap(segment, segmentSize);
+	shm_unlink(segmentPath);
+	segment = NULL;
+	segmentSize = 0;
+}
+
+bool SharedRegistryIsEnabled(void)
+{
+	return segment != NULL;
+}
+
+bool SharedRegistryAdd(uint64_t hash, const char* name, const DoseData* doses, uint8_t nrOfDoses)
+{
+	if (segment == NULL) {
+		return true;
+	}
+	if (segment->freeRecords == NO_RECORD) {
+		return false; // Segment full
+	}
+
+	writeBegin();
+	uint32_t recordNumber = segment->freeRecords;
+	SharedRecord* record = &recordsOf(segment)[recordNumber - 1];
+	segment->freeRecords = record->nextFree;
+	record->hash = hash;
+	record->nextFree = NO_RECORD;
+	record->nrOfDoses = nrOfDoses;
+	strcpy(record->name, name);
+	for (uint8_t i = 0; i < nrOfDoses; i++) {
+		record->doses[i] = doses[i];
+	}
+	slotsOf(segment)[findSlot(hash, name)] = recordNumber;
+	segment->nrOfPatients++;
+	writeEnd();
+	return true;
+}
+
+void SharedRegistryAppendDose(uint64_t hash, const char* name, const DoseData* dose)
+{
+	if (segment == NULL) {
+		return;
+	}
+	uint32_t recordNumber = slotsOf(segment)[findSlot(hash, name)];
+	if (recordNumber == NO_RECORD) {
+		return;
+	}
+
+	SharedRecord* record = &recordsOf(segment)[recordNumber - 1];
+	if (record->nrOfDoses >= MAX_DOSES_PER_PATIENT) {
+		return;
+	}
+	writeBegin();
+	record->doses[record->nrOfDoses++] = *dose;
+	writeEnd();
+}
+
+void SharedRegistrySetDoses(uint64_t hash, const char* name, const DoseData* doses,
+                            uint8_t nrOfDoses)
+{
+	if (segment == NULL) {
+		return;
+	}
+	uint32_t recordNumber = slotsOf(segment)[findSlot(hash, name)];
+	if (recordNumber == NO_RECORD) {
+		return;
+	}
+
+	SharedRecord* record = &recordsOf(segment)[recordNumber - 1];
+	writeBegin();
+	for (size_t i = 0; i < nrOfDoses; i++) {
+		record->doses[i] = doses[i];
+	}
+	record->nrOfDoses = nrOfDoses;
+	writeEnd();
+}
+
+void SharedRegistryRemove(uint64_t hash, const char* name)
+{
+	if (segment == NULL) {
+		return;
+	}
+	uint32_t* slots = slotsOf(segment);
+	SharedRecord* records = recordsOf(segment);
+	uint32_t mask = segment->nrOfSlots - 1;
+	uint32_t hole = findSlot(hash, name);
+	uint32_t recordNumber = slots[hole];
+	if (recordNumber == NO_RECORD) {
+		return;
+	}
+
+	writeBegin();
+	records[recordNumber - 1].nextFree = segment->freeRecords;
+	segment->freeRecords = recordNumber;
+	// Backward shift deletion, so readers never need tombstones
+	for (uint32_t slot = (hole + 1) & mask; slots[slot] != NO_RECORD; slot = (slot + 1) & mask) {
+		uint32_t home = homeSlot(mask, records[slots[slot] - 1].hash);
+		if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+			slots[hole] = slots[slot];
+			hole = slot;
+		}
+	}
+	slots[hole] = NO_RECORD;
+	segment->nrOfPatients--;
+	writeEnd();
+}
+
+void SharedRegistryClear(void)
+{
+	if (segment == NULL) {
+		return;
+	}
+
+	writeBegin();
+	memset(slotsOf(segment), 0, segment->nrOfSlots * sizeof(uint32_t));
+	SharedRecord* records = recordsOf(segment);
+	for (uint32_t i = 0; i < segment->nrOfRecords; i++) {
+		records[i].nextFree = (i + 1 < segment->nrOfRecords) ? i + 2 : NO_RECORD;
+	}
+	segment->freeRecords = (segment->nrOfRecords > 0) ? 1 : NO_RECORD;
+	segment->nrOfPatients = 0;
+	writeEnd();
+}
+
+/**
+ * @brief Reads the layout from the header of a mapped segment, once: another process
+ *        could change the header, so the checked values are the ones that are used.
+ * @return false when the table or the records do not lie within the mapping
+ */
+static bool readLayout(const SharedRegistryView* view, SegmentLayout* layout)
+{
+	const SegmentHeader* header = view->base;
+	uint32_t nrOfSlots = __atomic_load_n(&header->nrOfSlots, __ATOMIC_RELAXED);
+	uint32_t nrOfRecords = __atomic_load_n(&header->nrOfRecords, __ATOMIC_RELAXED);
+	uint32_t slotsOffset = __atomic_load_n(&header->slotsOffset, __ATOMIC_RELAXED);
+	uint64_t recordsOffset = __atomic_load_n(&header->recordsOffset, __ATOMIC_RELAXED);
+
+	if (nrOfSlots == 0 || (nrOfSlots & (nrOfSlots - 1)) != 0 ||
+	    slotsOffset < sizeof(SegmentHeader) || slotsOffset % sizeof(uint32_t) != 0 ||
+	    slotsOffset > view->size || nrOfSlots > (view->size - slotsOffset) / sizeof(uint32_t)) {
+		return false;
+	}
+	if (recordsOffset % sizeof(uint64_t) != 0 || recordsOffset > view->size ||
+	    nrOfRecords > (view->size - recordsOffset) / sizeof(SharedRecord)) {
+		return false;
+	}
+	layout->slots = (const uint32_t*)((const uint8_t*)view->base + slotsOffset);
+	layout->records = (const SharedRecord*)((const uint8_t*)view->base + recordsOffset);
+	layout->mask = nrOfSlots - 1;
+	layout->nrOfRecords = nrOfRecords;
+	return true;
+}
+
+bool SharedRegistryMap(const char* segmentName, SharedRegistryView* view)
+{
+	struct stat status;
+	int fd = shm_open(segmentName, O_RDONLY, 0);
+	if (fd < 0) {
+		return false;
+	}
+	if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(SegmentHeader)) {
+		close(fd);
+		return false;
+	}
+	void* base = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		return false;
+	}
+	SharedRegistryView mapped = { base, (size_t)status.st_size };
+	SegmentLayout layout;
+	if (__atomic_load_n(&((const SegmentHeader*)base)->magic, __ATOMIC_ACQUIRE) != SEGMENT_MAGIC ||
+	    !readLayout(&mapped, &layout)) {
+		munmap(base, mapped.size);
+		return false;
+	}
+
+	*view = mapped;
+	return true;
+}
+
+void SharedRegistryUnmap(SharedRegistryView* view)
+{
+	if (view->base != NULL) {
+		munmap((void*)view->base, view->size);
+		view->base = NULL;
+		view->size = 0;
+	}
+}
+
+int8_t SharedRegistryRead(const SharedRegistryView* view, uint64_t hash, const char* name,
+                          DoseData doses[MAX_DOSES_PER_PATIENT], uint8_t* nrOfDoses)
+{
+	const SegmentHeader* header = view->base;
+	SegmentLayout layout;
+
+	if (!readLayout(view, &layout)) {
+		return -4;
+	}
+	for (uint32_t attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+		if (__atomic_load_n(&header->closed, __ATOMIC_ACQUIRE)) {
+			return -3;
+		}
+		uint32_t before = __atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE);
+		if (before & 1) {
+			sched_yield(); // The writer is busy, let it finish
+			continue;
+		}
+
+		// Everything read here can be torn by the writer: bound every step, and only
+		// trust the result when the sequence number did not change meanwhile
+		int8_t result = -1;
+		uint32_t slot = homeSlot(layout.mask, hash);
+		for (uint32_t probe = 0; probe <= layout.mask; probe++, slot = (slot + 1) & layout.mask) {
+			uint32_t recordNumber = layout.slots[slot];
+			if (recordNumber == NO_RECORD || recordNumber > layout.nrOfRecords) {
+				break;
+			}
+			const SharedRecord* record = &layout.records[recordNumber - 1];
+			if (record->hash == hash && strncmp(record->name, name, MAX_PATIENTNAME_SIZE) == 0) {
+				*nrOfDoses = record->nrOfDoses;
+				if (*nrOfDoses > MAX_DOSES_PER_PATIENT) {
+					*nrOfDoses = MAX_DOSES_PER_PATIENT;
+				}
+				memcpy(doses, record->doses, *nrOfDoses * sizeof(DoseData));
+				result = 0;
+				break;
+			}
+		}
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&header->sequence, __ATOMIC_RELAXED) == before) {
+			return result;
+		}
+	}
+	return -4; // The writer never finished its change
+}
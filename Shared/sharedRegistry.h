@@ -0,0 +1,73 @@
+#ifndef SHAREDREGISTRY_H
+#define SHAREDREGISTRY_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "doseAdmin.h"
+
+// Internal to the Shared module: a copy of the registry in a named POSIX shared memory
+// segment, kept up to date by the writing process and read by other processes.
+// 
+// The segment holds a header, an open addressing table of record numbers and a fixed
+// array of patient records with room for all their doses. It contains no pointers, 
+// only numbers relative to the start of the segment, so every process can map it at 
+// another address. There is one writer. It makes the sequence number in the header odd
+// while it changes the segment and even again when done (a seqlock); a reader retries
+// when the sequence number was odd or changed while it was reading.
+
+
+/***************************************************************************************
+ * Creates (or replaces) the segment with room for maxNrOfPatients patients
+ * 
+ * Returns false when the segment cannot be created or mapped
+ */
+bool SharedRegistryCreate(const char* segmentName, size_t maxNrOfPatients);
+
+
+/***************************************************************************************
+ * Marks the segment closed for its readers, unmaps and removes it
+ */
+void SharedRegistryDestroy(void);
+
+
+bool SharedRegistryIsEnabled(void);
+
+
+/***************************************************************************************
+ * Writer side: changes to the registry. All do nothing when no segment was created.
+ * 
+ * SharedRegistryAdd returns false when the segment is full
+ */
+bool SharedRegistryAdd(uint64_t hash, const char* name, const DoseData* doses, uint8_t nrOfDoses);
+void SharedRegistryAppendDose(uint64_t hash, const char* name, const DoseData* dose);
+void SharedRegistrySetDoses(uint64_t hash, const char* name, const DoseData* doses,
+                            uint8_t nrOfDoses);
+void SharedRegistryRemove(uint64_t hash, const char* name);
+void SharedRegistryClear(void);
+
+
+/***************************************************************************************
+ * Reader side: maps an existing segment read-only
+ * 
+ * Returns false when the segment does not exist, is not a registry segment or its 
+ * layout does not fit in its size
+ */
+bool SharedRegistryMap(const char* segmentName, SharedRegistryView* view);
+
+
+void SharedRegistryUnmap(SharedRegistryView* view);
+
+
+/***************************************************************************************
+ * Reads a consistent copy of the doses of a patient from a mapped segment
+ * 
+ * Returns  0 when the patient was found
+ * Returns -1 when the patient is not present
+ * Returns -3 when the writer closed the segment
+ * Returns -4 when the segment is damaged: its layout does not fit in the mapping, or a
+ *            change was never finished (the writer died while making it)
+ */
+int8_t SharedRegistryRead(const SharedRegistryView* view, uint64_t hash, const char* name,
+                          DoseData doses[MAX_DOSES_PER_PATIENT], uint8_t* nrOfDoses);
+
+#endif
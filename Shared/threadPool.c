@@ -0,0 +1,185 @@
+#define _POSIX_C_SOURCE 200112L // For sysconf
+#include "threadPool.h"
+#include <pthread.h>
+#include <unistd.h>
+
+// Tasks of one thread: it takes them at next, others steal them at end
+typedef struct {
+	pthread_mutex_t lock;
+	size_t          next;
+	size_t          end;
+} TaskShare;
+
+static size_t limit = 0;               // ThreadPoolSetLimit, 0: one per processor
+static pthread_t workers[MAX_POOL_THREADS];
+static uint64_t firstJob[MAX_POOL_THREADS]; // jobNumber when the worker was started
+static size_t nrOfWorkers = 0;         // threads started, the calling thread is not one
+static TaskShare shares[MAX_POOL_THREADS]; // share 0 is the calling thread's
+static bool sharesInitialized = false;
+
+// The current job, guarded by poolLock
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobStarted = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jobDone = PTHREAD_COND_INITIALIZER;
+static uint64_t jobNumber = 0;
+static size_t busyWorkers = 0;
+static bool stopping = false;
+static PoolTask jobTask = NULL;
+static void* jobContext = NULL;
+
+
+/**
+ * @brief Takes the next task of share, from its front or (stealing) from its back.
+ */
+static bool takeTask(TaskShare* share, bool steal, size_t* task)
+{
+	bool taken = false;
+
+	pthread_mutex_lock(&share->lock);
+	if (share->next < share->end) {
+		*task = steal ? --share->end : share->next++;
+		taken = true;
+	}
+	pthread_mutex_unlock(&share->lock);
+	return taken;
+}
+
+/**
+ * @brief Runs tasks of the current job until no share has any left.
+ */
+static void runTasks(size_t self, size_t nrOfShares)
+{
+	size_t task;
+
+	for (;;) {
+		if (takeTask(&shares[self], false, &task)) {
+			jobTask(task, jobContext);
+			continue;
+		}
+		bool stolen = false;
+		for (size_t i = 1; i < nrOfShares && !stolen; i++) {
+			stolen = takeTask(&shares[(self + i) % nrOfShares], true, &task);
+		}
+		if (!stolen) {
+			return;
+		}
+		jobTask(task, jobContext);
+	}
+}
+
+static void* workerMain(void* argument)
+{
+	size_t self = (size_t)(uintptr_t)argument;
+	uint64_t seen = firstJob[self - 1]; // Jobs before it was started are done
+
+	pthread_mutex_lock(&poolLock);
+	for (;;) {
+		while (jobNumber == seen && !stopping) {
+			pthread_cond_wait(&jobStarted, &poolLock);
+		}
+		if (stopping) {
+			break;
+		}
+		seen = jobNumber;
+		pthread_mutex_unlock(&poolLock);
+
+		runTasks(self, nrOfWorkers + 1);
+
+		pthread_mutex_lock(&poolLock);
+		if (--busyWorkers == 0) {
+			pthread_cond_signal(&jobDone);
+		}
+	}
+	pthread_mutex_unlock(&poolLock);
+	return NULL;
+}
+
+static void stopWorkers(void)
+{
+	pthread_mutex_lock(&poolLock);
+	stopping = true;
+	pthread_cond_broadcast(&jobStarted);
+	pthread_mutex_unlock(&poolLock);
+	for (size_t i = 0; i < nrOfWorkers; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	nrOfWorkers = 0;
+	stopping = false;
+}
+
+/**
+ * @brief Starts the threads for the limit, unless they are running already.
+ */
+static void startWorkers(void)
+{
+	size_t wanted = ThreadPoolParallelism() - 1;
+
+	if (!sharesInitialized) {
+		for (size_t i = 0; i < MAX_POOL_THREADS; i++) {
+			pthread_mutex_init(&shares[i].lock, NULL);
+		}
+		sharesInitialized = true;
+	}
+	while (nrOfWorkers < wanted) {
+		// Share 0 is the calling thread's, worker i takes share i + 1
+		firstJob[nrOfWorkers] = jobNumber;
+		if (pthread_create(&workers[nrOfWorkers], NULL, workerMain,
+		                   (void*)(uintptr_t)(nrOfWorkers + 1)) != 0) {
+			break; // Fewer threads, the others take over their share
+		}
+		nrOfWorkers++;
+	}
+}
+
+void ThreadPoolSetLimit(size_t nrOfThreads)
+{
+	limit = nrOfThreads;
+	if (nrOfWorkers != ThreadPoolParallelism() - 1) {
+		stopWorkers();
+	}
+}
+
+size_t ThreadPoolProcessorCount(void)
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count > 0) ? (size_t)count : 1;
+}
+
+size_t ThreadPoolParallelism(void)
+{
+	size_t threads = (limit == 0) ? ThreadPoolProcessorCount() : limit;
+	return (threads > MAX_POOL_THREADS) ? MAX_POOL_THREADS : threads;
+}
+
+void ThreadPoolRun(size_t nrOfTasks, PoolTask task, void* context)
+{
+	if (nrOfTasks < 2 || ThreadPoolParallelism() < 2) {
+		for (size_t i = 0; i < nrOfTasks; i++) {
+			task(i, context);
+		}
+		return;
+	}
+
+	startWorkers();
+	size_t nrOfShares = nrOfWorkers + 1;
+	for (size_t i = 0; i < nrOfShares; i++) {
+		shares[i].next = nrOfTasks * i / nrOfShares;
+		shares[i].end = nrOfTasks * (i + 1) / nrOfShares;
+	}
+
+	pthread_mutex_lock(&poolLock);
+	jobTask = task;
+	jobContext = context;
+	busyWorkers = nrOfWorkers;
+	jobNumber++;
+	pthread_cond_broadcast(&jobStarted);
+	pthread_mutex_unlock(&poolLock);
+
+	runTasks(0, nrOfShares);
+
+	pthread_mutex_lock(&poolLock);
+	while (busyWorkers > 0) {
+		pthread_cond_wait(&jobDone, &poolLock);
+	}
+	pthread_mutex_unlock(&poolLock);
+}
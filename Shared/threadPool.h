@@ -0,0 +1,46 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Internal to the Shared module: threads for the passes over the whole table. A job is
+// a number of independent tasks (typically ranges of table entries). Every thread,
+// the calling one included, starts on its own share of the tasks and takes them from
+// the front; once its share is done it steals from the back of the shares of the
+// others, so a share with long chains does not keep the other threads waiting. The
+// threads are started on first use and wait for the next job in between.
+#define MAX_POOL_THREADS (16)
+
+typedef void (*PoolTask)(size_t task, void* context);
+
+
+/***************************************************************************************
+ * Sets the number of threads a job runs on, the calling thread included. 0 uses one per
+ * processor, 1 runs every job on the calling thread. Threads of an earlier setting are
+ * stopped.
+ */
+void ThreadPoolSetLimit(size_t nrOfThreads);
+
+
+/***************************************************************************************
+ * Returns the number of processors online, at least 1
+ */
+size_t ThreadPoolProcessorCount(void);
+
+
+/***************************************************************************************
+ * Returns the number of threads a job runs on, also for work that has threads of its
+ * own, such as the parse of ReadFromFile
+ */
+size_t ThreadPoolParallelism(void);
+
+
+/***************************************************************************************
+ * Runs task(0, context) ... task(nrOfTasks - 1, context) and returns when all are done.
+ * Tasks run in any order and at the same time, so they must not change the same data.
+ * When threads cannot be started, the calling thread runs their share.
+ */
+void ThreadPoolRun(size_t nrOfTasks, PoolTask task, void* context);
+
+#endif
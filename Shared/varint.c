@@ -0,0 +1,55 @@
+#include "varint.h"
+
+
+size_t EncodeVarint(uint32_t value, uint8_t* out)
+{
+	size_t size = 0;
+
+	while (value >= 0x80) {
+		out[size++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	out[size++] = (uint8_t)value;
+	return size;
+}
+
+size_t DecodeVarint(const uint8_t* in, uint32_t* value)
+{
+	uint32_t result = 0;
+	size_t size = 0;
+	int shift = 0;
+
+	do {
+		result |= (uint32_t)(in[size] & 0x7F) << shift;
+		shift += 7;
+	} while ((in[size++] & 0x80) && size < MAX_VARINT_SIZE);
+
+	*value = result;
+	return size;
+}
+
+size_t DecodeVarintBounded(const uint8_t* in, const uint8_t* end, uint32_t* value)
+{
+	uint32_t result = 0;
+	size_t size = 0;
+
+	while (in + size < end && size < MAX_VARINT_SIZE) {
+		uint8_t byte = in[size++];
+		result |= (uint32_t)(byte & 0x7F) << (7 * (size - 1));
+		if ((byte & 0x80) == 0) {
+			*value = result;
+			return size;
+		}
+	}
+	return 0;
+}
+
+uint32_t ZigZagEncode(int32_t value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+int32_t ZigZagDecode(uint32_t value)
+{
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
@@ -0,0 +1,42 @@
+#ifndef VARINT_H
+#define VARINT_H
+#include <stdint.h>
+#include <stddef.h>
+
+#define MAX_VARINT_SIZE (5) // bytes needed for any uint32_t
+
+
+/***************************************************************************************
+ * Writes value as a little-endian base-128 varint (7 bits per byte, high bit set on
+ * all but the last byte). Values below 128 take a single byte.
+ * 
+ * Returns the number of bytes written, at most MAX_VARINT_SIZE
+ */
+size_t EncodeVarint(uint32_t value, uint8_t* out);
+
+
+/***************************************************************************************
+ * Reads a varint written by EncodeVarint
+ * 
+ * Returns the number of bytes read
+ */
+size_t DecodeVarint(const uint8_t* in, uint32_t* value);
+
+
+/***************************************************************************************
+ * Reads a varint from bytes that may be incomplete or damaged, e.g. read from a file,
+ * without reading at or past end
+ * 
+ * Returns the number of bytes read, 0 when there is no complete varint before end
+ */
+size_t DecodeVarintBounded(const uint8_t* in, const uint8_t* end, uint32_t* value);
+
+
+/***************************************************************************************
+ * Maps signed values onto unsigned ones so small negative deltas stay small:
+ * 0, -1, 1, -2, 2 ... become 0, 1, 2, 3, 4 ...
+ */
+uint32_t ZigZagEncode(int32_t value);
+int32_t ZigZagDecode(uint32_t value);
+
+#endif
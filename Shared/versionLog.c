@@ -0,0 +1,444 @@
+#include "versionLog.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_RECORDS  (64)
+#define INITIAL_PATIENTS (64)
+#define INITIAL_PINS     (4)
+
+// A pinned version and the number of snapshots holding it
+typedef struct {
+	uint32_t version;
+	uint32_t firstHiddenId;
+	uint32_t count;
+} Pin;
+
+// Newest record of a patient, 0 as patient id marks an empty slot
+typedef struct {
+	uint32_t patientId;
+	uint32_t record;
+} LatestEntry;
+
+static uint32_t currentVersion = 0;
+static uint32_t epoch = 0;
+
+// Pinned versions in ascending order, the first is the oldest one still needed
+static Pin* pins = NULL;
+static size_t nrOfPins = 0;
+static size_t pinCapacity = 0;
+
+// Records in version order. Record numbers keep counting up, records[0] holds number
+// baseRecord; numbers below firstRecord were dropped and their slots are free.
+static VersionRecord* records = NULL;
+static size_t recordCapacity = 0;
+static uint32_t baseRecord = 0;
+static uint32_t firstRecord = 0;
+static uint32_t endRecord = 0;
+static size_t copyBytes = 0;
+
+// Patient id -> newest record: open addressing with linear probing, power of two capacity
+static LatestEntry* latest = NULL;
+static size_t latestCapacity = 0;
+static size_t latestCount = 0;
+
+
+static VersionRecord* recordAt(uint32_t number)
+{
+	return &records[number - baseRecord];
+}
+
+static size_t slotOf(uint32_t patientId)
+{
+	// Fibonacci hashing spreads the consecutive ids over the table
+	return (size_t)(((uint64_t)patientId * 11400714819323198485ULL) >> 32) & (latestCapacity - 1);
+}
+
+static LatestEntry* findLatest(uint32_t patientId)
+{
+	if (latestCapacity == 0) {
+		return NULL;
+	}
+	for (size_t slot = slotOf(patientId); latest[slot].patientId != 0;
+	     slot = (slot + 1) & (latestCapacity - 1)) {
+		if (latest[slot].patientId == patientId) {
+			return &latest[slot];
+		}
+	}
+	return NULL;
+}
+
+static LatestEntry* insertLatest(uint32_t patientId)
+{
+	size_t slot = slotOf(patientId);
+
+	while (latest[slot].patientId != 0 && latest[slot].patientId != patientId) {
+		slot = (slot + 1) & (latestCapacity - 1);
+	}
+	if (latest[slot].patientId == 0) {
+		latest[slot].patientId = patientId;
+		latestCount++;
+	}
+	return &latest[slot];
+}
+
+/**
+ * @brief Makes room for one more patient, keeping the load factor below 3/4.
+ */
+static bool reserveLatest(void)
+{
+	if ((latestCount + 1) * 4 < latestCapacity * 3) {
+		return true;
+	}
+
+	LatestEntry* oldEntries = latest;
+	size_t oldCapacity = latestCapacity;
+	size_t newCapacity = (latestCapacity == 0) ? INITIAL_PATIENTS : 2 * latestCapacity;
+	LatestEntry* newEntries = calloc(newCapacity, sizeof(LatestEntry));
+	if (newEntries == NULL) {
+		return false;
+	}
+
+	latest = newEntries;
+	latestCapacity = newCapacity;
+	latestCount = 0;
+	for (size_t i = 0; i < oldCapacity; i++) {
+		if (oldEntries[i].patientId != 0) {
+			insertLatest(oldEntries[i].patientId)->record = oldEntries[i].record;
+		}
+	}
+	free(oldEntries);
+	return true;
+}
+
+/**
+ * @brief Empties a slot and shifts later entries of the probe sequence back into it.
+ */
+static void deleteLatest(LatestEntry* entry)
+{
+	size_t hole = (size_t)(entry - latest);
+	size_t slot = hole;
+
+	for (;;) {
+		slot = (slot + 1) & (latestCapacity - 1);
+		if (latest[slot].patientId == 0) {
+			break;
+		}
+		size_t home = slotOf(latest[slot].patientId);
+		if (((slot - home) & (latestCapacity - 1)) >= ((slot - hole) & (latestCapacity - 1))) {
+			latest[hole] = latest[slot];
+			hole = slot;
+		}
+	}
+	latest[hole].patientId = 0;
+	latestCount--;
+}
+
+/**
+ * @brief Returns a free record behind the newest one, moving the live records to the
+ *        front or growing the array when needed. NULL when allocation failed.
+ */
+static VersionRecord* newRecord(void)
+{
+	if (endRecord - baseRecord == recordCapacity) {
+		size_t live = endRecord - firstRecord;
+		if (live <= recordCapacity / 2 && recordCapacity > 0) {
+			memmove(records, recordAt(firstRecord), live * sizeof(VersionRecord));
+			baseRecord = firstRecord;
+		}
+		else {
+			size_t capacity = (recordCapacity == 0) ? INITIAL_RECORDS : 2 * recordCapacity;
+			VersionRecord* grown = realloc(records, capacity * sizeof(VersionRecord));
+			if (grown == NULL) {
+				return NULL;
+			}
+			records = grown;
+			recordCapacity = capacity;
+		}
+	}
+	return recordAt(endRecord);
+}
+
+/**
+ * @brief Appends a record as the newest one of its patient.
+ * @return false when allocation of memory failed, nothing is added then
+ */
+static bool addRecord(const VersionRecord* record)
+{
+	LatestEntry* entry = findLatest(record->patientId);
+	if (entry == NULL && !reserveLatest()) {
+		return false;
+	}
+	VersionRecord* slot = newRecord();
+	if (slot == NULL) {
+		return false;
+	}
+
+	*slot = *record;
+	if (entry == NULL) {
+		entry = insertLatest(record->patientId);
+		slot->olderRecord = VERSION_NO_RECORD;
+	}
+	else {
+		slot->olderRecord = entry->record;
+	}
+	entry->record = endRecord++;
+	return true;
+}
+
+static void freeCopy(VersionRecord* record)
+{
+	if (record->doses != NULL) {
+		copyBytes -= record->doseCount * sizeof(DoseData) +
+		             ((record->name != NULL) ? strlen(record->name) + 1 : 0);
+		free(record->doses);
+	}
+}
+
+static void dropAll(void)
+{
+	for (uint32_t number = firstRecord; number < endRecord; number++) {
+		freeCopy(recordAt(number));
+	}
+	free(records);
+	free(latest);
+	records = NULL;
+	recordCapacity = 0;
+	baseRecord = firstRecord = endRecord = 0;
+	latest = NULL;
+	latestCapacity = 0;
+	latestCount = 0;
+}
+
+/**
+ * @brief Tells whether a change of the patient needs a record: a snapshot is pinned that
+ *        sees the patient and the patient did not change since the newest snapshot.
+ */
+static bool needsRecord(uint32_t patientId, bool removal)
+{
+	if (nrOfPins == 0) {
+		return false;
+	}
+	const Pin* newest = &pins[nrOfPins - 1];
+	if (patientId >= newest->firstHiddenId) {
+		return false; // Added after every pinned version
+	}
+	if (removal) {
+		return true; // The copy is the only place left for its doses
+	}
+	const LatestEntry* entry = findLatest(patientId);
+	return entry == NULL || recordAt(entry->record)->version <= newest->version;
+}
+
+void VersionLogClear(void)
+{
+	dropAll();
+	free(pins);
+	pins = NULL;
+	nrOfPins = 0;
+	pinCapacity = 0;
+	epoch++;
+}
+
+uint32_t VersionLogEpoch(void)
+{
+	return epoch;
+}
+
+bool VersionLogPin(uint32_t firstHiddenId, uint32_t* version)
+{
+	*version = currentVersion;
+	if (nrOfPins > 0 && pins[nrOfPins - 1].version == currentVersion &&
+	    pins[nrOfPins - 1].firstHiddenId == firstHiddenId) {
+		pins[nrOfPins - 1].count++;
+		return true;
+	}
+	if (nrOfPins == pinCapacity) {
+		size_t capacity = (pinCapacity == 0) ? INITIAL_PINS : 2 * pinCapacity;
+		Pin* grown = realloc(pins, capacity * sizeof(Pin));
+		if (grown == NULL) {
+			return false;
+		}
+		pins = grown;
+		pinCapacity = capacity;
+	}
+	pins[nrOfPins++] = (Pin){currentVersion, firstHiddenId, 1};
+	return true;
+}
+
+void VersionLogRelease(uint32_t version, uint32_t firstHiddenId)
+{
+	size_t i = 0;
+	while (i < nrOfPins && (pins[i].version != version || pins[i].firstHiddenId != firstHiddenId)) {
+		i++;
+	}
+	if (i == nrOfPins) {
+		return;
+	}
+	if (--pins[i].count > 0) {
+		return;
+	}
+	memmove(&pins[i], &pins[i + 1], (nrOfPins - i - 1) * sizeof(Pin));
+	nrOfPins--;
+
+	if (nrOfPins == 0) {
+		dropAll();
+		free(pins);
+		pins = NULL;
+		pinCapacity = 0;
+		return;
+	}
+
+	// A snapshot only needs the records after its own version
+	uint32_t oldest = pins[0].version;
+	while (firstRecord < endRecord && recordAt(firstRecord)->version <= oldest) {
+		VersionRecord* record = recordAt(firstRecord);
+		LatestEntry* entry = findLatest(record->patientId);
+		if (entry != NULL && entry->record == firstRecord) {
+			deleteLatest(entry);
+		}
+		freeCopy(record);
+		firstRecord++;
+	}
+}
+
+bool VersionLogAppend(uint32_t patientId, uint8_t doseCount)
+{
+	uint32_t version = ++currentVersion;
+	if (!needsRecord(patientId, false)) {
+		return true;
+	}
+
+	VersionRecord record = {version, patientId, VERSION_NO_RECORD, doseCount, false, true, NULL, NULL};
+	return addRecord(&record);
+}
+
+bool VersionLogRemove(uint32_t patientId, const char* name, const DoseData* doses,
+                      uint8_t doseCount, bool readable)
+{
+	uint32_t version = ++currentVersion;
+	if (!needsRecord(patientId, true)) {
+		return true;
+	}
+
+	// Doses first for their alignment, the name behind them
+	size_t nameSize = strlen(name) + 1;
+	size_t size = doseCount * sizeof(DoseData) + nameSize;
+	DoseData* copy = malloc(size);
+	if (copy == NULL) {
+		return false;
+	}
+	if (readable) {
+		for (size_t i = 0; i < doseCount; i++) {
+			copy[i] = doses[i];
+		}
+	}
+	char* nameCopy = (char*)(copy + doseCount);
+	memcpy(nameCopy, name, nameSize);
+
+	VersionRecord record = {version, patientId, VERSION_NO_RECORD, doseCount, true, readable,
+	                        nameCopy, copy};
+	if (!addRecord(&record)) {
+		free(copy);
+		return false;
+	}
+	copyBytes += size;
+	return true;
+}
+
+bool VersionLogReplace(uint32_t patientId, const DoseData* doses, uint8_t doseCount)
+{
+	uint32_t version = ++currentVersion;
+	if (!needsRecord(patientId, true)) {
+		return true;
+	}
+
+	// At least one byte, so the copy is there even without doses
+	DoseData* copy = malloc(doseCount * sizeof(DoseData) + 1);
+	if (copy == NULL) {
+		return false;
+	}
+	for (size_t i = 0; i < doseCount; i++) {
+		copy[i] = doses[i];
+	}
+
+	VersionRecord record = {version, patientId, VERSION_NO_RECORD, doseCount, false, true, NULL, copy};
+	if (!addRecord(&record)) {
+		free(copy);
+		return false;
+	}
+	copyBytes += doseCount * sizeof(DoseData);
+	return true;
+}
+
+const VersionRecord* VersionLogFind(uint32_t patientId, uint32_t version)
+{
+	const LatestEntry* entry = findLatest(patientId);
+	const VersionRecord* found = NULL;
+
+	if (entry == NULL) {
+		return NULL;
+	}
+	// Walk back to the oldest record that is still after version
+	for (uint32_t number = entry->record; number != VERSION_NO_RECORD && number >= firstRecord;
+	     number = recordAt(number)->olderRecord) {
+		if (recordAt(number)->version <= version) {
+			break;
+		}
+		found = recordAt(number);
+	}
+	return found;
+}
+
+const VersionRecord* VersionLogFindCopy(uint32_t patientId, uint32_t version)
+{
+	const LatestEntry* entry = findLatest(patientId);
+	const VersionRecord* found = NULL;
+
+	if (entry == NULL) {
+		return NULL;
+	}
+	for (uint32_t number = entry->record; number != VERSION_NO_RECORD && number >= firstRecord;
+	     number = recordAt(number)->olderRecord) {
+		if (recordAt(number)->version <= version) {
+			break;
+		}
+		if (recordAt(number)->doses != NULL) {
+			found = recordAt(number);
+		}
+	}
+	return found;
+}
+
+const VersionRecord* VersionLogLatest(uint32_t patientId)
+{
+	const LatestEntry* entry = findLatest(patientId);
+	return (entry != NULL) ? recordAt(entry->record) : NULL;
+}
+
+void VersionLogForEachRemoval(uint32_t version, VersionRecordVisitor visit, void* context)
+{
+	// Records are in version order: binary search for the first one after version
+	uint32_t low = firstRecord;
+	uint32_t high = endRecord;
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		if (recordAt(middle)->version <= version) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	for (uint32_t number = low; number < endRecord; number++) {
+		if (recordAt(number)->removed) {
+			visit(recordAt(number), context);
+		}
+	}
+}
+
+size_t VersionLogBytes(void)
+{
+	return recordCapacity * sizeof(VersionRecord) + latestCapacity * sizeof(LatestEntry) +
+	       pinCapacity * sizeof(Pin) + copyBytes;
+}
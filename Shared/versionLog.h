@@ -0,0 +1,104 @@
+#ifndef VERSIONLOG_H
+#define VERSIONLOG_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "doseAdmin.h"
+
+// Internal to the Shared module: the history that pinned snapshots still need. Every
+// dose append and patient removal gets the next version number. While a snapshot is
+// pinned, the first change of a patient after the newest snapshot leaves a record with
+// the state the patient had before it: its dose count for an append (doses are only
+// ever appended, so the count is enough), a copy of name and doses for a removal.
+// Dropping expired doses is the one other change; it always leaves a copy of the doses,
+// as the count alone no longer tells which doses were there.
+// Without pinned snapshots nothing is recorded. Records no pinned snapshot can see
+// anymore are dropped when a snapshot is released.
+
+typedef struct {
+	uint32_t  version;      // version of the change this record precedes
+	uint32_t  patientId;
+	uint32_t  olderRecord;  // previous record of the same patient, or VERSION_NO_RECORD
+	uint8_t   doseCount;    // number of doses before the change
+	bool      removed;      // the change removed the patient, see name and doses
+	bool      readable;     // false when the doses of an evicted patient were unreadable
+	char*     name;         // removed only: copy of the name, in the allocation of doses
+	DoseData* doses;        // removed or replaced: copy of the doses
+} VersionRecord;
+
+#define VERSION_NO_RECORD (UINT32_MAX)
+
+typedef void (*VersionRecordVisitor)(const VersionRecord* record, void* context);
+
+
+/***************************************************************************************
+ * Drops all records and ends all snapshots, VersionLogEpoch changes
+ */
+void VersionLogClear(void);
+
+
+/***************************************************************************************
+ * Incremented by VersionLogClear, a snapshot of an older epoch has ended
+ */
+uint32_t VersionLogEpoch(void);
+
+
+/***************************************************************************************
+ * Pins the current version. Patients with an id of firstHiddenId or higher were added
+ * after it and need no records for this snapshot.
+ *
+ * Returns false when allocation of memory failed
+ */
+bool VersionLogPin(uint32_t firstHiddenId, uint32_t* version);
+
+
+/***************************************************************************************
+ * Releases a version pinned with VersionLogPin and drops the records only it needed
+ */
+void VersionLogRelease(uint32_t version, uint32_t firstHiddenId);
+
+
+/***************************************************************************************
+ * Writer side, called before the change is made. All return false when allocation of
+ * memory failed; the change must not be made then. VersionLogReplace is for a change
+ * that drops doses.
+ */
+bool VersionLogAppend(uint32_t patientId, uint8_t doseCount);
+bool VersionLogRemove(uint32_t patientId, const char* name, const DoseData* doses,
+                      uint8_t doseCount, bool readable);
+bool VersionLogReplace(uint32_t patientId, const DoseData* doses, uint8_t doseCount);
+
+
+/***************************************************************************************
+ * Returns the oldest record of the patient after version, i.e. the state the patient
+ * had at that version. NULL when the patient did not change since.
+ */
+const VersionRecord* VersionLogFind(uint32_t patientId, uint32_t version);
+
+
+/***************************************************************************************
+ * Returns the oldest record of the patient after version that holds a copy of the
+ * doses (a removal or replacement), NULL when doses were only appended since. The 
+ * doses at version are the first doseCount (of VersionLogFind) doses of the copy.
+ */
+const VersionRecord* VersionLogFindCopy(uint32_t patientId, uint32_t version);
+
+
+/***************************************************************************************
+ * Returns the newest record of the patient, NULL when it has none
+ */
+const VersionRecord* VersionLogLatest(uint32_t patientId);
+
+
+/***************************************************************************************
+ * Calls visit for every removal after version, oldest first
+ */
+void VersionLogForEachRemoval(uint32_t version, VersionRecordVisitor visit, void* context);
+
+
+/***************************************************************************************
+ * Returns the bytes allocated for records, copies and the patient map
+ */
+size_t VersionLogBytes(void);
+
+#endif